@@ -0,0 +1,490 @@
+#include "AggregationKernels.h"
+
+#include <QtMath>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+#include <limits>
+#include <functional>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SSMR_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define SSMR_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace Ssmr
+{
+
+namespace
+{
+
+/*
+ * Sum, min and max of n values
+ */
+void ScalarSumMinMax(const double* values, int n, double &sum, double &min, double &max)
+{
+  for(int i = 0; i < n; ++i)
+  {
+    sum += values[i];
+    min = qMin(min, values[i]);
+    max = qMax(max, values[i]);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/*
+ * Sum of each value times the time until the next value, but at most maxHold, the last value has no successor and is
+ * not included. The held time is added to weight.
+ */
+double ScalarWeightedSum(const qint64* timestamps, const double* values, int n, double maxHold, double &weight)
+{
+  double sum = 0.0;
+
+  for(int i = 0; i + 1 < n; ++i)
+  {
+    const double held = qMin(static_cast<double>(timestamps[i + 1] - timestamps[i]), maxHold);
+
+    sum += values[i] * held;
+    weight += held;
+  }
+
+  return sum;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/*
+ * Sum of the increments between consecutive values, a decrement is a reset and the new value is the increment
+ */
+double ScalarCounterDelta(const double* values, int n, int &resets)
+{
+  double sum = 0.0;
+
+  for(int i = 0; i + 1 < n; ++i)
+  {
+    const double delta = values[i + 1] - values[i];
+
+    if(0.0 > delta)
+    {
+      sum += values[i + 1];
+      ++resets;
+    }
+    else
+    {
+      sum += delta;
+    }
+  }
+
+  return sum;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifdef SSMR_SIMD_AVX2
+
+bool HasSimd()
+{
+  static const bool avx2 = (0 != __builtin_cpu_supports("avx2"));
+  return avx2;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+void SimdSumMinMax(const double* values, int n, double &sum, double &min, double &max)
+{
+  __m256d sum0 = _mm256_setzero_pd();
+  __m256d sum1 = _mm256_setzero_pd();
+  __m256d min0 = _mm256_set1_pd(min);
+  __m256d max0 = _mm256_set1_pd(max);
+
+  int i = 0;
+  for(; i + 8 <= n; i += 8)
+  {
+    const __m256d a = _mm256_loadu_pd(values + i);
+    const __m256d b = _mm256_loadu_pd(values + i + 4);
+
+    sum0 = _mm256_add_pd(sum0, a);
+    sum1 = _mm256_add_pd(sum1, b);
+    min0 = _mm256_min_pd(min0, _mm256_min_pd(a, b));
+    max0 = _mm256_max_pd(max0, _mm256_max_pd(a, b));
+  }
+
+  alignas(32) double sums[4];
+  alignas(32) double mins[4];
+  alignas(32) double maxs[4];
+  _mm256_store_pd(sums, _mm256_add_pd(sum0, sum1));
+  _mm256_store_pd(mins, min0);
+  _mm256_store_pd(maxs, max0);
+
+  for(int lane = 0; lane < 4; ++lane)
+  {
+    sum += sums[lane];
+    min = qMin(min, mins[lane]);
+    max = qMax(max, maxs[lane]);
+  }
+
+  ScalarSumMinMax(values + i, n - i, sum, min, max);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+double SimdWeightedSum(const qint64* timestamps, const double* values, int n, double maxHold, double &weight)
+{
+  //time differences below 2^52 are converted to double by placing them in the mantissa of 2^52
+  const __m256d magic = _mm256_set1_pd(4503599627370496.0);
+  const __m256i magicBits = _mm256_castpd_si256(magic);
+  const __m256d limit = _mm256_set1_pd(maxHold);
+
+  __m256d sum0 = _mm256_setzero_pd();
+  __m256d weight0 = _mm256_setzero_pd();
+
+  int i = 0;
+  for(; i + 4 < n; i += 4)
+  {
+    const __m256i t0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(timestamps + i));
+    const __m256i t1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(timestamps + i + 1));
+    const __m256i delta = _mm256_sub_epi64(t1, t0);
+    const __m256d held = _mm256_min_pd(_mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(delta, magicBits)), magic),
+                                       limit);
+
+    sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(values + i), held));
+    weight0 = _mm256_add_pd(weight0, held);
+  }
+
+  alignas(32) double sums[4];
+  _mm256_store_pd(sums, sum0);
+
+  alignas(32) double weights[4];
+  _mm256_store_pd(weights, weight0);
+  weight += weights[0] + weights[1] + weights[2] + weights[3];
+
+  return sums[0] + sums[1] + sums[2] + sums[3] + ScalarWeightedSum(timestamps + i, values + i, n - i, maxHold, weight);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+double SimdCounterDelta(const double* values, int n, int &resets)
+{
+  const __m256d zero = _mm256_setzero_pd();
+  __m256d sum0 = _mm256_setzero_pd();
+
+  int i = 0;
+  for(; i + 4 < n; i += 4)
+  {
+    const __m256d a = _mm256_loadu_pd(values + i);
+    const __m256d b = _mm256_loadu_pd(values + i + 1);
+    const __m256d delta = _mm256_sub_pd(b, a);
+    const __m256d reset = _mm256_cmp_pd(delta, zero, _CMP_LT_OQ);
+
+    sum0 = _mm256_add_pd(sum0, _mm256_blendv_pd(delta, b, reset));
+    resets += __builtin_popcount(static_cast<unsigned int>(_mm256_movemask_pd(reset)));
+  }
+
+  alignas(32) double sums[4];
+  _mm256_store_pd(sums, sum0);
+
+  return sums[0] + sums[1] + sums[2] + sums[3] + ScalarCounterDelta(values + i, n - i, resets);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+#elif defined(SSMR_SIMD_NEON)
+
+bool HasSimd()
+{
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SimdSumMinMax(const double* values, int n, double &sum, double &min, double &max)
+{
+  float64x2_t sum0 = vdupq_n_f64(0.0);
+  float64x2_t sum1 = vdupq_n_f64(0.0);
+  float64x2_t min0 = vdupq_n_f64(min);
+  float64x2_t max0 = vdupq_n_f64(max);
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    const float64x2_t a = vld1q_f64(values + i);
+    const float64x2_t b = vld1q_f64(values + i + 2);
+
+    sum0 = vaddq_f64(sum0, a);
+    sum1 = vaddq_f64(sum1, b);
+    min0 = vminq_f64(min0, vminq_f64(a, b));
+    max0 = vmaxq_f64(max0, vmaxq_f64(a, b));
+  }
+
+  sum += vaddvq_f64(vaddq_f64(sum0, sum1));
+  min = qMin(min, vminvq_f64(min0));
+  max = qMax(max, vmaxvq_f64(max0));
+
+  ScalarSumMinMax(values + i, n - i, sum, min, max);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double SimdWeightedSum(const qint64* timestamps, const double* values, int n, double maxHold, double &weight)
+{
+  const float64x2_t limit = vdupq_n_f64(maxHold);
+
+  float64x2_t sum0 = vdupq_n_f64(0.0);
+  float64x2_t weight0 = vdupq_n_f64(0.0);
+
+  int i = 0;
+  for(; i + 2 < n; i += 2)
+  {
+    //qint64 and int64_t are distinct types of the same width on some platforms
+    const int64x2_t t0 = vld1q_s64(reinterpret_cast<const int64_t*>(timestamps + i));
+    const int64x2_t t1 = vld1q_s64(reinterpret_cast<const int64_t*>(timestamps + i + 1));
+    const int64x2_t delta = vsubq_s64(t1, t0);
+
+    const float64x2_t held = vminq_f64(vcvtq_f64_s64(delta), limit);
+
+    sum0 = vfmaq_f64(sum0, vld1q_f64(values + i), held);
+    weight0 = vaddq_f64(weight0, held);
+  }
+
+  weight += vaddvq_f64(weight0);
+
+  return vaddvq_f64(sum0) + ScalarWeightedSum(timestamps + i, values + i, n - i, maxHold, weight);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double SimdCounterDelta(const double* values, int n, int &resets)
+{
+  float64x2_t sum0 = vdupq_n_f64(0.0);
+  uint64x2_t resets0 = vdupq_n_u64(0);
+
+  int i = 0;
+  for(; i + 2 < n; i += 2)
+  {
+    const float64x2_t a = vld1q_f64(values + i);
+    const float64x2_t b = vld1q_f64(values + i + 1);
+    const float64x2_t delta = vsubq_f64(b, a);
+    const uint64x2_t reset = vcltzq_f64(delta);
+
+    sum0 = vaddq_f64(sum0, vbslq_f64(reset, b, delta));
+    resets0 = vsubq_u64(resets0, reset);
+  }
+
+  resets += static_cast<int>(vgetq_lane_u64(resets0, 0) + vgetq_lane_u64(resets0, 1));
+
+  return vaddvq_f64(sum0) + ScalarCounterDelta(values + i, n - i, resets);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+#else
+
+bool HasSimd()
+{
+  return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SimdSumMinMax(const double* values, int n, double &sum, double &min, double &max)
+{
+  ScalarSumMinMax(values, n, sum, min, max);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double SimdWeightedSum(const qint64* timestamps, const double* values, int n, double maxHold, double &weight)
+{
+  return ScalarWeightedSum(timestamps, values, n, maxHold, weight);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double SimdCounterDelta(const double* values, int n, int &resets)
+{
+  return ScalarCounterDelta(values, n, resets);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+#endif
+
+}
+
+SampleColumns SampleColumns::FromSamples(const ObisSampleList &samples)
+{
+  SampleColumns columns;
+  columns.timestamps.resize(samples.size());
+  columns.values.resize(samples.size());
+
+  for(int i = 0; i < samples.size(); ++i)
+  {
+    columns.timestamps[i] = samples.at(i).first;
+    columns.values[i] = samples.at(i).second;
+  }
+
+  return columns;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ColumnAggregate::ColumnAggregate()
+  : count(0)
+  , sum(0.0)
+  , min(std::numeric_limits<double>::infinity())
+  , max(-std::numeric_limits<double>::infinity())
+  , firstTimestamp(std::numeric_limits<qint64>::max())
+  , first(qQNaN())
+  , lastTimestamp(std::numeric_limits<qint64>::min())
+  , last(qQNaN())
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString AggregationKernels::GetSimdName()
+{
+  #if defined(SSMR_SIMD_AVX2)
+  return (true == HasSimd()) ? QString("AVX2") : QString("scalar");
+  #elif defined(SSMR_SIMD_NEON)
+  return QString("NEON");
+  #else
+  return QString("scalar");
+  #endif
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ColumnAggregate AggregationKernels::Aggregate(const SampleColumns &columns, int begin, int end, bool simd)
+{
+  ColumnAggregate aggregate;
+
+  const int n = end - begin;
+  if(0 >= n) return aggregate;
+
+  const double* values = columns.values.constData() + begin;
+
+  if((true == simd) && (true == HasSimd()))
+  {
+    SimdSumMinMax(values, n, aggregate.sum, aggregate.min, aggregate.max);
+  }
+  else
+  {
+    ScalarSumMinMax(values, n, aggregate.sum, aggregate.min, aggregate.max);
+  }
+
+  aggregate.count = static_cast<quint64>(n);
+  aggregate.firstTimestamp = columns.timestamps.at(begin);
+  aggregate.first = values[0];
+  aggregate.lastTimestamp = columns.timestamps.at(end - 1);
+  aggregate.last = values[n - 1];
+
+  return aggregate;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double AggregationKernels::TimeWeightedMean(const SampleColumns &columns,
+                                            int begin,
+                                            int end,
+                                            qint64 until,
+                                            qint64 maxHold,
+                                            double *weight,
+                                            bool simd)
+{
+  if(nullptr != weight) *weight = 0.0;
+
+  const int n = end - begin;
+  if(0 >= n) return qQNaN();
+
+  const qint64* timestamps = columns.timestamps.constData() + begin;
+  const double* values = columns.values.constData() + begin;
+  const double limit = static_cast<double>(qMax<qint64>(0, maxHold));
+
+  double total = 0.0;
+  double sum = ((true == simd) && (true == HasSimd())) ? SimdWeightedSum(timestamps, values, n, limit, total)
+                                                       : ScalarWeightedSum(timestamps, values, n, limit, total);
+
+  const double held = qMin(static_cast<double>(qMax(until, timestamps[n - 1]) - timestamps[n - 1]), limit);
+  sum += values[n - 1] * held;
+  total += held;
+
+  if(nullptr != weight) *weight = total;
+
+  return (0.0 < total) ? (sum / total) : values[n - 1];
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double AggregationKernels::CounterDelta(const SampleColumns &columns, int begin, int end, int *resets, bool simd)
+{
+  int count = 0;
+  double delta = 0.0;
+
+  const int n = end - begin;
+
+  if(1 < n)
+  {
+    const double* values = columns.values.constData() + begin;
+
+    delta = ((true == simd) && (true == HasSimd())) ? SimdCounterDelta(values, n, count)
+                                                    : ScalarCounterDelta(values, n, count);
+  }
+
+  if(nullptr != resets) *resets = count;
+
+  return delta;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void AggregationKernels::Benchmark(QTextStream &out, int count)
+{
+  const int cRepetitions = 20;
+
+  if(0 >= count) return;
+
+  //a counter with small random increments, a reset every million samples and one sample per second
+  SampleColumns columns;
+  columns.timestamps.resize(count);
+  columns.values.resize(count);
+
+  double counter = 0.0;
+  for(int i = 0; i < count; ++i)
+  {
+    if(0 == (i % 1000000)) counter = 0.0;
+    counter += QRandomGenerator::global()->bounded(10.0);
+
+    columns.timestamps[i] = 1600000000000LL + 1000LL * i + QRandomGenerator::global()->bounded(100);
+    columns.values[i] = counter;
+  }
+
+  out << "aggregation kernels: " << GetSimdName() << ", " << count << " samples, " << cRepetitions
+      << " repetitions" << '\n';
+
+  const auto measure = [&](const QString &name, const std::function<double(bool)> &kernel)
+  {
+    double scalarResult{};
+    double simdResult{};
+
+    QElapsedTimer timer;
+
+    timer.start();
+    for(int i = 0; i < cRepetitions; ++i) scalarResult = kernel(false);
+    const qint64 scalarNs = timer.nsecsElapsed() / cRepetitions;
+
+    timer.restart();
+    for(int i = 0; i < cRepetitions; ++i) simdResult = kernel(true);
+    const qint64 simdNs = timer.nsecsElapsed() / cRepetitions;
+
+    out << name << ": scalar " << (scalarNs / 1000) << " us, simd " << (simdNs / 1000) << " us, speedup "
+        << QString::number(static_cast<double>(scalarNs) / qMax<qint64>(1, simdNs), 'f', 2)
+        << ", relative difference " << QString::number(qAbs(simdResult - scalarResult) / qMax(1.0, qAbs(scalarResult)))
+        << '\n';
+  };
+
+  measure(QString("sum/min/max"), [&columns, count](bool simd)
+  {
+    return AggregationKernels::Aggregate(columns, 0, count, simd).sum;
+  });
+
+  measure(QString("time weighted mean"), [&columns, count](bool simd)
+  {
+    return AggregationKernels::TimeWeightedMean(columns, 0, count, columns.timestamps.last(),
+                                                std::numeric_limits<qint64>::max(), nullptr, simd);
+  });
+
+  measure(QString("counter delta"), [&columns, count](bool simd)
+  {
+    return AggregationKernels::CounterDelta(columns, 0, count, nullptr, simd);
+  });
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
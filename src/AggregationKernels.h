@@ -0,0 +1,122 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QTextStream>
+
+#include "TypeDefinitions.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The SampleColumns struct stores samples as separate timestamp and value columns for the aggregation kernels
+ */
+struct SampleColumns
+{
+	/**
+	 * @brief FromSamples Split the given samples into columns
+	 * @param samples
+	 * @return
+	 */
+	static SampleColumns FromSamples(const ObisSampleList &samples);
+
+	/**
+	 * @brief size
+	 * @return The number of samples
+	 */
+	int size() const
+	{
+		return values.size();
+	}
+
+	//!Time in milliseconds since epoch, ascending
+	QVector<qint64> timestamps;
+	QVector<double> values;
+};
+
+/**
+ * @brief The ColumnAggregate struct contains the basic aggregates of a run of samples
+ */
+struct ColumnAggregate
+{
+	ColumnAggregate();
+
+	quint64 count;
+	double sum;
+	double min;
+	double max;
+
+	qint64 firstTimestamp;
+	double first;
+
+	qint64 lastTimestamp;
+	double last;
+};
+
+/**
+ * @brief The AggregationKernels class contains the aggregation loops over sample columns
+ *
+ * The loops are vectorized with AVX2 on x86-64 if the CPU supports it at run time and with NEON on AArch64, all other
+ * targets use the scalar loops. Sums are accumulated in several lanes, so the result may differ from the scalar path in
+ * the last bits.
+ */
+class AggregationKernels
+{
+public:
+
+	/**
+	 * @brief GetSimdName
+	 * @return The instruction set used by the vectorized kernels, "scalar" if there is none
+	 */
+	static QString GetSimdName();
+
+	/**
+	 * @brief Aggregate Count, sum, min, max, first and last of the samples in [begin, end)
+	 * @param columns
+	 * @param begin
+	 * @param end
+	 * @param simd False to force the scalar path
+	 * @return
+	 */
+	static ColumnAggregate Aggregate(const SampleColumns &columns, int begin, int end, bool simd = true);
+
+	/**
+	 * @brief TimeWeightedMean The mean of the samples in [begin, end), each value is held until the next one
+	 * @param columns
+	 * @param begin
+	 * @param end
+	 * @param until The last value is held until this time in milliseconds since epoch
+	 * @param maxHold No value is held longer than this many milliseconds, gaps beyond do not count
+	 * @param weight Set to the time in milliseconds the values were held, if not nullptr
+	 * @param simd False to force the scalar path
+	 * @return The mean, or the last value if no time passed
+	 */
+	static double TimeWeightedMean(const SampleColumns &columns,
+																 int begin,
+																 int end,
+																 qint64 until,
+																 qint64 maxHold,
+																 double* weight = nullptr,
+																 bool simd = true);
+
+	/**
+	 * @brief CounterDelta The increase of a counter over the samples in [begin, end)
+	 * @param columns
+	 * @param begin
+	 * @param end
+	 * @param resets Set to the number of detected resets if not nullptr
+	 * @param simd False to force the scalar path
+	 * @return The increase, a value below its predecessor is a reset and counts as consumption since the reset
+	 */
+	static double CounterDelta(const SampleColumns &columns, int begin, int end, int* resets = nullptr, bool simd = true);
+
+	/**
+	 * @brief Benchmark Compare the vectorized kernels to the scalar ones on random data and print the timings
+	 * @param out
+	 * @param count The number of samples
+	 */
+	static void Benchmark(QTextStream &out, int count);
+};
+
+}
@@ -0,0 +1,240 @@
+#include "CalendarAggregates.h"
+#include "HelpFunctions.h"
+
+#include <QDebug>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QStringList>
+#include <QRegularExpression>
+
+#include "qtcsv/stringdata.h"
+#include "qtcsv/reader.h"
+#include "qtcsv/writer.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+
+const QStringList cPeriodNames = {QString("day"), QString("week"), QString("month")};
+
+/*
+ * Returns the local midnight at the start of the given date in milliseconds since epoch
+ */
+qint64 LocalDayStart(const QDate &date)
+{
+  return QDateTime(date, QTime(0, 0), Qt::LocalTime).toMSecsSinceEpoch();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+bool CalendarAggregates::IsEnergyCounter(const QString &obisNumber)
+{
+  static const QRegularExpression r("^\\d+-\\d+:\\d+\\.8\\.\\d+\\*\\d+$");
+
+  return r.match(obisNumber).hasMatch();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QDate CalendarAggregates::PeriodStart(const CalendarPeriod &period, const QDate &date)
+{
+  switch(period)
+  {
+    case CalendarPeriod::eDay: return date;
+    case CalendarPeriod::eWeek: return date.addDays(1 - date.dayOfWeek());
+    case CalendarPeriod::eMonth: return QDate(date.year(), date.month(), 1);
+  }
+
+  return date;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QDate CalendarAggregates::NextPeriodStart(const CalendarPeriod &period, const QDate &date)
+{
+  const QDate start = PeriodStart(period, date);
+
+  switch(period)
+  {
+    case CalendarPeriod::eDay: return start.addDays(1);
+    case CalendarPeriod::eWeek: return start.addDays(7);
+    case CalendarPeriod::eMonth: return start.addMonths(1);
+  }
+
+  return start.addDays(1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CalendarAggregates::ParsePeriod(const QString &text, CalendarPeriod &period)
+{
+  const int index = cPeriodNames.indexOf(text);
+  if(0 > index) return false;
+
+  period = static_cast<CalendarPeriod>(index);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString CalendarAggregates::GetFilePath(const QString &connectionName)
+{
+  return GetLogDirectory().absoluteFilePath(QString("%1_calendar.csv").arg(connectionName));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+CalendarAggregates::CalendarAggregates()
+  : m_Counters()
+  , m_Consumption()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CalendarAggregates::addSample(const QString &obisNumber, const qint64 &timestamp, const double &value)
+{
+  auto &counter = m_Counters[obisNumber];
+
+  if(0 > counter.timestamp)
+  {
+    counter.timestamp = timestamp;
+    counter.value = value;
+    return true;
+  }
+
+  if(timestamp <= counter.timestamp) return false;
+
+  //a counter running backwards was reset, the new value is what was consumed since the reset
+  const double delta = (value >= counter.value) ? (value - counter.value) : value;
+
+  //spread the delta linearly over all local days between the two values
+  const double total = static_cast<double>(timestamp - counter.timestamp);
+  qint64 from = counter.timestamp;
+  QDate date = QDateTime::fromMSecsSinceEpoch(from).date();
+
+  while(from < timestamp)
+  {
+    const qint64 to = qMin(timestamp, LocalDayStart(date.addDays(1)));
+
+    if(to > from) add(obisNumber, date, delta * static_cast<double>(to - from) / total);
+
+    from = qMax(from, to);
+    date = date.addDays(1);
+  }
+
+  counter.timestamp = timestamp;
+  counter.value = value;
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CalendarAggregates::removeSeries(const QString &obisNumber)
+{
+  m_Counters.remove(obisNumber);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double CalendarAggregates::getConsumption(const QString &obisNumber,
+                                          const CalendarPeriod &period,
+                                          const QDate &date) const
+{
+  const auto &consumption = m_Consumption[static_cast<int>(period)];
+
+  return consumption.value(obisNumber).value(PeriodStart(period, date).toJulianDay(), 0.0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QHash<QString, double> CalendarAggregates::getConsumptionByTariff(const CalendarPeriod &period,
+                                                                  const QDate &date) const
+{
+  QHash<QString, double> result;
+
+  const auto &consumption = m_Consumption[static_cast<int>(period)];
+  const qint64 start = PeriodStart(period, date).toJulianDay();
+
+  for(auto it = consumption.cbegin(); it != consumption.cend(); ++it)
+  {
+    const auto value = it.value().find(start);
+    if(value != it.value().cend()) result.insert(it.key(), value.value());
+  }
+
+  return result;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CalendarAggregates::load(const QString &filePath)
+{
+  if(false == QFileInfo::exists(filePath)) return false;
+
+  m_Counters.clear();
+  for(auto &consumption : m_Consumption) consumption.clear();
+
+  const QList<QStringList> rows = QtCSV::Reader::readToList(filePath);
+
+  for(const auto &row : rows)
+  {
+    if(4 != row.size()) continue;
+
+    if(QString("counter") == row.at(0))
+    {
+      m_Counters[row.at(1)] = CounterState{row.at(2).toLongLong(), row.at(3).toDouble()};
+      continue;
+    }
+
+    const int period = cPeriodNames.indexOf(row.at(0));
+    if(0 > period) continue;
+
+    const QDate start = QDate::fromString(row.at(1), Qt::ISODate);
+    if(false == start.isValid()) continue;
+
+    m_Consumption[period][row.at(2)][start.toJulianDay()] = row.at(3).toDouble();
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CalendarAggregates::save(const QString &filePath) const
+{
+  QtCSV::StringData data;
+  data.addRow(QStringList() << QString("period") << QString("start") << QString("obis") << QString("value"));
+
+  for(int period = 0; period < cPeriodNames.size(); ++period)
+  {
+    const auto &consumption = m_Consumption[period];
+
+    for(auto series = consumption.cbegin(); series != consumption.cend(); ++series)
+    {
+      for(auto it = series.value().cbegin(); it != series.value().cend(); ++it)
+      {
+        data.addRow(QStringList() << cPeriodNames.at(period)
+                                  << QDate::fromJulianDay(it.key()).toString(Qt::ISODate)
+                                  << series.key()
+                                  << QString::number(it.value(), 'f', 3));
+      }
+    }
+  }
+
+  for(auto it = m_Counters.cbegin(); it != m_Counters.cend(); ++it)
+  {
+    data.addRow(QStringList() << QString("counter")
+                              << it.key()
+                              << QString::number(it.value().timestamp)
+                              << QString::number(it.value().value, 'f', 3));
+  }
+
+  return QtCSV::Writer::write(filePath, data);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CalendarAggregates::add(const QString &obisNumber, const QDate &date, const double &consumption)
+{
+  for(int period = 0; period < cPeriodNames.size(); ++period)
+  {
+    const QDate start = PeriodStart(static_cast<CalendarPeriod>(period), date);
+
+    m_Consumption[period][obisNumber][start.toJulianDay()] += consumption;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
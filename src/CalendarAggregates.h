@@ -0,0 +1,151 @@
+#pragma once
+
+#include <QDate>
+#include <QHash>
+#include <QString>
+
+namespace Ssmr
+{
+
+/**
+ * @brief The CalendarPeriod enum The supported calendar periods, all in local time
+ */
+enum class CalendarPeriod
+{
+	eDay = 0,
+	eWeek = 1,
+	eMonth = 2,
+};
+
+/**
+ * @brief The CalendarAggregates class materializes the consumption per local day, week and month for energy counters
+ *
+ * Every tariff register (e.g. 1.8.1 and 1.8.2) is a counter on its own, so the consumption is split by tariff simply by
+ * aggregating each counter separately. The delta between two values is spread linearly over the time in between, day
+ * boundaries are calculated in local time so days with a daylight saving time change have 23 or 25 hours. A counter
+ * which runs backwards is treated as a reset to zero.
+ */
+class CalendarAggregates
+{
+public:
+
+	/**
+	 * @brief IsEnergyCounter
+	 * @param obisNumber
+	 * @return True if the given obis number is a cumulative energy register (value group D is 8)
+	 */
+	static bool IsEnergyCounter(const QString &obisNumber);
+
+	/**
+	 * @brief PeriodStart
+	 * @param period
+	 * @param date
+	 * @return The first day of the period containing the given date, weeks start on monday
+	 */
+	static QDate PeriodStart(const CalendarPeriod &period, const QDate &date);
+
+	/**
+	 * @brief NextPeriodStart
+	 * @param period
+	 * @param date
+	 * @return The first day of the period following the one containing the given date
+	 */
+	static QDate NextPeriodStart(const CalendarPeriod &period, const QDate &date);
+
+	/**
+	 * @brief ParsePeriod Parse a period like "day", "week" or "month"
+	 * @param text
+	 * @param period
+	 * @return False for unknown periods
+	 */
+	static bool ParsePeriod(const QString &text, CalendarPeriod &period);
+
+	/**
+	 * @brief GetFilePath
+	 * @param connectionName
+	 * @return Where the calendar aggregates of the given connection are saved
+	 */
+	static QString GetFilePath(const QString &connectionName);
+
+	/**
+	 * @brief CalendarAggregates Default constructor
+	 */
+	CalendarAggregates();
+
+	/**
+	 * @brief addSample Add a new counter value
+	 * @param obisNumber
+	 * @param timestamp Time in milliseconds since epoch, values older than the last one are ignored
+	 * @param value
+	 * @return True if the value was accounted
+	 */
+	bool addSample(const QString &obisNumber, const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief removeSeries Forget the counter state of the given series, the aggregates are kept
+	 * @param obisNumber
+	 */
+	void removeSeries(const QString &obisNumber);
+
+	/**
+	 * @brief getConsumption
+	 * @param obisNumber
+	 * @param period
+	 * @param date Any date within the requested period
+	 * @return The consumption of the given counter within the period, in the unit of the counter
+	 */
+	double getConsumption(const QString &obisNumber, const CalendarPeriod &period, const QDate &date) const;
+
+	/**
+	 * @brief getConsumptionByTariff
+	 * @param period
+	 * @param date Any date within the requested period
+	 * @return The consumption of all counters within the given period by obis number
+	 */
+	QHash<QString, double> getConsumptionByTariff(const CalendarPeriod &period, const QDate &date) const;
+
+	/**
+	 * @brief load Replace the content with the aggregates stored in the given file
+	 * @param filePath
+	 * @return False if the file could not be read
+	 */
+	bool load(const QString &filePath);
+
+	/**
+	 * @brief save Store all aggregates and counter states in the given file
+	 * @param filePath
+	 * @return False if the file could not be written
+	 */
+	bool save(const QString &filePath) const;
+
+private:
+
+	/**
+	 * @brief The CounterState struct The last accounted value of a single counter
+	 */
+	struct CounterState
+	{
+		qint64 timestamp{-1};
+		double value{};
+	};
+
+	/**
+	 * @brief add Add a consumption to all periods containing the given date
+	 * @param obisNumber
+	 * @param date
+	 * @param consumption
+	 */
+	void add(const QString &obisNumber, const QDate &date, const double &consumption);
+
+	/**
+	 * @brief m_Counters The last value of each counter
+	 */
+	QHash<QString, CounterState> m_Counters;
+
+	/**
+	 * @brief m_Consumption For each period, the consumption by obis number and julian day of the period start
+	 */
+	QHash<QString, QHash<qint64, double>> m_Consumption[3];
+};
+
+}
@@ -0,0 +1,316 @@
+#include "ChannelExpression.h"
+
+#include <QtMath>
+#include <QVarLengthArray>
+
+namespace Ssmr
+{
+
+/*
+ * A recursive descent parser which emits the instructions while it descends:
+ *
+ * expression := term (('+' | '-') term)*
+ * term       := unary (('*' | '/') unary)*
+ * unary      := '-' unary | primary
+ * primary    := number | '[' obis ']' | function '(' expression (',' expression)* ')' | '(' expression ')'
+ */
+class ChannelExpression::Parser
+{
+public:
+
+  Parser(const QString &text, ChannelExpression &expression)
+    : m_Text(text)
+    , m_Position(0)
+    , m_Depth(0)
+    , m_Expression(expression)
+  {
+  }
+
+  bool parse()
+  {
+    if(false == parseExpression()) return false;
+
+    skipSpaces();
+    if(m_Position < m_Text.size()) return fail(QString("unexpected '%1'").arg(m_Text.at(m_Position)));
+
+    return true;
+  }
+
+private:
+
+  bool parseExpression()
+  {
+    if(false == parseTerm()) return false;
+
+    while(true)
+    {
+      if(true == accept('+'))
+      {
+        if(false == parseTerm()) return false;
+        emitOperation(Operation::eAdd, 2);
+      }
+      else if(true == accept('-'))
+      {
+        if(false == parseTerm()) return false;
+        emitOperation(Operation::eSubtract, 2);
+      }
+      else
+      {
+        return true;
+      }
+    }
+  }
+
+  bool parseTerm()
+  {
+    if(false == parseUnary()) return false;
+
+    while(true)
+    {
+      if(true == accept('*'))
+      {
+        if(false == parseUnary()) return false;
+        emitOperation(Operation::eMultiply, 2);
+      }
+      else if(true == accept('/'))
+      {
+        if(false == parseUnary()) return false;
+        emitOperation(Operation::eDivide, 2);
+      }
+      else
+      {
+        return true;
+      }
+    }
+  }
+
+  bool parseUnary()
+  {
+    if(false == accept('-')) return parsePrimary();
+
+    if(false == parseUnary()) return false;
+    emitOperation(Operation::eNegate, 1);
+
+    return true;
+  }
+
+  bool parsePrimary()
+  {
+    skipSpaces();
+    if(m_Position >= m_Text.size()) return fail(QString("unexpected end"));
+
+    const QChar c = m_Text.at(m_Position);
+
+    if(true == accept('('))
+    {
+      if(false == parseExpression()) return false;
+      return (true == accept(')')) ? true : fail(QString("missing ')'"));
+    }
+
+    if(true == accept('['))
+    {
+      const int end = m_Text.indexOf(QChar(']'), m_Position);
+      if(0 > end) return fail(QString("missing ']'"));
+
+      const QString obisNumber = m_Text.mid(m_Position, end - m_Position).trimmed();
+      if(true == obisNumber.isEmpty()) return fail(QString("empty obis number"));
+
+      m_Position = end + 1;
+
+      int input = m_Expression.m_Inputs.indexOf(obisNumber);
+      if(0 > input)
+      {
+        input = m_Expression.m_Inputs.size();
+        m_Expression.m_Inputs.append(obisNumber);
+      }
+
+      emitPush(Instruction{Operation::ePushInput, input, 0.0});
+      return true;
+    }
+
+    if((true == c.isDigit()) || (QChar('.') == c))
+    {
+      const int start = m_Position;
+      while((m_Position < m_Text.size()) && ((true == m_Text.at(m_Position).isDigit()) ||
+                                             (QChar('.') == m_Text.at(m_Position))))
+      {
+        ++m_Position;
+      }
+
+      bool ok{};
+      const double constant = m_Text.mid(start, m_Position - start).toDouble(&ok);
+      if(false == ok) return fail(QString("invalid number '%1'").arg(m_Text.mid(start, m_Position - start)));
+
+      emitPush(Instruction{Operation::ePushConstant, -1, constant});
+      return true;
+    }
+
+    if(true == c.isLetter())
+    {
+      const int start = m_Position;
+      while((m_Position < m_Text.size()) && (true == m_Text.at(m_Position).isLetter())) ++m_Position;
+
+      return parseFunction(m_Text.mid(start, m_Position - start).toLower());
+    }
+
+    return fail(QString("unexpected '%1'").arg(c));
+  }
+
+  bool parseFunction(const QString &name)
+  {
+    if(false == accept('(')) return fail(QString("missing '(' after %1").arg(name));
+
+    int arguments = 0;
+
+    do
+    {
+      if(false == parseExpression()) return false;
+      ++arguments;
+    }
+    while(true == accept(','));
+
+    if(false == accept(')')) return fail(QString("missing ')' after the arguments of %1").arg(name));
+
+    if(QString("abs") == name)
+    {
+      if(1 != arguments) return fail(QString("abs takes a single argument"));
+      emitOperation(Operation::eAbs, 1);
+      return true;
+    }
+
+    //the variadic functions are folded into a chain of binary operations
+    Operation operation{};
+
+    if(QString("min") == name) operation = Operation::eMin;
+    else if(QString("max") == name) operation = Operation::eMax;
+    else if(QString("sum") == name) operation = Operation::eAdd;
+    else return fail(QString("unknown function %1").arg(name));
+
+    for(int i = 1; i < arguments; ++i) emitOperation(operation, 2);
+
+    return true;
+  }
+
+  void emitPush(const Instruction &instruction)
+  {
+    m_Expression.m_Instructions.append(instruction);
+
+    ++m_Depth;
+    m_Expression.m_StackSize = qMax(m_Expression.m_StackSize, m_Depth);
+  }
+
+  void emitOperation(const Operation &operation, int operands)
+  {
+    m_Expression.m_Instructions.append(Instruction{operation, -1, 0.0});
+
+    //every operation replaces its operands with a single result
+    m_Depth -= operands - 1;
+  }
+
+  bool accept(char c)
+  {
+    skipSpaces();
+    if((m_Position >= m_Text.size()) || (QChar(c) != m_Text.at(m_Position))) return false;
+
+    ++m_Position;
+    return true;
+  }
+
+  void skipSpaces()
+  {
+    while((m_Position < m_Text.size()) && (true == m_Text.at(m_Position).isSpace())) ++m_Position;
+  }
+
+  bool fail(const QString &error)
+  {
+    m_Expression.m_Error = QString("%1 at position %2").arg(error).arg(m_Position + 1);
+    return false;
+  }
+
+  const QString &m_Text;
+  int m_Position;
+  int m_Depth;
+  ChannelExpression &m_Expression;
+};
+//----------------------------------------------------------------------------------------------------------------------
+
+ChannelExpression ChannelExpression::Compile(const QString &text)
+{
+  ChannelExpression expression;
+
+  if(true == text.trimmed().isEmpty())
+  {
+    expression.m_Error = QString("empty expression");
+    return expression;
+  }
+
+  if(false == Parser(text, expression).parse())
+  {
+    expression.m_Instructions.clear();
+    expression.m_Inputs.clear();
+    expression.m_StackSize = 0;
+  }
+
+  return expression;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ChannelExpression::ChannelExpression()
+  : m_Instructions()
+  , m_Inputs()
+  , m_StackSize(0)
+  , m_Error()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ChannelExpression::isValid() const
+{
+  return (false == m_Instructions.isEmpty()) && (true == m_Error.isEmpty());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const QString &ChannelExpression::getError() const
+{
+  return m_Error;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const QStringList &ChannelExpression::getInputs() const
+{
+  return m_Inputs;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double ChannelExpression::evaluate(const QVector<double> &inputs) const
+{
+  if((false == isValid()) || (inputs.size() < m_Inputs.size())) return qQNaN();
+
+  QVarLengthArray<double, 16> stack(m_StackSize);
+  int top = -1;
+
+  for(const auto &instruction : m_Instructions)
+  {
+    switch(instruction.operation)
+    {
+      case Operation::ePushConstant: stack[++top] = instruction.constant; break;
+      case Operation::ePushInput: stack[++top] = inputs.at(instruction.input); break;
+      case Operation::eNegate: stack[top] = -stack[top]; break;
+      case Operation::eAbs: stack[top] = qAbs(stack[top]); break;
+      case Operation::eAdd: stack[top - 1] += stack[top]; --top; break;
+      case Operation::eSubtract: stack[top - 1] -= stack[top]; --top; break;
+      case Operation::eMultiply: stack[top - 1] *= stack[top]; --top; break;
+      case Operation::eDivide:
+        stack[top - 1] = (0.0 != stack[top]) ? stack[top - 1] / stack[top] : qQNaN();
+        --top;
+        break;
+      case Operation::eMin: stack[top - 1] = qMin(stack[top - 1], stack[top]); --top; break;
+      case Operation::eMax: stack[top - 1] = qMax(stack[top - 1], stack[top]); --top; break;
+    }
+  }
+
+  return stack[0];
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QStringList>
+
+namespace Ssmr
+{
+
+/**
+ * @brief The ChannelExpression class computes the value of a virtual channel from the values of other obis numbers
+ *
+ * The expression is parsed once and compiled into a flat list of stack machine instructions, so evaluating it for
+ * every received frame needs neither parsing nor allocations. Supported are numbers, obis numbers in brackets, the
+ * operators + - * / with the usual precedence, parentheses and the functions abs(x), min(...), max(...) and sum(...).
+ * Example for the net import: "[1-0:1.8.0*255] - [1-0:2.8.0*255]"
+ */
+class ChannelExpression
+{
+public:
+
+	/**
+	 * @brief Compile Parse the given expression
+	 * @param text
+	 * @return The compiled expression, invalid if the text could not be parsed, see getError()
+	 */
+	static ChannelExpression Compile(const QString &text);
+
+	/**
+	 * @brief ChannelExpression Default constructor creates an invalid instance
+	 */
+	ChannelExpression();
+
+	/**
+	 * @brief isValid
+	 * @return True if the expression was compiled successfully
+	 */
+	bool isValid() const;
+
+	/**
+	 * @brief getError
+	 * @return Why the expression could not be compiled, empty if it is valid
+	 */
+	const QString &getError() const;
+
+	/**
+	 * @brief getInputs
+	 * @return The distinct obis numbers the expression reads, in the order of their first use
+	 */
+	const QStringList &getInputs() const;
+
+	/**
+	 * @brief evaluate
+	 * @param inputs The values of the obis numbers returned by getInputs(), in the same order
+	 * @return The value of the expression, NaN if it is invalid or an input is missing
+	 */
+	double evaluate(const QVector<double> &inputs) const;
+
+private:
+
+	enum class Operation
+	{
+		ePushConstant,
+		ePushInput,
+		eAdd,
+		eSubtract,
+		eMultiply,
+		eDivide,
+		eNegate,
+		eAbs,
+		eMin,
+		eMax,
+	};
+
+	struct Instruction
+	{
+		Operation operation;
+
+		//!The input index of ePushInput
+		int input;
+
+		//!The value of ePushConstant
+		double constant;
+	};
+
+	class Parser;
+
+	/**
+	 * @brief m_Instructions The compiled expression in postfix order
+	 */
+	QVector<Instruction> m_Instructions;
+
+	/**
+	 * @brief m_Inputs The obis numbers read by ePushInput
+	 */
+	QStringList m_Inputs;
+
+	/**
+	 * @brief m_StackSize How many values the evaluation has to hold at most
+	 */
+	int m_StackSize;
+
+	/**
+	 * @brief m_Error Why the expression could not be compiled
+	 */
+	QString m_Error;
+};
+
+}
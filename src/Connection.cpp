@@ -1,10 +1,15 @@
 ﻿#include "Connection.h"
+#include "HelpFunctions.h"
+#include "TickScheduler.h"
+#include "EventLoopWatchdog.h"
 
 #include "sml/sml_file.h"
 #include "sml/sml_boolean.h"
+#include "sml/sml_time.h"
 
 #include <QDebug>
 #include <QDateTime>
+#include <QSettings>
 #include <QSerialPort>
 
 #include <QtMath>
@@ -12,22 +17,161 @@
 namespace Ssmr
 {
 
+namespace
+{
+  //the retention is checked with the received values, there is no need to do this more often than every hour
+  const qint64 cRetentionIntervalMs = 60 * 60 * 1000;
+
+  //the rules watching the frames wait for seconds at least, checking them every second is precise enough
+  const int cRuleCheckIntervalMs = 1000;
+
+  /*
+   * True if both mappings filter the stored values the same way, so a running compressor can be kept
+   */
+  bool IsSameFilter(const ObisValueMapping &a, const ObisValueMapping &b)
+  {
+    return (a.interval.toMilliseconds() == b.interval.toMilliseconds()) &&
+           (a.compression == b.compression) &&
+           (a.deviation == b.deviation) &&
+           (a.relativeDeviation == b.relativeDeviation) &&
+           (a.maxGap.toMilliseconds() == b.maxGap.toMilliseconds());
+  }
+
+  /*
+   * True if nothing which is shown or evaluated differs between both mappings
+   */
+  bool IsSameMapping(const ObisValueMapping &a, const ObisValueMapping &b)
+  {
+    return (true == IsSameFilter(a, b)) &&
+           (a.description == b.description) &&
+           (a.unit == b.unit) &&
+           (a.window.toMilliseconds() == b.window.toMilliseconds()) &&
+           (a.expression == b.expression);
+  }
+
+  RollupConfiguration LoadRollupConfiguration()
+  {
+    QSettings settings;
+    return RollupConfiguration::Load(settings);
+  }
+
+  DemandConfiguration LoadDemandConfiguration()
+  {
+    QSettings settings;
+    return DemandConfiguration::Load(settings);
+  }
+
+  QList<RuleDefinition> LoadRules(const QString &connectionName)
+  {
+    QSettings settings;
+
+    QList<RuleDefinition> rules;
+    for(const auto &rule : RuleDefinition::Load(settings))
+    {
+      if(true == rule.appliesTo(connectionName)) rules.append(rule);
+    }
+
+    return rules;
+  }
+
+  StepDetectorConfiguration LoadStepDetectorConfiguration()
+  {
+    QSettings settings;
+    return StepDetectorConfiguration::Load(settings);
+  }
+
+  PowerDerivationConfiguration LoadPowerDerivationConfiguration()
+  {
+    QSettings settings;
+    return PowerDerivationConfiguration::Load(settings);
+  }
+
+  /*
+   * Reads the time of an SML entry, the clock and time are left unchanged if the meter did not send one
+   */
+  void ReadMeterTime(const sml_time *time, MeterClock &clock, qint64 &milliseconds)
+  {
+    if((nullptr == time) || (nullptr == time->tag)) return;
+
+    if((SML_TIME_SEC_INDEX == *time->tag) && (nullptr != time->data.sec_index))
+    {
+      clock = MeterClock::eSecondIndex;
+      milliseconds = static_cast<qint64>(*time->data.sec_index) * 1000;
+    }
+    else if((SML_TIME_TIMESTAMP == *time->tag) && (nullptr != time->data.timestamp))
+    {
+      clock = MeterClock::eTimestamp;
+      milliseconds = static_cast<qint64>(*time->data.timestamp) * 1000;
+    }
+  }
+}
+
 Connection::Connection(const ConnectionData &data, QObject *parent)
   : QObject(parent)
   , m_ConnectionData(data)
   , m_ConnectionDuration()
-  , m_ConnectionUpdate(new QTimer(this))
+  , m_RuleCheck(-1)
   , m_SerialPort(new QSerialPort(this))
+  , m_ReceiveBuffer()
+  , m_ObisValueMapping()
+  , m_MappedObisNumbers()
+  , m_Compressors()
+  , m_Statistics()
+  , m_VirtualChannels()
+  , m_LatestValues()
+  , m_Rollups(LoadRollupConfiguration())
+  , m_CalendarAggregates()
+  , m_Demand(LoadDemandConfiguration())
+  , m_PowerDerivation(LoadPowerDerivationConfiguration())
+  , m_Rules()
+  , m_StepDetectors()
+  , m_LastRetention(0)
 {
-  QObject::connect(m_ConnectionUpdate, &QTimer::timeout, this, &Connection::onConnectionUpdate);
-  QObject::connect(m_SerialPort, &QSerialPort::readyRead, this, &Connection::onDataReceived);
+  m_CalendarAggregates.load(getCalendarFilePath());
+  m_Demand.load(getDemandFilePath());
+
+  for(const auto &obisNumber : m_ConnectionData.getMappingObisNumbers())
+  {
+    m_MappedObisNumbers.insert(obisNumber);
+  }
+
+  resetCompressors();
+  resetStatistics();
+  resetVirtualChannels();
+  resetRules();
+
+  m_Rollups.setBucketClosedCallback([this](const QString &obisNumber,
+                                           const RollupTier &tier,
+                                           const RollupBucket &bucket)
+  {
+    emit rollupBucketClosed(obisNumber, tier, bucket);
+  });
 
-  m_ConnectionUpdate->start(100);
+  m_Demand.setIntervalClosedCallback([this](const DemandPeak &interval)
+  {
+    emit demandIntervalClosed(interval);
+  });
+
+  const auto steps = LoadStepDetectorConfiguration();
+  for(const auto &obisNumber : steps.obisNumbers)
+  {
+    StepDetector detector(steps.minimum);
+    detector.setStepCallback([this, obisNumber](const StepEvent &event)
+    {
+      emit stepDetected(obisNumber, event);
+    });
+
+    m_StepDetectors.insert(obisNumber, detector);
+  }
+
+  QObject::connect(m_SerialPort, &QSerialPort::readyRead, this, &Connection::onDataReceived);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
 Connection::~Connection()
 {
+  m_CalendarAggregates.save(getCalendarFilePath());
+  m_Demand.save(getDemandFilePath());
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -79,38 +223,76 @@ const QSerialPort *Connection::getSerialPort() const
 }
 //----------------------------------------------------------------------------------------------------------------------
 
+const RollupStore &Connection::getRollups() const
+{
+  return m_Rollups;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const CalendarAggregates &Connection::getCalendarAggregates() const
+{
+  return m_CalendarAggregates;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const DemandTracker &Connection::getDemand() const
+{
+  return m_Demand;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const StreamingStatistics *Connection::getStatistics(const QString &obisNumber) const
+{
+  const auto statistics = m_Statistics.find(obisNumber);
+
+  return (statistics != m_Statistics.cend()) ? &statistics.value() : nullptr;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
 bool Connection::isConnected() const
 {
   return (nullptr != m_SerialPort) ? m_SerialPort->isOpen() : false;
 }
 //----------------------------------------------------------------------------------------------------------------------
 
+qint64 Connection::getConnectionTime() const
+{
+  return ((true == isConnected()) && (true == m_ConnectionDuration.isValid())) ? m_ConnectionDuration.elapsed() : 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
 void Connection::disconnect()
 {
   if(nullptr != m_SerialPort)
   {
     m_ConnectionDuration.invalidate();
+    TickScheduler::Instance()->unsubscribe(m_RuleCheck);
+    m_RuleCheck = -1;
+
     m_SerialPort->clearError();
     m_SerialPort->close();
 
-    emit connectionChanged(false);
-  }
-}
-//----------------------------------------------------------------------------------------------------------------------
+    resetCompressors();
 
-void Connection::onConnectionUpdate()
-{
-  if(false == isValid()) return;
+    //the time without connection must not be held in the running demand interval
+    m_Demand.reset();
 
-  if(true == isConnected())
-  {
-     emit connectionTimeChanged(m_ConnectionDuration.elapsed());
+    //virtual channels must not combine values from before and after the connection was closed
+    m_LatestValues.clear();
+    m_PowerDerivation.reset();
+    m_Rules.reset(-1);
+
+    for(auto &detector : m_StepDetectors) detector.reset();
+
+    emit connectionChanged(false);
   }
 }
 //----------------------------------------------------------------------------------------------------------------------
 
 void Connection::onDataReceived()
 {
+  const WatchdogScope scope("Connection::onDataReceived()");
+
   if(nullptr == m_SerialPort) return;
 
   //append raw bytes
@@ -148,6 +330,8 @@ int Connection::parseSmlData(const QByteArray &message)
   while((0 <= newStartIndex) && (0 < newEndIndex))
   {
     const qint64 timestamp  = QDateTime::currentMSecsSinceEpoch();
+    QSet<QString> updated;
+    QList<QPair<QString, double>> derivedPowers;
 
     #ifdef QT_DEBUG
     qDebug() << "Connection::onDataReceived() frame from=" << newStartIndex << " to=" << newEndIndex;
@@ -176,6 +360,11 @@ int Connection::parseSmlData(const QByteArray &message)
       {
         sml_get_list_response *body = reinterpret_cast<sml_get_list_response*>(message->message_body->data);
 
+        //the time of the whole list, an entry may still have its own
+        MeterClock listClock = MeterClock::eReceived;
+        qint64 listTime = timestamp;
+        ReadMeterTime(body->act_sensor_time, listClock, listTime);
+
         for(sml_list *entry = body->val_list; entry != NULL; entry = entry->next)
         {
           // do not crash on null value
@@ -228,22 +417,54 @@ int Connection::parseSmlData(const QByteArray &message)
             if(true == ok) value = QVariant::fromValue(doubleValue);
           }
 
-          m_ObisValueMapping[obisValue].append(timestamp, value);
-          #ifdef QT_DEBUG
-          qDebug() << "Connection::parseSmlData() found obisValue=" << obisValue << " timestamp=" << timestamp
-                   << " value=" << value;
-          #endif
+          processValue(obisValue, timestamp, value);
 
-          emit dataValueReceived(obisValue, timestamp, value);
+          //the inputs of the virtual channels, they are evaluated once the whole frame is known
+          if(QMetaType::Double == value.userType())
+          {
+            m_LatestValues.insert(obisValue, value.toDouble());
+            updated.insert(obisValue);
+          }
+
+          const QString powerObisValue = PowerDerivation::PowerObisNumber(obisValue);
+
+          if((false == powerObisValue.isEmpty()) && (QMetaType::Double == value.userType()))
+          {
+            MeterClock clock = listClock;
+            qint64 time = listTime;
+            ReadMeterTime(entry->val_time, clock, time);
+
+            const double power = m_PowerDerivation.addSample(obisValue, clock, time, value.toDouble());
+            if(false == qIsNaN(power)) derivedPowers.append(qMakePair(powerObisValue, power));
+          }
         }
       }
     }
 
+    //a power the meter sends itself is preferred to the derived one
+    for(const auto &power : derivedPowers)
+    {
+      if(true == updated.contains(power.first)) continue;
+
+      processValue(power.first, timestamp, QVariant::fromValue(power.second));
+
+      m_LatestValues.insert(power.first, power.second);
+      updated.insert(power.first);
+    }
+
+    evaluateVirtualChannels(timestamp, updated);
+    m_Rules.addFrame(timestamp);
+
     newStartIndex = message.indexOf(cbaMessageStart, lastEndIndex);
     newEndIndex = message.indexOf(cbaMessageEnd, newStartIndex + cbaMessageStart.size());
 
     // free the malloc'd memory
     sml_file_free(file);
+
+    if(timestamp - m_LastRetention >= cRetentionIntervalMs)
+    {
+      applyRetention(timestamp);
+    }
   }
 
   //where we stopped reading
@@ -251,13 +472,255 @@ int Connection::parseSmlData(const QByteArray &message)
 }
 //----------------------------------------------------------------------------------------------------------------------
 
-void Connection::setConnectionData(const ConnectionData &data)
+void Connection::processValue(const QString &obisValue, const qint64 &timestamp, const QVariant &value)
 {
-  if(true == isConnected())
+  m_ObisValueMapping[obisValue].append(timestamp, value);
+
+  if((true == m_MappedObisNumbers.contains(obisValue)) && (QMetaType::Double != value.userType()))
   {
-    disconnect();
+    //values which cannot be compressed, e.g. booleans, are only throttled by the interval
+    auto compressor = m_Compressors.find(obisValue);
+    if((compressor != m_Compressors.end()) && (true == compressor->passesInterval(timestamp)))
+    {
+      emit dataValueAccepted(obisValue, timestamp, value);
+    }
   }
 
+  if((true == m_MappedObisNumbers.contains(obisValue)) && (QMetaType::Double == value.userType()))
+  {
+    compress(obisValue, timestamp, value.toDouble());
+    m_Rollups.addSample(obisValue, timestamp, value.toDouble());
+
+    auto statistics = m_Statistics.find(obisValue);
+    if(statistics != m_Statistics.end()) statistics->addSample(timestamp, value.toDouble());
+
+    if(true == CalendarAggregates::IsEnergyCounter(obisValue))
+    {
+      m_CalendarAggregates.addSample(obisValue, timestamp, value.toDouble());
+    }
+  }
+
+  if((obisValue == m_Demand.getConfiguration().obisNumber) && (QMetaType::Double == value.userType()))
+  {
+    m_Demand.addSample(timestamp, value.toDouble());
+    emit demandChanged(m_Demand.getProjectedDemand(), m_Demand.getPeakDemand());
+  }
+
+  if(QMetaType::Double == value.userType())
+  {
+    m_Rules.addSample(obisValue, timestamp, value.toDouble());
+
+    auto detector = m_StepDetectors.find(obisValue);
+    if(detector != m_StepDetectors.end()) detector->addSample(timestamp, value.toDouble());
+  }
+
+  #ifdef QT_DEBUG
+  qDebug() << "Connection::processValue() obisValue=" << obisValue << " timestamp=" << timestamp
+           << " value=" << value;
+  #endif
+
+  emit dataValueReceived(obisValue, timestamp, value);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void Connection::evaluateVirtualChannels(const qint64 &timestamp, QSet<QString> &updated)
+{
+  if(true == updated.isEmpty()) return;
+
+  //the channels are evaluated in the configured order, so a channel can use the ones configured before it
+  for(auto &channel : m_VirtualChannels)
+  {
+    const auto &inputs = channel.expression.getInputs();
+
+    bool changed = false;
+    bool complete = true;
+
+    for(int i = 0; (i < inputs.size()) && (true == complete); ++i)
+    {
+      const auto latest = m_LatestValues.constFind(inputs.at(i));
+
+      complete = (latest != m_LatestValues.cend());
+      if(false == complete) continue;
+
+      channel.inputs[i] = latest.value();
+      changed = (true == changed) || (true == updated.contains(inputs.at(i)));
+    }
+
+    if((false == complete) || (false == changed)) continue;
+
+    const double result = channel.expression.evaluate(channel.inputs);
+    if(true == qIsNaN(result)) continue;
+
+    processValue(channel.obisNumber, timestamp, QVariant::fromValue(result));
+
+    m_LatestValues.insert(channel.obisNumber, result);
+    updated.insert(channel.obisNumber);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void Connection::applyRetention(const qint64 &now)
+{
+  m_LastRetention = now;
+
+  m_CalendarAggregates.save(getCalendarFilePath());
+  m_Demand.save(getDemandFilePath());
+
+  const auto rawRetention = m_Rollups.getConfiguration().rawRetention;
+  if(false == rawRetention.isValid()) return;
+
+  for(auto &values : m_ObisValueMapping)
+  {
+    values.removeBefore(now - static_cast<qint64>(rawRetention.toMilliseconds()));
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void Connection::compress(const QString &obisNumber, const qint64 &timestamp, const double &value)
+{
+  auto compressor = m_Compressors.find(obisNumber);
+  if(compressor == m_Compressors.end()) return;
+
+  for(const auto &sample : compressor->addSample(timestamp, value))
+  {
+    emit dataValueAccepted(obisNumber, sample.first, QVariant::fromValue(sample.second));
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void Connection::resetCompressors()
+{
+  for(auto it = m_Compressors.begin(); it != m_Compressors.end(); ++it)
+  {
+    for(const auto &sample : it->flush())
+    {
+      emit dataValueAccepted(it.key(), sample.first, QVariant::fromValue(sample.second));
+    }
+  }
+
+  m_Compressors.clear();
+
+  for(const auto &mapping : m_ConnectionData.mappings)
+  {
+    if(false == mapping.isValid()) continue;
+
+    m_Compressors.insert(mapping.obisNumber, SeriesCompressor(mapping));
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void Connection::updateCompressors(const QList<ObisValueMapping> &previous)
+{
+  QMap<QString, SeriesCompressor> compressors;
+
+  for(const auto &mapping : m_ConnectionData.mappings)
+  {
+    if(false == mapping.isValid()) continue;
+
+    const auto existing = m_Compressors.find(mapping.obisNumber);
+    bool unchanged = false;
+
+    for(const auto &old : previous)
+    {
+      if(old.obisNumber == mapping.obisNumber) unchanged = IsSameFilter(old, mapping);
+    }
+
+    if((existing != m_Compressors.end()) && (true == unchanged))
+    {
+      compressors.insert(mapping.obisNumber, existing.value());
+      m_Compressors.erase(existing);
+    }
+    else
+    {
+      compressors.insert(mapping.obisNumber, SeriesCompressor(mapping));
+    }
+  }
+
+  //the compressors left are removed or filter differently now, their held back values are stored first
+  for(auto it = m_Compressors.begin(); it != m_Compressors.end(); ++it)
+  {
+    for(const auto &sample : it->flush())
+    {
+      emit dataValueAccepted(it.key(), sample.first, QVariant::fromValue(sample.second));
+    }
+  }
+
+  m_Compressors = compressors;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void Connection::resetVirtualChannels()
+{
+  m_VirtualChannels.clear();
+
+  for(const auto &mapping : m_ConnectionData.getVirtualMappings())
+  {
+    const auto expression = ChannelExpression::Compile(mapping.expression);
+
+    if(false == expression.isValid())
+    {
+      qWarning() << "Connection::resetVirtualChannels() ignoring obis=" << mapping.obisNumber
+                 << "invalid expression:" << expression.getError();
+      continue;
+    }
+
+    m_VirtualChannels.append(VirtualChannel{mapping.obisNumber,
+                                            expression,
+                                            QVector<double>(expression.getInputs().size(), qQNaN())});
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void Connection::resetRules()
+{
+  m_Rules = RuleEngine(LoadRules(m_ConnectionData.name));
+
+  m_Rules.setTriggeredCallback([this](const RuleDefinition &rule, const qint64 &timestamp, const double &value)
+  {
+    emit ruleTriggered(rule, timestamp, value);
+  });
+
+  if(true == isConnected()) m_Rules.reset(QDateTime::currentMSecsSinceEpoch());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void Connection::resetStatistics()
+{
+  QMap<QString, StreamingStatistics> statistics;
+
+  for(const auto &mapping : m_ConnectionData.mappings)
+  {
+    if((false == mapping.isValid()) || (false == mapping.window.isValid())) continue;
+
+    const auto existing = m_Statistics.find(mapping.obisNumber);
+    const bool unchanged = (existing != m_Statistics.end()) &&
+                           (existing->getWindow().toMilliseconds() == mapping.window.toMilliseconds());
+
+    statistics.insert(mapping.obisNumber, (true == unchanged) ? existing.value() : StreamingStatistics(mapping.window));
+  }
+
+  m_Statistics = statistics;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString Connection::getCalendarFilePath() const
+{
+  return CalendarAggregates::GetFilePath(m_ConnectionData.name);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString Connection::getDemandFilePath() const
+{
+  return GetLogDirectory().absoluteFilePath(QString("%1_demand.csv").arg(m_ConnectionData.name));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void Connection::setConnectionData(const ConnectionData &data)
+{
+  //reopening the port loses the frames in between, so it is only done if the port itself changed
+  const bool reopen = (true == isConnected()) && (false == m_ConnectionData.hasSamePort(data));
+  if(true == reopen) disconnect();
+
   QList<ObisValueMapping> addedMapping;
   QList<ObisValueMapping> removedMapping;
 
@@ -290,10 +753,43 @@ void Connection::setConnectionData(const ConnectionData &data)
     removedMapping.append(mapping);
   }
 
+  QList<ObisValueMapping> changedMapping;
+
+  for(const auto &mapping : data.mappings)
+  {
+    const auto existing = m_ConnectionData.getMappingByObisNumber(mapping.obisNumber);
+    if((false == existing.isValid()) || (true == IsSameMapping(existing, mapping))) continue;
+
+    changedMapping.append(mapping);
+  }
+
+  const auto previousMappings = m_ConnectionData.mappings;
+
+  //the rules are stored per connection name, their state is kept on any other change
+  const bool renamed = (data.name != m_ConnectionData.name);
+
   m_ConnectionData = data;
+  m_MappedObisNumbers = newObisNumbers;
+
+  //all tables are rebuilt before the next frame is parsed, the serial session and a partial frame are kept
+  updateCompressors(previousMappings);
+  resetStatistics();
+  resetVirtualChannels();
+  if(true == renamed) resetRules();
+
+  for(const auto &mapping : removedMapping)
+  {
+    m_Rollups.removeSeries(mapping.obisNumber);
+    m_CalendarAggregates.removeSeries(mapping.obisNumber);
+  }
 
   for(const auto &mapping : addedMapping) emit mappingAdded(mapping);
   for(const auto &mapping : removedMapping) emit mappingRemoved(mapping);
+  for(const auto &mapping : changedMapping) emit mappingChanged(mapping);
+
+  if(true == renamed) emit nameChanged(m_ConnectionData.name);
+
+  if(true == reopen) connect();
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -315,6 +811,13 @@ bool Connection::connect()
   if(true == connected)
   {
     m_ConnectionDuration.restart();
+    m_Rules.reset(QDateTime::currentMSecsSinceEpoch());
+
+    //only the rules watching the frames depend on the time, all others are evaluated with the values
+    m_RuleCheck = TickScheduler::Instance()->subscribe(this, cRuleCheckIntervalMs, [this](const qint64 &now)
+    {
+      m_Rules.check(now);
+    });
     emit connectionChanged(connected);
   }
 
@@ -2,6 +2,8 @@
 
 #include <memory>
 
+#include <QSet>
+#include <QHash>
 #include <QList>
 #include <QDebug>
 #include <QTimer>
@@ -10,6 +12,15 @@
 #include <QElapsedTimer>
 #include <QSerialPortInfo>
 
+#include "Rollup.h"
+#include "RuleEngine.h"
+#include "ChannelExpression.h"
+#include "DemandTracker.h"
+#include "PowerDerivation.h"
+#include "SeriesCompressor.h"
+#include "StepDetector.h"
+#include "StreamingStatistics.h"
+#include "CalendarAggregates.h"
 #include "TypeDefinitions.h"
 
 namespace Ssmr
@@ -41,7 +52,9 @@ public:
 	virtual ~Connection() override;
 
 	/**
-	 * @brief setConnectionData Set a new connection data, this will disconnect the connection if connected
+	 * @brief setConnectionData Set a new connection data, the mappings are applied live between two frames
+	 *
+	 * An open connection is only reopened if the serial port or the protocol changed.
 	 * @param data
 	 */
 	void setConnectionData(const ConnectionData &data);
@@ -94,12 +107,43 @@ public:
 	 */
 	const QSerialPort* getSerialPort() const;
 
+	/**
+	 * @brief getRollups
+	 * @return The rollup tiers maintained for all mapped numeric values
+	 */
+	const RollupStore &getRollups() const;
+
+	/**
+	 * @brief getCalendarAggregates
+	 * @return The consumption per day, week and month of all mapped energy counters
+	 */
+	const CalendarAggregates &getCalendarAggregates() const;
+
+	/**
+	 * @brief getDemand
+	 * @return The demand tracker of the configured momentary power
+	 */
+	const DemandTracker &getDemand() const;
+
+	/**
+	 * @brief getStatistics
+	 * @param obisNumber
+	 * @return The streaming statistics of the given mapped value, nullptr if the mapping has no statistics window
+	 */
+	const StreamingStatistics* getStatistics(const QString &obisNumber) const;
+
 	/**
 	 * @brief isConnected
 	 * @return True if already connected
 	 */
 	bool isConnected() const;
 
+	/**
+	 * @brief getConnectionTime
+	 * @return How long the connection is open in milliseconds, 0 if it is closed
+	 */
+	qint64 getConnectionTime() const;
+
 	/**
 	 * @brief connect
 	 * @return True if connection could be established
@@ -120,10 +164,10 @@ signals:
 	void connectionChanged(bool connected);
 
 	/**
-	 * @brief connectionTimeChanged Emitted with the new connection time in milliseconds
-	 * @param elapsedMilliseconds
+	 * @brief nameChanged Emitted when the connection was renamed by setConnectionData
+	 * @param name The new name
 	 */
-	void connectionTimeChanged(qint64 elapsedMilliseconds);
+	void nameChanged(const QString &name);
 
 	/**
 	 * @brief dataValueReceived Emitted when a new data value for a given obis number is received
@@ -133,6 +177,17 @@ signals:
 	 */
 	void dataValueReceived(const QString &obisValue, const qint64 &timestamp, const QVariant &dataValue);
 
+	/**
+	 * @brief dataValueAccepted Emitted for the values of a mapping which have to be stored
+	 * @param obisValue The obis number received
+	 * @param timestamp Time in milliseconds since epoc
+	 * @param dataValue The numeric value
+	 *
+	 * The values passed the interval and compression of the mapping, see SeriesCompressor. Held back values are
+	 * emitted delayed, at the latest when the connection is closed.
+	 */
+	void dataValueAccepted(const QString &obisValue, const qint64 &timestamp, const QVariant &dataValue);
+
 	/**
 	 * @brief mappingAdded A new mapping added for this connection
 	 * @param mapping
@@ -145,12 +200,49 @@ signals:
 	 */
 	void mappingRemoved(const ObisValueMapping &mapping);
 
-private slots:
+	/**
+	 * @brief mappingChanged The description, unit, interval or filter of an existing mapping changed
+	 * @param mapping The new mapping
+	 */
+	void mappingChanged(const ObisValueMapping &mapping);
+
+	/**
+	 * @brief rollupBucketClosed Emitted when a rollup bucket of a mapped value is complete
+	 * @param obisNumber
+	 * @param tier
+	 * @param bucket
+	 */
+	void rollupBucketClosed(const QString &obisNumber, const RollupTier &tier, const RollupBucket &bucket);
+
+	/**
+	 * @brief demandChanged Emitted for every received value of the demand series
+	 * @param projected The demand the running interval will end with if the power stays as it is
+	 * @param peak The highest demand of the current billing period, NaN if none
+	 */
+	void demandChanged(double projected, double peak);
 
 	/**
-	 * @brief onConnectionUpdate Handle connection timer updates
+	 * @brief demandIntervalClosed Emitted when a demand interval is complete
+	 * @param interval
 	 */
-	void onConnectionUpdate();
+	void demandIntervalClosed(const DemandPeak &interval);
+
+	/**
+	 * @brief ruleTriggered Emitted when the condition of a rule held for its duration
+	 * @param rule
+	 * @param timestamp Time in milliseconds since epoch
+	 * @param value The value which triggered the rule
+	 */
+	void ruleTriggered(const RuleDefinition &rule, const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief stepDetected Emitted when a step of a watched series was detected, e.g. an appliance switched on
+	 * @param obisNumber
+	 * @param event
+	 */
+	void stepDetected(const QString &obisNumber, const StepEvent &event);
+
+private slots:
 
 	/**
 	 * @brief onDataReceived Called with new serial data to be processed
@@ -168,6 +260,11 @@ private:
 			values.append(qMakePair(t,v));
 		}
 
+		void removeBefore(qint64 t)
+		{
+			while((false == values.isEmpty()) && (values.first().first < t)) values.removeFirst();
+		}
+
 		bool toSamples(QList<QPair<qint64, double>> &samples)
 		{
 			if(false == values.isEmpty()) return false;
@@ -189,6 +286,74 @@ private:
 	 */
 	int parseSmlData(const QByteArray &message);
 
+	/**
+	 * @brief processValue Pass a received or computed value to the compressors, statistics and aggregates and emit it
+	 * @param obisValue
+	 * @param timestamp
+	 * @param value
+	 */
+	void processValue(const QString &obisValue, const qint64 &timestamp, const QVariant &value);
+
+	/**
+	 * @brief evaluateVirtualChannels Compute the virtual channels of a frame whose inputs were updated by it
+	 * @param timestamp The time of the frame
+	 * @param updated The obis numbers received with the frame, the computed ones are added
+	 */
+	void evaluateVirtualChannels(const qint64 &timestamp, QSet<QString> &updated);
+
+	/**
+	 * @brief applyRetention Prune the kept raw values and rollups according to the configured retention
+	 * @param now Time in milliseconds since epoch
+	 */
+	void applyRetention(const qint64 &now);
+
+	/**
+	 * @brief compress Pass a numeric value of a mapping to its compressor and emit the values to store
+	 * @param obisNumber
+	 * @param timestamp
+	 * @param value
+	 */
+	void compress(const QString &obisNumber, const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief resetCompressors Emit all held back values and recreate the compressors from the current mappings
+	 */
+	void resetCompressors();
+
+	/**
+	 * @brief updateCompressors Recreate only the compressors whose filter settings changed, the others keep their state
+	 * @param previous The mappings before the change
+	 */
+	void updateCompressors(const QList<ObisValueMapping> &previous);
+
+	/**
+	 * @brief resetStatistics Create the streaming statistics of the current mappings, statistics whose window did not
+	 * change are kept
+	 */
+	void resetStatistics();
+
+	/**
+	 * @brief resetVirtualChannels Compile the expressions of the current virtual mappings
+	 */
+	void resetVirtualChannels();
+
+	/**
+	 * @brief resetRules Compile the rules which apply to this connection
+	 */
+	void resetRules();
+
+	/**
+	 * @brief getCalendarFilePath
+	 * @return Where the calendar aggregates of this connection are stored
+	 */
+	QString getCalendarFilePath() const;
+
+	/**
+	 * @brief getDemandFilePath
+	 * @return Where the demand peaks of this connection are stored
+	 */
+	QString getDemandFilePath() const;
+
 	/**
 	 * @brief m_ConnectionData The connection information
 	 */
@@ -200,9 +365,9 @@ private:
 	QElapsedTimer m_ConnectionDuration;
 
 	/**
-	 * @brief m_ConnectionUpdate Handle period connection updates
+	 * @brief m_RuleCheck The tick subscription checking the rules while connected, -1 while disconnected
 	 */
-	QTimer* m_ConnectionUpdate;
+	int m_RuleCheck;
 
 	/**
 	 * @brief m_SerialPort The underlying serial port object used for this connection
@@ -218,6 +383,78 @@ private:
 	 * @brief m_ObisValueMapping Map from the obis strings to the list of received values
 	 */
 	QMap<QString, ObisValueList> m_ObisValueMapping;
+
+	/**
+	 * @brief m_MappedObisNumbers The obis numbers of all mappings for fast lookups while parsing
+	 */
+	QSet<QString> m_MappedObisNumbers;
+
+	/**
+	 * @brief m_Compressors Decide which values of each mapping are stored, by obis number
+	 */
+	QMap<QString, SeriesCompressor> m_Compressors;
+
+	/**
+	 * @brief m_Statistics The streaming statistics of the mappings with a statistics window, by obis number
+	 */
+	QMap<QString, StreamingStatistics> m_Statistics;
+
+	/**
+	 * @brief The VirtualChannel struct contains a compiled virtual mapping
+	 */
+	struct VirtualChannel
+	{
+		QString obisNumber;
+		ChannelExpression expression;
+
+		//!The values of the expression inputs, kept to evaluate without allocations
+		QVector<double> inputs;
+	};
+
+	/**
+	 * @brief m_VirtualChannels The compiled virtual mappings in the configured order
+	 */
+	QList<VirtualChannel> m_VirtualChannels;
+
+	/**
+	 * @brief m_LatestValues The last numeric value of every received and computed obis number, the virtual channel inputs
+	 */
+	QHash<QString, double> m_LatestValues;
+
+	/**
+	 * @brief m_Rollups The rollup tiers of all mapped numeric values
+	 */
+	RollupStore m_Rollups;
+
+	/**
+	 * @brief m_CalendarAggregates The consumption per calendar period of all mapped energy counters
+	 */
+	CalendarAggregates m_CalendarAggregates;
+
+	/**
+	 * @brief m_Demand The demand intervals and billing period peaks of the configured momentary power
+	 */
+	DemandTracker m_Demand;
+
+	/**
+	 * @brief m_PowerDerivation Derives the power of the energy counters which is not sent by the meter
+	 */
+	PowerDerivation m_PowerDerivation;
+
+	/**
+	 * @brief m_Rules The alarm rules of this connection
+	 */
+	RuleEngine m_Rules;
+
+	/**
+	 * @brief m_StepDetectors The step detectors of the watched series, by obis number
+	 */
+	QMap<QString, StepDetector> m_StepDetectors;
+
+	/**
+	 * @brief m_LastRetention When the retention was applied and the calendar aggregates were stored the last time
+	 */
+	qint64 m_LastRetention;
 };
 
 }
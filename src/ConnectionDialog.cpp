@@ -20,12 +20,15 @@ namespace
 {
 
 /*
- * The default monitored values with a 1h monitoring interval, except for the output which is instantanous
+ * The default monitored values with a 1h monitoring interval, except for the output which is instantanous and keeps
+ * statistics over the last hour
  */
 const QList<ObisValueMapping> cDefaultObisValueMapping = {{"1-0:1.8.0*255", "Supply total", "Wh", {1, 0, 0}},
                                                           {"1-0:1.8.1*255", "Supply during T1", "Wh", {1, 0, 0}},
                                                           {"1-0:1.8.2*255", "Supply during T2", "Wh", {1, 0, 0}},
-                                                          {"1-0:16.7.0*255", "Momentary output", "Wh", {0, 0, 0}}};
+                                                          {"1-0:16.7.0*255", "Momentary output", "Wh", {0, 0, 0},
+                                                           CompressionMethod::eNone, 0.0, false, {0, 0, 0},
+                                                           {1, 0, 0}}};
 
 }
 
@@ -40,6 +43,7 @@ ConnectionDialog::ConnectionDialog(const ConnectionData &data,
 
   loadSerialPorts();
   loadCommunicationProtocols();
+  loadStorageBackends();
   loadObisValueMappings();
 
   ui->edtName->setText(m_CurrentData.name);
@@ -95,10 +99,18 @@ void Ssmr::ConnectionDialog::on_comboBoxProtocol_activated(int index)
 }
 //----------------------------------------------------------------------------------------------------------------------
 
+void ConnectionDialog::on_comboBoxStorage_activated(int index)
+{
+  Q_UNUSED(index)
+
+  m_CurrentData.storage = ui->comboBoxStorage->currentData().value<StorageBackend>();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
 void ConnectionDialog::on_btnAdd_clicked()
 {
   const int pos = findChildren<ObisValueMappingWidget*>().count();
-  ObisValueMappingWidget* widget = new ObisValueMappingWidget({}, {}, {}, {}, this);
+  ObisValueMappingWidget* widget = new ObisValueMappingWidget({}, this);
 
   ui->verticalLayoutMappings->insertWidget(pos, widget);
 
@@ -181,6 +193,21 @@ void ConnectionDialog::loadCommunicationProtocols()
 }
 //----------------------------------------------------------------------------------------------------------------------
 
+void ConnectionDialog::loadStorageBackends()
+{
+  const auto storageMapping = GetStorageBackendDescriptionsMapping();
+  for(const auto &storage : storageMapping.keys())
+  {
+    const auto translator = storageMapping.value(storage);
+    if(nullptr == translator) continue;
+
+    ui->comboBoxStorage->addItem(translator(), QVariant::fromValue(storage));
+  }
+
+  ui->comboBoxStorage->setCurrentIndex(ui->comboBoxStorage->findData(QVariant::fromValue(m_CurrentData.storage)));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
 void ConnectionDialog::loadObisValueMappings()
 {
   if(true == m_CurrentData.mappings.isEmpty())
@@ -191,11 +218,7 @@ void ConnectionDialog::loadObisValueMappings()
   for(const auto &mapping : m_CurrentData.mappings)
   {
     const int pos = findChildren<ObisValueMappingWidget*>().count();
-    ObisValueMappingWidget* widget = new ObisValueMappingWidget(mapping.obisNumber,
-                                                                mapping.description,
-                                                                mapping.unit,
-                                                                mapping.interval,
-                                                                this);
+    ObisValueMappingWidget* widget = new ObisValueMappingWidget(mapping, this);
 
     ui->verticalLayoutMappings->insertWidget(pos, widget);
     m_CurrentMappingWidget = widget;
@@ -56,6 +56,12 @@ private slots:
 	 */
 	void on_comboBoxProtocol_activated(int index);
 
+	/**
+	 * @brief on_comboBoxStorage_activated Update the storage backend of the connection
+	 * @param index
+	 */
+	void on_comboBoxStorage_activated(int index);
+
 	/**
 	 * @brief on_btnAdd_clicked Add an empty obis mapping
 	 */
@@ -80,6 +86,11 @@ private:
 	 */
 	void loadCommunicationProtocols();
 
+	/**
+	 * @brief loadStorageBackends fill storage backend list and select current backend
+	 */
+	void loadStorageBackends();
+
 	/**
 	 * @brief loadObisValueMappings fill list with existing obis value mappings if available
 	 */
@@ -0,0 +1,106 @@
+#include "ConnectionListModel.h"
+
+#include <QIcon>
+
+namespace Ssmr
+{
+
+ConnectionListModel::ConnectionListModel(QObject *parent)
+  : QAbstractListModel(parent)
+  , m_Connections()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int ConnectionListModel::rowCount(const QModelIndex &parent) const
+{
+  if(true == parent.isValid()) return 0;
+
+  return m_Connections.size();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QVariant ConnectionListModel::data(const QModelIndex &index, int role) const
+{
+  const auto connection = getConnection(index);
+  if(nullptr == connection) return {};
+
+  switch(role)
+  {
+    case Qt::DisplayRole:
+      return connection->getName();
+
+    case Qt::DecorationRole:
+      return (true == connection->isConnected()) ? QIcon(":/connect.png") : QIcon(":/disconnect.png");
+
+    default:
+      return {};
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ConnectionListModel::addConnection(const ConnectionPtr &connection)
+{
+  if((nullptr == connection) || (true == m_Connections.contains(connection))) return;
+
+  beginInsertRows(QModelIndex(), m_Connections.size(), m_Connections.size());
+  m_Connections.append(connection);
+  endInsertRows();
+
+  const auto connectionRaw = connection.get();
+
+  connect(connectionRaw, &Connection::connectionChanged, this, [this, connectionRaw]()
+  {
+    const auto index = indexOf(connectionRaw);
+    if(true == index.isValid()) emit dataChanged(index, index, {Qt::DecorationRole});
+  });
+
+  connect(connectionRaw, &Connection::nameChanged, this, [this, connectionRaw]()
+  {
+    const auto index = indexOf(connectionRaw);
+    if(true == index.isValid()) emit dataChanged(index, index, {Qt::DisplayRole});
+  });
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ConnectionListModel::removeConnection(const ConnectionPtr &connection)
+{
+  const int row = m_Connections.indexOf(connection);
+  if(0 > row) return false;
+
+  disconnect(connection.get(), nullptr, this, nullptr);
+
+  beginRemoveRows(QModelIndex(), row, row);
+  m_Connections.removeAt(row);
+  endRemoveRows();
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ConnectionPtr ConnectionListModel::getConnection(const QModelIndex &index) const
+{
+  if((false == index.isValid()) || (index.row() >= m_Connections.size())) return {};
+
+  return m_Connections.at(index.row());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const QList<ConnectionPtr> &ConnectionListModel::getConnections() const
+{
+  return m_Connections;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QModelIndex ConnectionListModel::indexOf(const Connection* connection) const
+{
+  for(int row = 0; row < m_Connections.size(); ++row)
+  {
+    if(connection == m_Connections.at(row).get()) return index(row);
+  }
+
+  return {};
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QList>
+#include <QAbstractListModel>
+
+#include "Connection.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The ConnectionListModel class provides the configured connections as list rows
+ *
+ * Each row shows the name of a connection and its connection state as icon. Adding or removing a connection only
+ * inserts or removes its own row and a changed connection state only updates its own row, so the views and the pages
+ * of the other connections are left untouched.
+ */
+class ConnectionListModel : public QAbstractListModel
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief ConnectionListModel Constructor
+	 * @param parent
+	 */
+	explicit ConnectionListModel(QObject *parent = nullptr);
+
+	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+	/**
+	 * @brief addConnection Append a row for the connection
+	 * @param connection
+	 */
+	void addConnection(const ConnectionPtr &connection);
+
+	/**
+	 * @brief removeConnection Remove the row of the connection
+	 * @param connection
+	 * @return False if the connection has no row
+	 */
+	bool removeConnection(const ConnectionPtr &connection);
+
+	/**
+	 * @brief getConnection
+	 * @param index
+	 * @return The connection of the row, nullptr if the index is invalid
+	 */
+	ConnectionPtr getConnection(const QModelIndex &index) const;
+
+	/**
+	 * @brief getConnections
+	 * @return All connections in the order of their rows
+	 */
+	const QList<ConnectionPtr> &getConnections() const;
+
+	/**
+	 * @brief indexOf
+	 * @param connection
+	 * @return The index of the row of the connection, invalid if it has none
+	 */
+	QModelIndex indexOf(const Connection* connection) const;
+
+private:
+
+	/**
+	 * @brief m_Connections The connections in the order of their rows
+	 */
+	QList<ConnectionPtr> m_Connections;
+};
+
+}
@@ -9,6 +9,25 @@ QList<ConnectionPtr> ConnectionSerializer::DeserializeConnections(QSettings &m_S
 {
   QList<ConnectionPtr> connections;
 
+  for(const auto &connectionData : DeserializeConnectionData(m_Settings))
+  {
+    if(false == connectionData.isValid())
+    {
+      qDebug() << "ConnectionSerializer::DeserializeConnections() failed to load connection=" << connectionData.name;
+      continue;
+    }
+
+    connections.append(std::make_shared<Connection>(connectionData));
+  }
+
+  return connections;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<ConnectionData> ConnectionSerializer::DeserializeConnectionData(QSettings &m_Settings)
+{
+  QList<ConnectionData> connections;
+
   m_Settings.beginGroup("connections");
   const auto connectionNames = m_Settings.childGroups();
 
@@ -18,7 +37,7 @@ QList<ConnectionPtr> ConnectionSerializer::DeserializeConnections(QSettings &m_S
 
     m_Settings.beginGroup(connectionName);
 
-    qDebug() << "ConnectionSerializer::DeserializeConnections() loading connection=" << connectionName
+    qDebug() << "ConnectionSerializer::DeserializeConnectionData() loading connection=" << connectionName
              << "name:" << m_Settings.value("name").toString()
              << "port:" << m_Settings.value("port").toString()
              << "protocol:" << m_Settings.value("protocol").toString();
@@ -26,6 +45,7 @@ QList<ConnectionPtr> ConnectionSerializer::DeserializeConnections(QSettings &m_S
     const auto name = m_Settings.value("name").toString();
     const auto portName = m_Settings.value("port").toString();
     const auto protocol = ParseCommunicationProtocolFromString(m_Settings.value("protocol").toString());
+    const auto storage = ParseStorageBackendFromString(m_Settings.value("storage").toString());
 
     int size = m_Settings.beginReadArray("mappings");
     for (int i = 0; i < size; ++i)
@@ -36,8 +56,21 @@ QList<ConnectionPtr> ConnectionSerializer::DeserializeConnections(QSettings &m_S
         QString description = m_Settings.value("description").toString();
         QString unit = m_Settings.value("unit").toString();
         Duration interval = Duration::FromString(QString("%1s").arg(m_Settings.value("interval").toULongLong()));
-
-        mappings.append(ObisValueMapping{obisNumber, description, unit, interval});
+        CompressionMethod compression = ParseCompressionMethodFromString(m_Settings.value("compression").toString());
+        Duration maxGap = Duration::FromString(QString("%1s").arg(m_Settings.value("maxgap").toULongLong()));
+        Duration window = Duration::FromString(QString("%1s").arg(m_Settings.value("window").toULongLong()));
+        QString expression = m_Settings.value("expression").toString();
+
+        double deviation{};
+        bool relative{};
+        if(false == ObisValueMapping::ParseDeviation(m_Settings.value("deviation").toString(), deviation, relative))
+        {
+          deviation = 0.0;
+          relative = false;
+        }
+
+        mappings.append(ObisValueMapping{obisNumber, description, unit, interval,
+                                         compression, deviation, relative, maxGap, window, expression});
     }
     m_Settings.endArray();
 
@@ -45,15 +78,10 @@ QList<ConnectionPtr> ConnectionSerializer::DeserializeConnections(QSettings &m_S
                                                portName,
                                                GetSerialPortInfoByPortName(portName),
                                                protocol,
-                                               mappings);
+                                               mappings,
+                                               storage);
 
-    if(false == connectionData.isValid())
-    {
-      qDebug() << "ConnectionSerializer::DeserializeConnections() failed to load connection=" << connectionName;
-      continue;
-    }
-
-    connections.append(std::make_shared<Connection>(connectionData));
+    connections.append(connectionData);
 
     m_Settings.endGroup();
   }
@@ -89,6 +117,7 @@ bool ConnectionSerializer::save(QSettings &settings)
   settings.setValue(QString("name"), QVariant::fromValue(data.name));
   settings.setValue(QString("port"), QVariant::fromValue(data.info.portName()));
   settings.setValue(QString("protocol"), QVariant::fromValue(ParseStringFromCommunicationProtocol(data.protocol)));
+  settings.setValue(QString("storage"), QVariant::fromValue(ParseStringFromStorageBackend(data.storage)));
 
   settings.beginWriteArray("mappings");
   for (int i = 0; i < data.mappings.size(); ++i)
@@ -98,6 +127,11 @@ bool ConnectionSerializer::save(QSettings &settings)
     settings.setValue("description", data.mappings.at(i).description);
     settings.setValue("unit", data.mappings.at(i).unit);
     settings.setValue("interval", data.mappings.at(i).interval.toSeconds());
+    settings.setValue("compression", ParseStringFromCompressionMethod(data.mappings.at(i).compression));
+    settings.setValue("deviation", data.mappings.at(i).getDeviationString());
+    settings.setValue("maxgap", data.mappings.at(i).maxGap.toSeconds());
+    settings.setValue("window", data.mappings.at(i).window.toSeconds());
+    settings.setValue("expression", data.mappings.at(i).expression);
   }
   settings.endArray();
 
@@ -4,6 +4,8 @@
 
 #include <QSettings>
 
+#include "TypeDefinitions.h"
+
 namespace Ssmr
 {
 
@@ -24,6 +26,13 @@ public:
 	 */
 	static QList<ConnectionPtr> DeserializeConnections(QSettings &m_Settings);
 
+	/**
+	 * @brief DeserializeConnectionData Parse the data of all connections from the given settings instance
+	 * @param settings
+	 * @return The parsed connection data, including connections whose serial port is not available
+	 */
+	static QList<ConnectionData> DeserializeConnectionData(QSettings &m_Settings);
+
 	/**
 	 * @brief ConnectionSerializer
 	 * @param connection The connection to serialize
@@ -0,0 +1,152 @@
+#include "ConnectionStorage.h"
+
+#include <QTimer>
+#include <QThread>
+#include <QPointer>
+
+#include "EventLoopWatchdog.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  /*
+   * The last reference to a sink may be dropped by a loading thread, the sink is deleted in its own thread then
+   */
+  void DeleteSink(StorageSink* sink)
+  {
+    if(QThread::currentThread() == sink->thread())
+    {
+      delete sink;
+    }
+    else
+    {
+      sink->deleteLater();
+    }
+  }
+
+  //the storages whose sink is created in one of the next turns of the event loop
+  QList<QPointer<ConnectionStorage>> gPendingStorages;
+
+  /*
+   * Initialize the next pending storage, the remaining ones are initialized in the following turns
+   */
+  void InitializeNext()
+  {
+    while(false == gPendingStorages.isEmpty())
+    {
+      const auto storage = gPendingStorages.takeFirst();
+      if(nullptr == storage) continue;
+
+      storage->initialize();
+      break;
+    }
+
+    if(false == gPendingStorages.isEmpty()) QTimer::singleShot(0, &InitializeNext);
+  }
+}
+
+ConnectionStorage::ConnectionStorage(const ConnectionPtr &connection, QObject *parent)
+  : QObject(parent)
+  , m_Connection(connection)
+  , m_Sink(nullptr)
+  , m_SinkName()
+{
+  connect(m_Connection.get(), &Connection::dataValueAccepted, this, &ConnectionStorage::onDataValueAccepted);
+  connect(m_Connection.get(), &Connection::stepDetected, this, &ConnectionStorage::onStepDetected);
+
+  //the files are touched once the main window is shown, a single sink per turn keeps it responsive
+  gPendingStorages.append(this);
+  if(1 == gPendingStorages.size()) QTimer::singleShot(0, &InitializeNext);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ConnectionStorage::~ConnectionStorage()
+{
+  //pending values of the sink are written by its destructor once no reader uses it anymore
+  m_Sink.reset();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+StorageSinkPtr ConnectionStorage::getSink() const
+{
+  return m_Sink;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ConnectionStorage::initialize()
+{
+  if(nullptr == m_Sink) createSink();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ConnectionStorage::update()
+{
+  //the files and rows of a sink belong to the name it was created with
+  if((nullptr == m_Sink) ||
+     (m_Sink->getBackend() != m_Connection->getConnectionData().storage) ||
+     (m_SinkName != m_Connection->getName()))
+  {
+    createSink();
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ConnectionStorage::createSink()
+{
+  if(nullptr != m_Sink)
+  {
+    emit sinkAboutToChange();
+
+    //a reader may still load from the previous sink, it must not receive values anymore
+    disconnect(m_Connection.get(), nullptr, m_Sink.get(), nullptr);
+
+    //pending values of the previous sink are written by its destructor once no reader uses it anymore
+    m_Sink.reset();
+  }
+
+  m_SinkName = m_Connection->getName();
+  m_Sink = StorageSinkPtr(CreateStorageSink(m_Connection->getConnectionData()), &DeleteSink);
+  m_Sink->setRetention(m_Connection->getRollups().getConfiguration());
+
+  for(const auto &mapping : m_Connection->getConnectionData().mappings)
+  {
+    m_Sink->addMapping(mapping);
+  }
+
+  connect(m_Connection.get(), &Connection::mappingAdded, m_Sink.get(), &StorageSink::addMapping);
+  connect(m_Connection.get(), &Connection::mappingRemoved, m_Sink.get(), &StorageSink::removeMapping);
+
+  //adding a known mapping again only takes over its unit
+  connect(m_Connection.get(), &Connection::mappingChanged, m_Sink.get(), &StorageSink::addMapping);
+  connect(m_Connection.get(), &Connection::rollupBucketClosed, m_Sink.get(), &StorageSink::writeRollup);
+
+  emit sinkChanged(m_Sink);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ConnectionStorage::onDataValueAccepted(const QString &obisValue,
+                                            const qint64 &timestamp,
+                                            const QVariant &dataValue)
+{
+  const WatchdogScope scope("ConnectionStorage::onDataValueAccepted()");
+
+  const auto mapping = m_Connection->getConnectionData().getMappingByObisNumber(obisValue);
+  if(false == mapping.isValid()) return;
+
+  initialize();
+
+  m_Sink->write(mapping.obisNumber, timestamp, dataValue, mapping.unit);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ConnectionStorage::onStepDetected(const QString &obisNumber, const StepEvent &event)
+{
+  initialize();
+
+  m_Sink->writeEvent(obisNumber, event);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
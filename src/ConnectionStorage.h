@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QObject>
+#include <QVariant>
+
+#include "Connection.h"
+#include "StorageSink.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The ConnectionStorage class stores the accepted values of a single connection, independent of its page
+ *
+ * The storage sinks of all connections are created one per turn of the event loop after construction, so creating the
+ * log directory and checking the files of the mappings neither delays the start of the application nor freezes the
+ * window with many connections. Values accepted before that create the sink right away, none are lost.
+ */
+class ConnectionStorage : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief ConnectionStorage Constructor
+	 * @param connection
+	 * @param parent
+	 */
+	explicit ConnectionStorage(const ConnectionPtr &connection, QObject *parent = nullptr);
+
+	/**
+	 * @brief ~ConnectionStorage Destructor, pending values are written by the sink
+	 */
+	virtual ~ConnectionStorage() override;
+
+	/**
+	 * @brief getSink
+	 * @return The sink of the configured backend, nullptr until it is initialized
+	 */
+	StorageSinkPtr getSink() const;
+
+public slots:
+
+	/**
+	 * @brief initialize Create the sink if it does not exist yet
+	 */
+	void initialize();
+
+	/**
+	 * @brief update Create the sink again if the configured backend or the connection name changed, already stored
+	 * values are not migrated
+	 */
+	void update();
+
+signals:
+
+	/**
+	 * @brief sinkAboutToChange Emitted before the sink is replaced, it is deleted once the last reader dropped it
+	 */
+	void sinkAboutToChange();
+
+	/**
+	 * @brief sinkChanged Emitted when a sink was created
+	 * @param sink
+	 */
+	void sinkChanged(const StorageSinkPtr &sink);
+
+private slots:
+
+	/**
+	 * @brief onDataValueAccepted Write a value which passed interval and compression
+	 * @param obisValue
+	 * @param timestamp
+	 * @param dataValue
+	 */
+	void onDataValueAccepted(const QString &obisValue, const qint64 &timestamp, const QVariant &dataValue);
+
+	/**
+	 * @brief onStepDetected Write a detected step of a watched series
+	 * @param obisNumber
+	 * @param event
+	 */
+	void onStepDetected(const QString &obisNumber, const StepEvent &event);
+
+private:
+
+	/**
+	 * @brief createSink (Re)create the storage sink for the configured storage backend
+	 */
+	void createSink();
+
+	/**
+	 * @brief m_Connection The connection whose values are stored
+	 */
+	ConnectionPtr m_Connection;
+
+	/**
+	 * @brief m_Sink Stores the logged values in the configured storage backend
+	 */
+	StorageSinkPtr m_Sink;
+
+	/**
+	 * @brief m_SinkName The connection name the sink was created with
+	 */
+	QString m_SinkName;
+};
+
+}
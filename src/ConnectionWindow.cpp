@@ -1,18 +1,19 @@
 #include "ConnectionWindow.h"
 #include "ui_ConnectionWindow.h"
 
-#include <QDir>
 #include <QDebug>
-#include <QFile>
 #include <QTime>
-#include <QFileInfo>
+#include <QDateTime>
+#include <QListWidget>
+#include <QtMath>
 #include <QSerialPort>
 
-#include "qtcsv/stringdata.h"
-#include "qtcsv/writer.h"
-
 #include "Connection.h"
+#include "StorageSink.h"
 #include "ConnectionDialog.h"
+#include "ConnectionStorage.h"
+#include "TickScheduler.h"
+#include "EventLoopWatchdog.h"
 #include "ConnectionSerializer.h"
 #include "HelpFunctions.h"
 
@@ -22,13 +23,27 @@
 namespace Ssmr
 {
 
-ConnectionWindow::ConnectionWindow(ConnectionPtr connection, QWidget *parent)
+namespace
+{
+  //how many detected steps are listed, the oldest are removed first
+  const int cMaxStepItems = 100;
+
+  //the connection time is shown in seconds
+  const int cConnectionTimeInterval = 1000;
+}
+
+ConnectionWindow::ConnectionWindow(ConnectionPtr connection, ConnectionStorage* storage, QWidget *parent)
   : QWidget(parent)
   , ui(new Ui::ConnectionWindow)
   , m_Connection(connection)
   , m_Settings()
-  , m_CsvDir(qApp->applicationDirPath())
+  , m_Storage(storage)
   , m_LogWidget(new ObisValueLogWidget(m_Connection, this))
+  , m_DiagramWidget(new ObisValueDiagramWidget(m_Connection, this))
+  , m_StepList(new QListWidget(this))
+  , m_Visible(false)
+  , m_ConnectionTimeTick(-1)
+  , m_DemandChanged(false)
 {
   ui->setupUi(this);
   ui->lblConnectionName->setText(tr("Connection: %2").arg(m_Connection->getName()));
@@ -46,35 +61,25 @@ ConnectionWindow::ConnectionWindow(ConnectionPtr connection, QWidget *parent)
   }
 
   ui->tabWidget->addTab(m_LogWidget, QString("Log"));
-  //ui->tabWidget->addTab(new ObisValueDiagramWidget(), QString("Diagram"));
-
-  QStringList header;
-
-  header << QString("timestamp");
-  header << QString("value");
-  header << QString("unit");
+  ui->tabWidget->addTab(m_StepList, QString("Events"));
+  ui->tabWidget->addTab(m_DiagramWidget, QString("Diagram"));
 
-  m_CsvDir.cdUp();
-  m_CsvDir.mkdir(QString("log"));
-  m_CsvDir.cd(QString("log"));
+  //the history is loaded from the sink as soon as the storage created it
+  m_DiagramWidget->setSink(m_Storage->getSink(), m_Connection->getRollups().getConfiguration());
 
-  for(const auto &mapping : m_Connection->getConnectionData().getMappingObisNumbers())
+  connect(m_Storage, &ConnectionStorage::sinkAboutToChange, m_DiagramWidget, [this]()
   {
-    QtCSV::StringData data;
-    data.addRow(header);
-
-    QString filePath = m_CsvDir.absoluteFilePath(QString("%1_%2.csv").arg(m_Connection->getName()).arg(mapping));
-
-    QFileInfo fi(filePath);
-    if(false == fi.exists())
-    {
-      QtCSV::Writer::write(filePath, data);
-    }
-  }
+    m_DiagramWidget->setSink(nullptr);
+  });
+  connect(m_Storage, &ConnectionStorage::sinkChanged, m_DiagramWidget, [this](const StorageSinkPtr &sink)
+  {
+    m_DiagramWidget->setSink(sink, m_Connection->getRollups().getConfiguration());
+  });
 
+  //the page is created when it is first selected, the connection may already be established then
   for(int i = 0; i < ui->tabWidget->count(); ++i)
   {
-    ui->tabWidget->setTabVisible(i, false);
+    ui->tabWidget->setTabVisible(i, m_Connection->isConnected());
   }
 
   ui->lblWarningInvalidConnection->setVisible(!m_Connection->isValid());
@@ -86,9 +91,10 @@ ConnectionWindow::ConnectionWindow(ConnectionPtr connection, QWidget *parent)
   ui->btnConnect->setVisible((true == m_Connection->isValid()) && (false == m_Connection->isConnected()));
   ui->btnDisconnect->setVisible((true == m_Connection->isValid()) && (true == m_Connection->isConnected()));
 
-  connect(m_Connection.get(), &Connection::connectionTimeChanged, this, &ConnectionWindow::onConnectionTimeChanged);
   connect(m_Connection.get(), &Connection::connectionChanged, this, &ConnectionWindow::onConnectionChanged);
   connect(m_Connection.get(), &Connection::dataValueReceived, this, &ConnectionWindow::onDataValueReceived);
+  connect(m_Connection.get(), &Connection::demandChanged, this, &ConnectionWindow::onDemandChanged);
+  connect(m_Connection.get(), &Connection::stepDetected, this, &ConnectionWindow::onStepDetected);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -99,8 +105,45 @@ ConnectionWindow::~ConnectionWindow()
 }
 //----------------------------------------------------------------------------------------------------------------------
 
-void ConnectionWindow::onConnectionTimeChanged(qint64 elapsed) const
+void ConnectionWindow::showEvent(QShowEvent *event)
+{
+  QWidget::showEvent(event);
+
+  m_Visible = true;
+
+  //the connection keeps the latest state, it is shown once instead of every update missed while hidden
+  if(true == m_Connection->isConnected()) updateConnectionTime();
+
+  //a restore from the tray may show the window without hiding it before
+  TickScheduler::Instance()->unsubscribe(m_ConnectionTimeTick);
+  m_ConnectionTimeTick = TickScheduler::Instance()->subscribe(this, cConnectionTimeInterval, [this](const qint64 &)
+  {
+    updateConnectionTime();
+  });
+
+  if(true == m_DemandChanged)
+  {
+    onDemandChanged(m_Connection->getDemand().getProjectedDemand(), m_Connection->getDemand().getPeakDemand());
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ConnectionWindow::hideEvent(QHideEvent *event)
+{
+  QWidget::hideEvent(event);
+
+  m_Visible = false;
+
+  TickScheduler::Instance()->unsubscribe(m_ConnectionTimeTick);
+  m_ConnectionTimeTick = -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ConnectionWindow::updateConnectionTime() const
 {
+  if((false == m_Visible) || (false == m_Connection->isConnected())) return;
+
+  const qint64 elapsed = m_Connection->getConnectionTime();
   ui->lblStatus->setText(tr("Connected since %1").arg(QTime(0,0).addMSecs(elapsed).toString("hh:mm:ss")));
 }
 //----------------------------------------------------------------------------------------------------------------------
@@ -137,6 +180,9 @@ void ConnectionWindow::on_btnSettings_clicked()
   if(QDialog::Accepted == reason)
   {
     m_Connection->setConnectionData(c->getConnectionData());
+
+    //values received from now on go to the new backend or name, already stored values are not migrated
+    m_Storage->update();
   }
 
   ConnectionSerializer s(m_Connection);
@@ -164,6 +210,8 @@ void ConnectionWindow::onConnectionChanged(bool connected) const
 
 void ConnectionWindow::onDataValueReceived(const QString &obisValue, const qint64 &timestamp, const QVariant &dataValue)
 {
+  const WatchdogScope scope("ConnectionWindow::onDataValueReceived()");
+
   const auto mappings = m_Connection->getConnectionData().mappings;
 
   for(const auto &mapping : mappings)
@@ -172,20 +220,67 @@ void ConnectionWindow::onDataValueReceived(const QString &obisValue, const qint6
 
     if(nullptr != m_LogWidget)
     {
-      const auto logged = m_LogWidget->onDataValueReceived(mapping.obisNumber, timestamp, dataValue, mapping.unit);
+      m_LogWidget->onDataValueReceived(mapping.obisNumber, timestamp, dataValue, mapping.unit);
+    }
 
-      if(true == logged)
-      {
+    if(nullptr != m_DiagramWidget)
+    {
+      m_DiagramWidget->onDataValueReceived(mapping.obisNumber, timestamp, dataValue);
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
 
-        QtCSV::StringData data;
-        data.addRow(QStringList() << QString::number(timestamp) << dataValue.toString() << mapping.unit);
+void ConnectionWindow::onDemandChanged(double projected, double peak)
+{
+  m_DemandChanged = (false == m_Visible);
+  if(true == m_DemandChanged) return;
 
-        QString filePath = m_CsvDir.absoluteFilePath(QString("%1_%2.csv").arg(m_Connection->getName())
-                                                                         .arg(mapping.obisNumber));
-        QtCSV::Writer::write(filePath, data, QString(","), QString("\""), QtCSV::Writer::WriteMode::APPEND);
-      }
-    }
+  const auto &obisNumber = m_Connection->getDemand().getConfiguration().obisNumber;
+  const auto mapping = m_Connection->getConnectionData().getMappingByObisNumber(obisNumber);
+  const QString unit = (true == mapping.isValid()) ? mapping.unit : QString("W");
+
+  if(true == qIsNaN(peak))
+  {
+    ui->lblDemand->setText(tr("Demand %1 %2").arg(QString::number(projected, 'f', 0)).arg(unit));
+  }
+  else
+  {
+    ui->lblDemand->setText(tr("Demand %1 %2 (peak %3 %2)").arg(QString::number(projected, 'f', 0))
+                                                           .arg(unit)
+                                                           .arg(QString::number(peak, 'f', 0)));
   }
+
+  //the running interval is about to set a new billed peak
+  const bool exceeding = (false == qIsNaN(peak)) && (projected > peak);
+  ui->lblDemand->setStyleSheet((true == exceeding) ? QString("color: rgb(204, 0, 0);") : QString());
+  ui->lblDemand->setToolTip(tr("Projected average power of the running %1 minute demand interval")
+                            .arg(m_Connection->getDemand().getConfiguration().interval.toSeconds() / 60));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ConnectionWindow::onStepDetected(const QString &obisNumber, const StepEvent &event) const
+{
+  const auto mapping = m_Connection->getConnectionData().getMappingByObisNumber(obisNumber);
+  const QString unit = (true == mapping.isValid()) ? mapping.unit : QString("W");
+  const QString time = QDateTime::fromMSecsSinceEpoch(event.timestamp).toString("hh:mm:ss");
+
+  QString text = tr("%1 %2 %3 %4 %5 (%6 -> %7 %5)").arg(time)
+                                                   .arg(obisNumber)
+                                                   .arg((true == event.on) ? tr("on") : tr("off"))
+                                                   .arg(QString::number(event.magnitude, 'f', 0))
+                                                   .arg(unit)
+                                                   .arg(QString::number(event.before, 'f', 0))
+                                                   .arg(QString::number(event.after, 'f', 0));
+
+  if(0 <= event.duration)
+  {
+    text += tr(" after %1").arg(QTime(0,0).addMSecs(static_cast<int>(event.duration)).toString("hh:mm:ss"));
+  }
+
+  m_StepList->insertItem(0, text);
+
+  while(m_StepList->count() > cMaxStepItems) delete m_StepList->takeItem(m_StepList->count() - 1);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -5,6 +5,8 @@
 #include <QUrl>
 #include <QDir>
 
+class QListWidget;
+
 namespace Ssmr
 {
 
@@ -13,7 +15,10 @@ namespace Ui
 class ConnectionWindow;
 }
 
+struct StepEvent;
+class ConnectionStorage;
 class ObisValueLogWidget;
+class ObisValueDiagramWidget;
 
 class Connection;
 typedef std::shared_ptr<Connection> ConnectionPtr;
@@ -31,15 +36,30 @@ public:
 	/**
 	 * @brief ConnectionWindow Constructor
 	 * @param connection
+	 * @param storage Where the values of the connection are stored, it has to outlive the window
 	 * @param parent
 	 */
-	explicit ConnectionWindow(ConnectionPtr connection, QWidget *parent = nullptr);
+	explicit ConnectionWindow(ConnectionPtr connection, ConnectionStorage* storage, QWidget *parent = nullptr);
 
 	/**
 	 * @brief ~ConnectionWindow Destructor
 	 */
 	virtual ~ConnectionWindow() override;
 
+protected:
+
+	/**
+	 * @brief showEvent Resume the updates and show the latest state once
+	 * @param event
+	 */
+	virtual void showEvent(QShowEvent *event) override;
+
+	/**
+	 * @brief hideEvent Suspend the updates while the page or the main window is hidden
+	 * @param event
+	 */
+	virtual void hideEvent(QHideEvent *event) override;
+
 private slots:
 
 	/**
@@ -58,9 +78,9 @@ private slots:
 	void onConnectionChanged(bool connected) const;
 
 	/**
-	 * @brief onConnectionUpdate Periodic connection updates
+	 * @brief updateConnectionTime Show how long the connection is open
 	 */
-	void onConnectionTimeChanged(qint64 elapsed) const;
+	void updateConnectionTime() const;
 
 	/**
 	 * @brief onDataValueReceived Called when a new value for a given obis number is received
@@ -70,6 +90,20 @@ private slots:
 	 */
 	void onDataValueReceived(const QString &obisValue, const qint64 &timestamp, const QVariant &dataValue);
 
+	/**
+	 * @brief onStepDetected List a detected step, the newest first
+	 * @param obisNumber
+	 * @param event
+	 */
+	void onStepDetected(const QString &obisNumber, const StepEvent &event) const;
+
+	/**
+	 * @brief onDemandChanged Show the projected demand, highlighted if it exceeds the peak of the billing period
+	 * @param projected
+	 * @param peak
+	 */
+	void onDemandChanged(double projected, double peak);
+
 	/**
 	 * @brief on_btnSettings_clicked Open dialog to change connection settings
 	 */
@@ -90,14 +124,39 @@ private:
 	QSettings m_Settings;
 
 	/**
-	 * @brief m_CsvDir Where to save the csv files
+	 * @brief m_Storage Stores the logged values in the configured storage backend
 	 */
-	QDir m_CsvDir;
+	ConnectionStorage* m_Storage;
 
 	/**
 	 * @brief m_LogWidget Where to put log messages
 	 */
 	ObisValueLogWidget* m_LogWidget;
+
+	/**
+	 * @brief m_DiagramWidget Where to chart the received values
+	 */
+	ObisValueDiagramWidget* m_DiagramWidget;
+
+	/**
+	 * @brief m_StepList Lists the detected steps
+	 */
+	QListWidget* m_StepList;
+
+	/**
+	 * @brief m_Visible False while this page or the main window is hidden, nothing is formatted then
+	 */
+	bool m_Visible;
+
+	/**
+	 * @brief m_ConnectionTimeTick The tick subscription updating the connection time while visible, -1 while hidden
+	 */
+	int m_ConnectionTimeTick;
+
+	/**
+	 * @brief m_DemandChanged True if the demand changed while hidden
+	 */
+	bool m_DemandChanged;
 };
 
 }
@@ -0,0 +1,481 @@
+#include "CsvSeekIndex.h"
+
+#include <QFile>
+#include <QDebug>
+#include <QtMath>
+#include <QSaveFile>
+
+#include <limits>
+#include <iterator>
+#include <algorithm>
+
+namespace Ssmr
+{
+
+namespace
+{
+  //indexes without zone maps have a different header and are rebuilt in the background
+  const QByteArray cIndexHeader = QByteArray("#ssmr-csv-index-v2");
+
+  /*
+   * Return a single csv field without surrounding whitespace and text delimiters
+   */
+  QByteArray Unquote(const QByteArray &field)
+  {
+    QByteArray result = field.trimmed();
+
+    if((2 <= result.size()) && (true == result.startsWith('"')) && (true == result.endsWith('"')))
+    {
+      result = result.mid(1, result.size() - 2);
+    }
+
+    return result;
+  }
+
+  /*
+   * Serialize a single index entry including its zone map
+   */
+  QByteArray EntryToLine(const CsvSeekIndex::Entry &entry)
+  {
+    const bool empty = (0 == entry.count);
+
+    return QByteArray::number(entry.timestamp) + ',' +
+           QByteArray::number(entry.offset) + ',' +
+           QByteArray::number(entry.lastTimestamp) + ',' +
+           QByteArray::number(entry.count) + ',' +
+           QByteArray::number((true == empty) ? 0.0 : entry.min, 'g', 17) + ',' +
+           QByteArray::number((true == empty) ? 0.0 : entry.max, 'g', 17) + '\n';
+  }
+}
+
+bool CsvSeekIndex::Entry::mayContain(const ValueRange &range) const
+{
+  return (0 < count) && (true == range.overlaps(min, max));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const int CsvSeekIndex::cDefaultRowsPerEntry = 256;
+
+QString CsvSeekIndex::IndexPathForCsv(const QString &csvPath)
+{
+  return QString("%1.idx").arg(csvPath);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double CsvSeekIndex::ParseValue(const QByteArray &row)
+{
+  qint64 timestamp{};
+  double value{};
+
+  return (true == ParseRow(row, timestamp, &value)) ? value : qQNaN();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSeekIndex::ParseRow(const QByteArray &row, qint64 &timestamp, double *value)
+{
+  const int timestampEnd = row.indexOf(',');
+  if(0 > timestampEnd) return false;
+
+  bool ok{};
+  timestamp = Unquote(row.left(timestampEnd)).toLongLong(&ok);
+  if(false == ok) return false;
+
+  if(nullptr != value)
+  {
+    const int valueEnd = row.indexOf(',', timestampEnd + 1);
+    const auto field = (0 > valueEnd) ? row.mid(timestampEnd + 1)
+                                      : row.mid(timestampEnd + 1, valueEnd - timestampEnd - 1);
+
+    *value = Unquote(field).toDouble(&ok);
+  }
+
+  return ok;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSeekIndex::Build(const QString &csvPath, int rowsPerEntry)
+{
+  QFile file(csvPath);
+  if(false == file.open(QIODevice::ReadOnly))
+  {
+    qDebug() << "CsvSeekIndex::Build() failed to open" << csvPath;
+    return false;
+  }
+
+  CsvSeekIndex index(csvPath, rowsPerEntry);
+
+  while(false == file.atEnd())
+  {
+    const qint64 offset = file.pos();
+    const QByteArray row = file.readLine();
+
+    //a partially written last row is indexed once it is complete
+    if(false == row.endsWith('\n')) break;
+
+    qint64 timestamp{};
+    if(false == ParseRow(row, timestamp)) continue;
+
+    index.addRow(timestamp, ParseValue(row), offset);
+  }
+
+  //the last block may still grow, it is written once the next block starts
+  return index.save(index.getSealedCount());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ObisSampleList CsvSeekIndex::ReadRange(const QString &csvPath, const qint64 &from, const qint64 &to)
+{
+  ObisSampleList samples;
+
+  Scan(csvPath, from, to, [&samples](const qint64 &, const QByteArray &row)
+  {
+    qint64 timestamp{};
+    double value{};
+    if(true == ParseRow(row, timestamp, &value)) samples.append(qMakePair(timestamp, value));
+  });
+
+  return samples;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 CsvSeekIndex::FirstTimestamp(const QString &csvPath)
+{
+  QFile file(csvPath);
+  if(false == file.open(QIODevice::ReadOnly)) return -1;
+
+  while(false == file.atEnd())
+  {
+    qint64 timestamp{};
+    if(true == ParseRow(file.readLine(), timestamp)) return timestamp;
+  }
+
+  return -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSeekIndex::Scan(const QString &csvPath,
+                        const qint64 &from,
+                        const qint64 &to,
+                        const std::function<void(const qint64 &, const QByteArray &)> &visitor)
+{
+  QFile file(csvPath);
+  if(false == file.open(QIODevice::ReadOnly)) return false;
+
+  CsvSeekIndex index(csvPath);
+  const qint64 offset = (true == index.load()) ? index.seekOffset(from) : 0;
+
+  if((offset >= file.size()) || (false == file.seek(offset)))
+  {
+    qDebug() << "CsvSeekIndex::Scan() stale index for" << csvPath << ", reading from the top";
+    file.seek(0);
+  }
+
+  while(false == file.atEnd())
+  {
+    const QByteArray row = file.readLine();
+
+    qint64 timestamp{};
+    if(false == ParseRow(row, timestamp)) continue;
+
+    if(timestamp < from) continue;
+    if(timestamp > to) break;
+
+    visitor(timestamp, row);
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSeekIndex::ExpireRows(const QString &csvPath, const qint64 &cutoff, QReadWriteLock *swapLock)
+{
+  CsvSeekIndex index(csvPath);
+  if((false == index.load()) && ((false == Build(csvPath)) || (false == index.load()))) return false;
+
+  QFile file(csvPath);
+  if(false == file.open(QIODevice::ReadOnly)) return false;
+
+  const qint64 offset = index.seekOffset(cutoff);
+
+  //keep the header row, files without a header start directly with the data rows
+  QByteArray header = file.readLine();
+  qint64 timestamp{};
+  if(true == ParseRow(header, timestamp)) header.clear();
+
+  //rewriting the file for a few expired rows is not worth it
+  if((offset <= header.size()) || (offset < file.size() / 8)) return true;
+
+  QSaveFile output(csvPath);
+  if(false == output.open(QIODevice::WriteOnly)) return false;
+
+  output.write(header);
+
+  file.seek(offset);
+  while(false == file.atEnd())
+  {
+    output.write(file.read(1024 * 1024));
+  }
+
+  file.close();
+
+  //the readers only wait while the file and its index are swapped, not while the rows are copied
+  const QWriteLocker locker(swapLock);
+
+  if(false == output.commit()) return false;
+
+  QVector<Entry> entries;
+  for(const auto &entry : index.m_Entries)
+  {
+    if(entry.offset < offset) continue;
+
+    entries.append(entry);
+    entries.last().offset = entry.offset - offset + header.size();
+  }
+  index.m_Entries = entries;
+
+  qDebug() << "CsvSeekIndex::ExpireRows() removed" << offset - header.size() << "bytes from" << csvPath;
+
+  return index.save(index.m_Entries.size());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+CsvSeekIndex::CsvSeekIndex(const QString &csvPath, int rowsPerEntry)
+  : m_CsvPath(csvPath)
+  , m_RowsPerEntry(qMax(1, rowsPerEntry))
+  , m_RowsSinceEntry(0)
+  , m_Open(false)
+  , m_LastSealed(true)
+  , m_Entries()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSeekIndex::load()
+{
+  m_Entries.clear();
+  m_RowsSinceEntry = 0;
+  m_Open = false;
+  m_LastSealed = true;
+
+  QFile file(IndexPathForCsv(m_CsvPath));
+  if(false == file.open(QIODevice::ReadOnly)) return false;
+
+  const QByteArray header = file.readLine().trimmed();
+  if(header != (cIndexHeader + ',' + QByteArray::number(m_RowsPerEntry))) return false;
+
+  while(false == file.atEnd())
+  {
+    const QList<QByteArray> fields = file.readLine().trimmed().split(',');
+    if(6 != fields.size()) continue;
+
+    Entry entry;
+    entry.timestamp = fields.at(0).toLongLong();
+    entry.offset = fields.at(1).toLongLong();
+    entry.lastTimestamp = fields.at(2).toLongLong();
+    entry.count = fields.at(3).toULongLong();
+    entry.min = (0 < entry.count) ? fields.at(4).toDouble() : std::numeric_limits<double>::infinity();
+    entry.max = (0 < entry.count) ? fields.at(5).toDouble() : -std::numeric_limits<double>::infinity();
+
+    m_Entries.append(entry);
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSeekIndex::open()
+{
+  if(false == load()) return false;
+
+  QFile file(m_CsvPath);
+  if(false == file.open(QIODevice::ReadOnly)) return false;
+
+  //an entry behind the end of the file means the csv file was replaced
+  const qint64 start = m_Entries.isEmpty() ? 0 : m_Entries.last().offset;
+  if((0 < start) && (start >= file.size())) return false;
+
+  //the last sealed block is accounted again while catching up, the index file only contains sealed blocks
+  const int entries = m_Entries.size();
+  if(false == m_Entries.isEmpty()) m_Entries.removeLast();
+
+  file.seek(start);
+  while(false == file.atEnd())
+  {
+    const qint64 offset = file.pos();
+    const QByteArray row = file.readLine();
+
+    if(false == row.endsWith('\n')) break;
+
+    qint64 timestamp{};
+    if(false == ParseRow(row, timestamp)) continue;
+
+    addRow(timestamp, ParseValue(row), offset);
+  }
+
+  if((entries != getSealedCount()) && (false == save(getSealedCount()))) return false;
+
+  m_Open = true;
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSeekIndex::isOpen() const
+{
+  return m_Open;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSeekIndex::needsOffset() const
+{
+  return (true == m_Open) && ((true == m_Entries.isEmpty()) || (m_RowsSinceEntry >= m_RowsPerEntry));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CsvSeekIndex::onRowWritten(const qint64 &timestamp, const double &value, const qint64 &offset)
+{
+  if(false == m_Open) return;
+
+  if((true == needsOffset()) && (0 > offset))
+  {
+    qDebug() << "CsvSeekIndex::onRowWritten() missing offset, closing index for" << m_CsvPath;
+    m_Open = false;
+    return;
+  }
+
+  if(false == addRow(timestamp, value, offset)) return;
+
+  //the new entry seals the block before it, the very first entry has no predecessor
+  if(2 > m_Entries.size()) return;
+
+  QFile file(IndexPathForCsv(m_CsvPath));
+  if(false == file.open(QIODevice::WriteOnly | QIODevice::Append))
+  {
+    m_Open = false;
+    return;
+  }
+
+  file.write(EntryToLine(m_Entries.at(m_Entries.size() - 2)));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 CsvSeekIndex::seekOffset(const qint64 &timestamp) const
+{
+  //the first entry with a timestamp not before the requested one, all rows before its predecessor are too old
+  const auto it = std::lower_bound(m_Entries.cbegin(), m_Entries.cend(), timestamp,
+                                   [](const Entry &entry, const qint64 &t) { return entry.timestamp < t; });
+
+  if(it == m_Entries.cbegin()) return 0;
+
+  return std::prev(it)->offset;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const QVector<CsvSeekIndex::Entry> &CsvSeekIndex::getEntries() const
+{
+  return m_Entries;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<QPair<qint64, qint64>> CsvSeekIndex::getCandidateRanges(const qint64 &from,
+                                                              const qint64 &to,
+                                                              const ValueRange &range) const
+{
+  QList<QPair<qint64, qint64>> ranges;
+  if(from > to) return ranges;
+
+  const int sealed = getSealedCount();
+  const auto append = [&ranges, &from, &to](const qint64 &start, const qint64 &end)
+  {
+    const qint64 first = qMax(from, start);
+    const qint64 last = qMin(to, end);
+    if(first > last) return;
+
+    //adjacent candidate blocks are read in one go
+    if((false == ranges.isEmpty()) && (ranges.last().second + 1 >= first))
+    {
+      ranges.last().second = qMax(ranges.last().second, last);
+      return;
+    }
+
+    ranges.append(qMakePair(first, last));
+  };
+
+  for(int i = 0; i < sealed; ++i)
+  {
+    const auto &entry = m_Entries.at(i);
+    if(entry.timestamp > to) return ranges;
+
+    //the gap up to the next block contains no rows, including it keeps neighbouring candidates together
+    const qint64 end = (i + 1 < m_Entries.size()) ? qMax(entry.lastTimestamp, m_Entries.at(i + 1).timestamp - 1)
+                                                  : entry.lastTimestamp;
+
+    if(true == entry.mayContain(range)) append(entry.timestamp, end);
+  }
+
+  //nothing is known about the rows after the last sealed block, they may share its last timestamp
+  const qint64 unsealedFrom = (0 < sealed) ? m_Entries.at(sealed - 1).lastTimestamp
+                                           : std::numeric_limits<qint64>::min();
+  append(unsealedFrom, to);
+
+  return ranges;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSeekIndex::addRow(const qint64 &timestamp, const double &value, const qint64 &offset)
+{
+  const bool newEntry = (true == m_Entries.isEmpty()) || (m_RowsSinceEntry >= m_RowsPerEntry);
+
+  if(true == newEntry)
+  {
+    Entry entry;
+    entry.timestamp = timestamp;
+    entry.offset = offset;
+    entry.lastTimestamp = timestamp;
+    entry.count = 0;
+    entry.min = std::numeric_limits<double>::infinity();
+    entry.max = -std::numeric_limits<double>::infinity();
+
+    m_Entries.append(entry);
+    m_RowsSinceEntry = 0;
+  }
+
+  ++m_RowsSinceEntry;
+  m_LastSealed = false;
+
+  auto &entry = m_Entries.last();
+  entry.lastTimestamp = timestamp;
+
+  if(false == qIsNaN(value))
+  {
+    ++entry.count;
+    entry.min = qMin(entry.min, value);
+    entry.max = qMax(entry.max, value);
+  }
+
+  return newEntry;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int CsvSeekIndex::getSealedCount() const
+{
+  return qMax(0, m_Entries.size() - ((true == m_LastSealed) ? 0 : 1));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSeekIndex::save(int count) const
+{
+  QSaveFile file(IndexPathForCsv(m_CsvPath));
+  if(false == file.open(QIODevice::WriteOnly)) return false;
+
+  file.write(cIndexHeader + ',' + QByteArray::number(m_RowsPerEntry) + '\n');
+
+  for(int i = 0; i < qMin(count, m_Entries.size()); ++i)
+  {
+    file.write(EntryToLine(m_Entries.at(i)));
+  }
+
+  return file.commit();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <functional>
+
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QReadWriteLock>
+
+#include "TypeDefinitions.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The CsvSeekIndex class is a sparse sidecar index for a single csv log file
+ *
+ * Every n-th data row the timestamp and the byte offset of that row are stored in a "<file>.idx" file next to the
+ * csv log. The rows of a log are appended in time order, so a time range read can seek to the last indexed row before
+ * the range start and only scan a short piece of the file. Apart from expiring old rows the csv files are never
+ * modified.
+ *
+ * The rows from one entry up to the next form a block. Once the next entry is started the block is sealed and its zone
+ * map (time range, number, minimum and maximum of the numeric values) is appended to the index file, so readers can
+ * skip blocks which cannot contain the values they look for without opening the csv file. The still open last block
+ * is only kept in memory by the writer.
+ */
+class CsvSeekIndex
+{
+public:
+
+	/**
+	 * @brief The Entry struct A single index point
+	 */
+	struct Entry
+	{
+		/**
+		 * @brief mayContain
+		 * @param range
+		 * @return False if no numeric value of this block is within the given range
+		 */
+		bool mayContain(const ValueRange &range) const;
+
+		//!Timestamp and byte offset of the first row of the block
+		qint64 timestamp;
+		qint64 offset;
+
+		//!Zone map of the block, the first value column of all rows
+		qint64 lastTimestamp;
+		quint64 count;
+		double min;
+		double max;
+	};
+
+	/**
+	 * @brief cDefaultRowsPerEntry How many data rows are between two index entries
+	 */
+	static const int cDefaultRowsPerEntry;
+
+	/**
+	 * @brief IndexPathForCsv
+	 * @param csvPath
+	 * @return The path of the sidecar index belonging to the given csv file
+	 */
+	static QString IndexPathForCsv(const QString &csvPath);
+
+	/**
+	 * @brief ParseValue
+	 * @param row The raw row including the line ending
+	 * @return The numeric value of the given row, NaN if it has none
+	 */
+	static double ParseValue(const QByteArray &row);
+
+	/**
+	 * @brief ParseRow Parse a single csv row as written by the csv sink
+	 * @param row The raw row including the line ending
+	 * @param timestamp Set to the timestamp of the row
+	 * @param value Optional pointer to store the numeric value of the row
+	 * @return False for the header row and for rows which cannot be parsed
+	 */
+	static bool ParseRow(const QByteArray &row, qint64 &timestamp, double* value = nullptr);
+
+	/**
+	 * @brief Build Scan the whole csv file and (re)write its index
+	 * @param csvPath
+	 * @param rowsPerEntry
+	 * @return True if the index was written
+	 *
+	 * This is meant to be run on a background thread for already existing logs
+	 */
+	static bool Build(const QString &csvPath, int rowsPerEntry = cDefaultRowsPerEntry);
+
+	/**
+	 * @brief ReadRange Read all numeric samples within [from, to] from the given csv file
+	 * @param csvPath
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @return The samples in time order
+	 *
+	 * If an index is available the read seeks directly to the last index entry before the range start, otherwise the
+	 * file is read from the top.
+	 */
+	static ObisSampleList ReadRange(const QString &csvPath, const qint64 &from, const qint64 &to);
+
+	/**
+	 * @brief FirstTimestamp
+	 * @param csvPath
+	 * @return The timestamp of the first row after the header, -1 if the file has no rows or cannot be opened
+	 */
+	static qint64 FirstTimestamp(const QString &csvPath);
+
+	/**
+	 * @brief Scan Call the given visitor for all rows within [from, to] of the given csv file
+	 * @param csvPath
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @param visitor Called with the timestamp and the raw row, in file order
+	 * @return False if the file could not be opened
+	 *
+	 * Seeks like ReadRange, this is meant for files with other columns than the raw values, e.g. rollups.
+	 */
+	static bool Scan(const QString &csvPath,
+									 const qint64 &from,
+									 const qint64 &to,
+									 const std::function<void(const qint64 &timestamp, const QByteArray &row)> &visitor);
+
+	/**
+	 * @brief ExpireRows Remove the rows older than the given time from the head of the csv file
+	 * @param csvPath
+	 * @param cutoff Time in milliseconds since epoch
+	 * @param swapLock Locked for writing only while the file and its index are replaced, nullptr if not required
+	 * @return False if the file or its index could not be rewritten
+	 *
+	 * The file is only cut at index entries and only if a noticeable part of the file expired, so the rewrite cost is
+	 * amortized over many rows. The index is moved along with the rows, the header row is kept. The remaining rows are
+	 * copied while readers may still read the previous file, nothing may be appended meanwhile.
+	 */
+	static bool ExpireRows(const QString &csvPath, const qint64 &cutoff, QReadWriteLock* swapLock = nullptr);
+
+	/**
+	 * @brief CsvSeekIndex Constructor
+	 * @param csvPath The csv file this index belongs to
+	 * @param rowsPerEntry
+	 */
+	explicit CsvSeekIndex(const QString &csvPath = {}, int rowsPerEntry = cDefaultRowsPerEntry);
+
+	/**
+	 * @brief load Read the index file without touching the csv file
+	 * @return False if the index is missing or was created with a different row count
+	 */
+	bool load();
+
+	/**
+	 * @brief open Load the index and index all rows appended to the csv file since the last index entry
+	 * @return False if the index is missing or stale and needs to be built first
+	 */
+	bool open();
+
+	/**
+	 * @brief isOpen
+	 * @return True if the index is opened and can be updated through onRowWritten
+	 */
+	bool isOpen() const;
+
+	/**
+	 * @brief needsOffset
+	 * @return True if the next written row will become an index entry and therefore needs its byte offset
+	 */
+	bool needsOffset() const;
+
+	/**
+	 * @brief onRowWritten Update the index after a new row was appended to the csv file
+	 * @param timestamp The timestamp of the written row
+	 * @param value The numeric value of the written row, NaN if it has none
+	 * @param offset The byte offset the row was written to, only required if needsOffset() returned true
+	 */
+	void onRowWritten(const qint64 &timestamp, const double &value, const qint64 &offset = -1);
+
+	/**
+	 * @brief seekOffset
+	 * @param timestamp
+	 * @return The byte offset to start reading at to get all rows with a timestamp of at least the given one
+	 */
+	qint64 seekOffset(const qint64 &timestamp) const;
+
+	/**
+	 * @brief getEntries
+	 * @return All index entries
+	 */
+	const QVector<Entry> &getEntries() const;
+
+	/**
+	 * @brief getCandidateRanges Use the zone maps of a loaded index to find the parts of [from, to] which may contain
+	 * values within the given range
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @param range
+	 * @return Disjoint time ranges in time order with inclusive bounds, the rows after the last sealed block are always
+	 * a candidate
+	 */
+	QList<QPair<qint64, qint64>> getCandidateRanges(const qint64 &from, const qint64 &to, const ValueRange &range) const;
+
+private:
+
+	/**
+	 * @brief addRow Account for a single data row
+	 * @param timestamp
+	 * @param value
+	 * @param offset
+	 * @return True if the row became a new index entry
+	 */
+	bool addRow(const qint64 &timestamp, const double &value, const qint64 &offset);
+
+	/**
+	 * @brief getSealedCount
+	 * @return The number of entries whose block is complete. All entries of a loaded index are sealed, after adding rows
+	 * the last block is still open.
+	 */
+	int getSealedCount() const;
+
+	/**
+	 * @brief save Rewrite the whole index file
+	 * @param count The number of entries to write
+	 * @return
+	 */
+	bool save(int count) const;
+
+	/**
+	 * @brief m_CsvPath The indexed csv file
+	 */
+	QString m_CsvPath;
+
+	/**
+	 * @brief m_RowsPerEntry How many rows are between two index entries
+	 */
+	int m_RowsPerEntry;
+
+	/**
+	 * @brief m_RowsSinceEntry Number of rows written since the last entry, including the entry row
+	 */
+	int m_RowsSinceEntry;
+
+	/**
+	 * @brief m_Open True if the index follows the csv file
+	 */
+	bool m_Open;
+
+	/**
+	 * @brief m_LastSealed False if rows were added to the last block since the index was loaded
+	 */
+	bool m_LastSealed;
+
+	/**
+	 * @brief m_Entries The loaded entries
+	 */
+	QVector<Entry> m_Entries;
+};
+
+}
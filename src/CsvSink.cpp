@@ -0,0 +1,472 @@
+#include "CsvSink.h"
+
+#include <QDebug>
+#include <QtMath>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QtConcurrent>
+
+#include "qtcsv/stringdata.h"
+#include "qtcsv/writer.h"
+
+#include "EventLoopWatchdog.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  //expired rows are removed once per hour, the files are only rewritten if a noticeable part of them expired
+  const int cRetentionIntervalMs = 60 * 60 * 1000;
+}
+
+CsvSink::CsvSink(const QString &connectionName, const QDir &directory, QObject *parent)
+  : StorageSink(parent)
+  , m_ConnectionName(connectionName)
+  , m_Directory(directory)
+  , m_ObisNumbers()
+  , m_Retention()
+  , m_RetentionTimer(new QTimer(this))
+  , m_Indexes()
+  , m_PendingBuilds()
+  , m_FileLock()
+  , m_Expiry()
+  , m_Expiring()
+  , m_PendingRows()
+  , m_ExpiryWatcher(new QFutureWatcher<bool>(this))
+{
+  connect(m_RetentionTimer, &QTimer::timeout, this, &CsvSink::applyRetention);
+  connect(m_ExpiryWatcher, &QFutureWatcher<bool>::finished, this, &CsvSink::onExpired);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+CsvSink::~CsvSink()
+{
+  if(true == m_Expiring.isEmpty()) return;
+
+  //the rows written meanwhile would be lost otherwise, they are appended without starting any further work
+  m_ExpiryWatcher->waitForFinished();
+
+  const QString filePath = m_Expiring;
+  m_Expiring.clear();
+
+  //the rows moved, the index catches up with the appended rows when the file is opened next time
+  m_Indexes.remove(filePath);
+
+  for(const auto &pending : m_PendingRows)
+  {
+    append(filePath, pending.timestamp, pending.value, pending.row);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+StorageBackend CsvSink::getBackend() const
+{
+  return StorageBackend::eCsv;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString CsvSink::getFilePath(const QString &obisNumber) const
+{
+  return m_Directory.absoluteFilePath(QString("%1_%2.csv").arg(m_ConnectionName).arg(obisNumber));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString CsvSink::getRollupFilePath(const QString &obisNumber, const QString &tierName) const
+{
+  return m_Directory.absoluteFilePath(QString("%1_%2_%3.csv").arg(m_ConnectionName).arg(obisNumber).arg(tierName));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString CsvSink::getEventFilePath() const
+{
+  return m_Directory.absoluteFilePath(QString("%1_steps.csv").arg(m_ConnectionName));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CsvSink::setRetention(const RollupConfiguration &configuration)
+{
+  m_Retention = configuration;
+
+  m_RetentionTimer->start(cRetentionIntervalMs);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ObisSampleList CsvSink::readRange(const QString &obisNumber, const qint64 &from, const qint64 &to) const
+{
+  const QReadLocker locker(&m_FileLock);
+
+  return CsvSeekIndex::ReadRange(getFilePath(obisNumber), from, to);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 CsvSink::getFirstTimestamp(const QString &obisNumber) const
+{
+  const QReadLocker locker(&m_FileLock);
+
+  return CsvSeekIndex::FirstTimestamp(getFilePath(obisNumber));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QVector<RollupBucket> CsvSink::readRollups(const QString &obisNumber,
+                                           const QString &tierName,
+                                           const qint64 &from,
+                                           const qint64 &to) const
+{
+  QVector<RollupBucket> buckets;
+
+  const QReadLocker locker(&m_FileLock);
+
+  CsvSeekIndex::Scan(getRollupFilePath(obisNumber, tierName), from, to,
+                     [&buckets](const qint64 &timestamp, const QByteArray &row)
+  {
+    //timestamp,average,min,max,count
+    const auto fields = row.trimmed().split(',');
+    if(5 > fields.size()) return;
+
+    RollupBucket bucket(timestamp);
+    bucket.min = fields.at(2).toDouble();
+    bucket.max = fields.at(3).toDouble();
+    bucket.count = fields.at(4).toULongLong();
+
+    //the hold time is not stored, the count is used as weight instead
+    bucket.weight = qMax<qint64>(1, static_cast<qint64>(bucket.count));
+    bucket.weightedSum = fields.at(1).toDouble() * static_cast<double>(bucket.weight);
+
+    buckets.append(bucket);
+  });
+
+  return buckets;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<QPair<qint64, qint64>> CsvSink::getSegments(const QString &obisNumber,
+                                                  const qint64 &from,
+                                                  const qint64 &to,
+                                                  int count,
+                                                  const ValueRange &values) const
+{
+  const QString filePath = getFilePath(obisNumber);
+
+  const QReadLocker locker(&m_FileLock);
+
+  if(false == QFileInfo::exists(filePath)) return {};
+
+  //the indexes in m_Indexes belong to the writing thread, so the index is read from disk here
+  CsvSeekIndex index(filePath);
+  if(false == index.load()) return StorageSink::getSegments(obisNumber, from, to, count, values);
+
+  const int segmentCount = qMax(1, count);
+
+  if(true == values.isBounded())
+  {
+    const auto candidates = index.getCandidateRanges(from, to, values);
+
+    //neighbouring candidates are joined to at most count segments, this reads some skipped blocks again
+    const int perSegment = (candidates.size() + segmentCount - 1) / segmentCount;
+    if(1 >= perSegment) return candidates;
+
+    QList<QPair<qint64, qint64>> segments;
+    for(int i = 0; i < candidates.size(); i += perSegment)
+    {
+      const int last = qMin(i + perSegment, candidates.size()) - 1;
+      segments.append(qMakePair(candidates.at(i).first, candidates.at(last).second));
+    }
+
+    return segments;
+  }
+
+  QVector<qint64> boundaries;
+  for(const auto &entry : index.getEntries())
+  {
+    if((entry.timestamp > from) && (entry.timestamp <= to)) boundaries.append(entry.timestamp);
+  }
+
+  QList<QPair<qint64, qint64>> segments;
+
+  const int step = qMax(1, (boundaries.size() + segmentCount) / segmentCount);
+  qint64 start = from;
+
+  for(int i = step - 1; i < boundaries.size(); i += step)
+  {
+    if(boundaries.at(i) <= start) continue;
+
+    segments.append(qMakePair(start, boundaries.at(i) - 1));
+    start = boundaries.at(i);
+  }
+
+  segments.append(qMakePair(start, to));
+
+  return segments;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CsvSink::addMapping(const ObisValueMapping &mapping)
+{
+  if(false == mapping.isValid()) return;
+
+  if(false == m_ObisNumbers.contains(mapping.obisNumber)) m_ObisNumbers.append(mapping.obisNumber);
+
+  createFile(getFilePath(mapping.obisNumber), QStringList() << QString("timestamp")
+                                                            << QString("value")
+                                                            << QString("unit"));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CsvSink::removeMapping(const ObisValueMapping &mapping)
+{
+  m_ObisNumbers.removeAll(mapping.obisNumber);
+
+  QStringList filePaths;
+  filePaths << getFilePath(mapping.obisNumber);
+
+  for(const auto &tier : m_Retention.tiers)
+  {
+    filePaths << getRollupFilePath(mapping.obisNumber, tier.name);
+  }
+
+  for(const auto &filePath : filePaths)
+  {
+    m_Indexes.remove(filePath);
+
+    //a running background build only touches the index file, we simply do not wait for its result
+    auto watcher = m_PendingBuilds.take(filePath);
+    if(nullptr != watcher) watcher->deleteLater();
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSink::write(const QString &obisNumber, const qint64 &timestamp, const QVariant &dataValue, const QString &unit)
+{
+  bool numeric{};
+  const double value = dataValue.toDouble(&numeric);
+
+  return append(getFilePath(obisNumber), timestamp, (true == numeric) ? value : qQNaN(),
+                QStringList() << QString::number(timestamp)
+                              << dataValue.toString()
+                              << unit);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSink::writeRollup(const QString &obisNumber, const RollupTier &tier, const RollupBucket &bucket)
+{
+  if(false == bucket.isValid()) return false;
+
+  const QString filePath = getRollupFilePath(obisNumber, tier.name);
+
+  if((false == m_Indexes.contains(filePath)) && (false == m_PendingBuilds.contains(filePath)))
+  {
+    createFile(filePath, QStringList() << QString("timestamp")
+                                       << QString("average")
+                                       << QString("min")
+                                       << QString("max")
+                                       << QString("count"));
+  }
+
+  return append(filePath, bucket.start, bucket.average(), QStringList() << QString::number(bucket.start)
+                                                                        << QString::number(bucket.average())
+                                                                        << QString::number(bucket.min)
+                                                                        << QString::number(bucket.max)
+                                                                        << QString::number(bucket.count));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSink::writeEvent(const QString &obisNumber, const StepEvent &event)
+{
+  const QString filePath = getEventFilePath();
+
+  if((false == m_Indexes.contains(filePath)) && (false == m_PendingBuilds.contains(filePath)))
+  {
+    createFile(filePath, QStringList() << QString("timestamp")
+                                       << QString("obis")
+                                       << QString("event")
+                                       << QString("magnitude")
+                                       << QString("before")
+                                       << QString("after")
+                                       << QString("duration"));
+  }
+
+  return append(filePath, event.timestamp, event.magnitude,
+                QStringList() << QString::number(event.timestamp)
+                              << obisNumber
+                              << QString((true == event.on) ? "on" : "off")
+                              << QString::number(event.magnitude, 'f', 1)
+                              << QString::number(event.before, 'f', 1)
+                              << QString::number(event.after, 'f', 1)
+                              << ((0 <= event.duration) ? QString::number(event.duration) : QString()));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CsvSink::applyRetention()
+{
+  const WatchdogScope scope("CsvSink::applyRetention()");
+
+  //the previous run is still busy, it is finished before the next one
+  if((false == m_Expiry.isEmpty()) || (false == m_Expiring.isEmpty())) return;
+
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+  QList<QPair<QString, Duration>> files;
+
+  for(const auto &obisNumber : m_ObisNumbers)
+  {
+    files.append(qMakePair(getFilePath(obisNumber), m_Retention.rawRetention));
+
+    for(const auto &tier : m_Retention.tiers)
+    {
+      files.append(qMakePair(getRollupFilePath(obisNumber, tier.name), tier.retention));
+    }
+  }
+
+  for(const auto &file : files)
+  {
+    if(false == file.second.isValid()) continue;
+
+    m_Expiry.append(qMakePair(file.first, now - static_cast<qint64>(file.second.toMilliseconds())));
+  }
+
+  expireNext();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CsvSink::onExpired()
+{
+  const WatchdogScope scope("CsvSink::onExpired()");
+
+  if(true == m_Expiring.isEmpty()) return;
+
+  const QString filePath = m_Expiring;
+  m_Expiring.clear();
+
+  if(false == m_ExpiryWatcher->result())
+  {
+    qDebug() << "CsvSink::onExpired() failed to expire rows of" << filePath;
+  }
+
+  //the rows moved, so the index needs to be reopened before the rows written meanwhile are appended
+  if(true == m_Indexes.contains(filePath))
+  {
+    m_Indexes.remove(filePath);
+    openIndex(filePath);
+  }
+
+  const auto rows = m_PendingRows;
+  m_PendingRows.clear();
+
+  for(const auto &pending : rows)
+  {
+    append(filePath, pending.timestamp, pending.value, pending.row);
+  }
+
+  expireNext();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CsvSink::expireNext()
+{
+  while(false == m_Expiry.isEmpty())
+  {
+    const auto file = m_Expiry.takeFirst();
+
+    if(true == m_PendingBuilds.contains(file.first)) continue;
+    if(false == QFileInfo::exists(file.first)) continue;
+
+    m_Expiring = file.first;
+
+    QReadWriteLock* lock = &m_FileLock;
+    m_ExpiryWatcher->setFuture(QtConcurrent::run([lock, file]()
+    {
+      return CsvSeekIndex::ExpireRows(file.first, file.second, lock);
+    }));
+
+    return;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CsvSink::createFile(const QString &filePath, const QStringList &header)
+{
+  QFileInfo fi(filePath);
+  if(false == fi.exists())
+  {
+    QtCSV::StringData data;
+    data.addRow(header);
+
+    QtCSV::Writer::write(filePath, data);
+  }
+
+  openIndex(filePath);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CsvSink::append(const QString &filePath, const qint64 &timestamp, const double &value, const QStringList &row)
+{
+  //the file is being rewritten by the retention, the row is appended once it was replaced
+  if(filePath == m_Expiring)
+  {
+    m_PendingRows.append(PendingRow{timestamp, value, row});
+    return true;
+  }
+
+  auto index = m_Indexes.find(filePath);
+  const bool indexed = (index != m_Indexes.end()) && (true == index->isOpen());
+
+  //the offset is only required for every n-th row, so we only pay for the file size lookup there
+  const qint64 offset = ((true == indexed) && (true == index->needsOffset())) ? QFileInfo(filePath).size() : -1;
+
+  QtCSV::StringData data;
+  data.addRow(row);
+
+  const bool written = QtCSV::Writer::write(filePath, data, QString(","), QString("\""),
+                                            QtCSV::Writer::WriteMode::APPEND);
+
+  if((true == written) && (true == indexed))
+  {
+    index->onRowWritten(timestamp, value, offset);
+  }
+
+  return written;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void CsvSink::openIndex(const QString &filePath)
+{
+  if(true == m_PendingBuilds.contains(filePath)) return;
+
+  CsvSeekIndex index(filePath);
+  if(true == index.open())
+  {
+    m_Indexes.insert(filePath, index);
+    return;
+  }
+
+  //legacy logs are indexed in the background, rows written meanwhile are picked up when the index is opened
+  qDebug() << "CsvSink::openIndex() building index in the background for" << filePath;
+
+  m_Indexes.remove(filePath);
+
+  auto watcher = new QFutureWatcher<bool>(this);
+  m_PendingBuilds.insert(filePath, watcher);
+
+  connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, filePath]()
+  {
+    watcher->deleteLater();
+
+    if(watcher != m_PendingBuilds.value(filePath)) return;
+    m_PendingBuilds.remove(filePath);
+
+    if(false == watcher->result())
+    {
+      qDebug() << "CsvSink::openIndex() failed to build index for" << filePath;
+      return;
+    }
+
+    CsvSeekIndex index(filePath);
+    if(true == index.open()) m_Indexes.insert(filePath, index);
+  });
+
+  watcher->setFuture(QtConcurrent::run(&CsvSeekIndex::Build, filePath, CsvSeekIndex::cDefaultRowsPerEntry));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <QDir>
+#include <QMap>
+#include <QTimer>
+#include <QStringList>
+#include <QReadWriteLock>
+#include <QFutureWatcher>
+
+#include "CsvSeekIndex.h"
+#include "StorageSink.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The CsvSink class writes the values of a single connection into one "<name>_<obis>.csv" file per mapping
+ *
+ * Closed rollup buckets are written into one "<name>_<obis>_<tier>.csv" file per tier. Each csv file gets a sidecar
+ * seek index which is updated while writing. Indexes of already existing logs are built on a background thread, until
+ * then the affected file is written without index updates. Expired rows are removed on a background thread one file at
+ * a time, rows written meanwhile are appended once the file was replaced. Readers keep reading the previous file while
+ * the rows are copied and only wait for the short swap of the file and its index.
+ */
+class CsvSink : public StorageSink
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief CsvSink Constructor
+	 * @param connectionName The name of the connection, used as file name prefix
+	 * @param directory Where to store the csv files
+	 * @param parent
+	 */
+	explicit CsvSink(const QString &connectionName, const QDir &directory, QObject *parent = nullptr);
+
+	/**
+	 * @brief ~CsvSink Destructor, waits for a running rewrite of a file to append the rows written meanwhile
+	 */
+	virtual ~CsvSink() override;
+
+	/**
+	 * @brief getBackend
+	 * @return Always StorageBackend::eCsv
+	 */
+	virtual StorageBackend getBackend() const override;
+
+	/**
+	 * @brief getFilePath
+	 * @param obisNumber
+	 * @return The csv file used for the raw values of the given obis number
+	 */
+	QString getFilePath(const QString &obisNumber) const;
+
+	/**
+	 * @brief getRollupFilePath
+	 * @param obisNumber
+	 * @param tierName
+	 * @return The csv file used for the given rollup tier of the given obis number
+	 */
+	QString getRollupFilePath(const QString &obisNumber, const QString &tierName) const;
+
+	/**
+	 * @brief getEventFilePath
+	 * @return The csv file used for the detected steps of all series
+	 */
+	QString getEventFilePath() const;
+
+	/**
+	 * @brief setRetention Set the retention of the raw values and rollup tiers, expired rows are removed periodically
+	 * @param configuration
+	 */
+	virtual void setRetention(const RollupConfiguration &configuration) override;
+
+	/**
+	 * @brief readRange Read the stored raw samples of the given obis number within [from, to]
+	 * @param obisNumber
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @return
+	 */
+	virtual ObisSampleList readRange(const QString &obisNumber, const qint64 &from, const qint64 &to) const override;
+
+	/**
+	 * @brief getFirstTimestamp
+	 * @param obisNumber
+	 * @return The time of the first row of the csv file, -1 if there is none
+	 */
+	virtual qint64 getFirstTimestamp(const QString &obisNumber) const override;
+
+	/**
+	 * @brief readRollups Read the buckets of the given rollup tier which start within [from, to]
+	 * @param obisNumber
+	 * @param tierName
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @return
+	 */
+	virtual QVector<RollupBucket> readRollups(const QString &obisNumber,
+																						const QString &tierName,
+																						const qint64 &from,
+																						const qint64 &to) const override;
+
+	/**
+	 * @brief getSegments Split [from, to] at the entries of the seek index, so all segments contain about the same
+	 * number of rows
+	 * @param obisNumber
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @param count The maximum number of segments
+	 * @param values Index blocks whose zone map has no value in this range are left out
+	 * @return No segments at all if nothing was stored for the given obis number
+	 */
+	virtual QList<QPair<qint64, qint64>> getSegments(const QString &obisNumber,
+																									 const qint64 &from,
+																									 const qint64 &to,
+																									 int count,
+																									 const ValueRange &values = {}) const override;
+
+public slots:
+
+	/**
+	 * @brief addMapping Create the csv file for the given mapping if required and open its index
+	 * @param mapping
+	 */
+	virtual void addMapping(const ObisValueMapping &mapping) override;
+
+	/**
+	 * @brief removeMapping Stop following the indexes of the given mapping, the csv files are kept
+	 * @param mapping
+	 */
+	virtual void removeMapping(const ObisValueMapping &mapping) override;
+
+	/**
+	 * @brief write Append a single raw value
+	 * @param obisNumber
+	 * @param timestamp Time in milliseconds since epoch
+	 * @param dataValue
+	 * @param unit
+	 * @return True if the value was written
+	 */
+	virtual bool write(const QString &obisNumber,
+										 const qint64 &timestamp,
+										 const QVariant &dataValue,
+										 const QString &unit) override;
+
+	/**
+	 * @brief writeRollup Append a closed rollup bucket
+	 * @param obisNumber
+	 * @param tier
+	 * @param bucket
+	 * @return True if the bucket was written
+	 */
+	virtual bool writeRollup(const QString &obisNumber, const RollupTier &tier, const RollupBucket &bucket) override;
+
+	/**
+	 * @brief writeEvent Append a detected step to the steps file of the connection
+	 * @param obisNumber
+	 * @param event
+	 * @return True if the event was written
+	 */
+	virtual bool writeEvent(const QString &obisNumber, const StepEvent &event) override;
+
+	/**
+	 * @brief applyRetention Queue all files of this sink to remove their expired rows in the background
+	 */
+	void applyRetention();
+
+private slots:
+
+	/**
+	 * @brief onExpired Reopen the index of the rewritten file, append the rows written meanwhile and go on with the
+	 * next file
+	 */
+	void onExpired();
+
+private:
+
+	/**
+	 * @brief The PendingRow struct is a row written while its file is rewritten
+	 */
+	struct PendingRow
+	{
+		qint64 timestamp;
+		double value;
+		QStringList row;
+	};
+
+	/**
+	 * @brief expireNext Remove the expired rows of the next queued file on a background thread
+	 */
+	void expireNext();
+
+	/**
+	 * @brief createFile Create the given csv file with the given header if it does not exist yet and open its index
+	 * @param filePath
+	 * @param header
+	 */
+	void createFile(const QString &filePath, const QStringList &header);
+
+	/**
+	 * @brief append Append a single row and update the index
+	 * @param filePath
+	 * @param timestamp
+	 * @param value The value recorded in the zone map of the index, NaN for non numeric rows
+	 * @param row
+	 * @return True if the row was written
+	 */
+	bool append(const QString &filePath, const qint64 &timestamp, const double &value, const QStringList &row);
+
+	/**
+	 * @brief openIndex Open the index of the given csv file or build it in the background if missing
+	 * @param filePath
+	 */
+	void openIndex(const QString &filePath);
+
+	/**
+	 * @brief m_ConnectionName The name of the connection
+	 */
+	QString m_ConnectionName;
+
+	/**
+	 * @brief m_Directory Where the csv files are stored
+	 */
+	QDir m_Directory;
+
+	/**
+	 * @brief m_ObisNumbers The obis numbers written by this sink
+	 */
+	QStringList m_ObisNumbers;
+
+	/**
+	 * @brief m_Retention How long raw values and rollups are kept
+	 */
+	RollupConfiguration m_Retention;
+
+	/**
+	 * @brief m_RetentionTimer Periodically removes expired rows
+	 */
+	QTimer* m_RetentionTimer;
+
+	/**
+	 * @brief m_Indexes The opened seek indexes by file path
+	 */
+	QMap<QString, CsvSeekIndex> m_Indexes;
+
+	/**
+	 * @brief m_PendingBuilds Indexes which are currently built in the background by file path
+	 */
+	QMap<QString, QFutureWatcher<bool>*> m_PendingBuilds;
+
+	/**
+	 * @brief m_FileLock Keeps the readers off the files while the retention swaps one of them and its index
+	 */
+	mutable QReadWriteLock m_FileLock;
+
+	/**
+	 * @brief m_Expiry The files queued for the retention with the time before which their rows expire
+	 */
+	QList<QPair<QString, qint64>> m_Expiry;
+
+	/**
+	 * @brief m_Expiring The file which is currently rewritten, empty if none
+	 */
+	QString m_Expiring;
+
+	/**
+	 * @brief m_PendingRows The rows written to m_Expiring while it is rewritten
+	 */
+	QList<PendingRow> m_PendingRows;
+
+	/**
+	 * @brief m_ExpiryWatcher Watches the rewrite of m_Expiring
+	 */
+	QFutureWatcher<bool>* m_ExpiryWatcher;
+};
+
+}
@@ -0,0 +1,77 @@
+#include "Decimation.h"
+
+#include <QtMath>
+
+namespace Ssmr
+{
+
+QVector<QPointF> Decimation::LargestTriangleThreeBuckets(const QPointF* points, int count, int threshold)
+{
+  QVector<QPointF> sampled;
+  if((nullptr == points) || (0 >= count)) return sampled;
+
+  threshold = qMax(3, threshold);
+
+  if(count <= threshold)
+  {
+    sampled.reserve(count);
+    for(int i = 0; i < count; ++i) sampled.append(points[i]);
+    return sampled;
+  }
+
+  sampled.reserve(threshold);
+  sampled.append(points[0]);
+
+  //the first and the last point are buckets of their own
+  const double bucketSize = static_cast<double>(count - 2) / static_cast<double>(threshold - 2);
+
+  int selected = 0;
+
+  for(int bucket = 0; bucket < threshold - 2; ++bucket)
+  {
+    //the third point of the triangle is the average of the next bucket
+    const int nextBegin = static_cast<int>(qFloor((bucket + 1) * bucketSize)) + 1;
+    const int nextEnd = qMin(static_cast<int>(qFloor((bucket + 2) * bucketSize)) + 1, count);
+
+    double averageX = 0.0;
+    double averageY = 0.0;
+
+    for(int i = nextBegin; i < nextEnd; ++i)
+    {
+      averageX += points[i].x();
+      averageY += points[i].y();
+    }
+
+    averageX /= static_cast<double>(nextEnd - nextBegin);
+    averageY /= static_cast<double>(nextEnd - nextBegin);
+
+    const int begin = static_cast<int>(qFloor(bucket * bucketSize)) + 1;
+    const int end = nextBegin;
+
+    const QPointF &a = points[selected];
+
+    double maxArea = -1.0;
+    int candidate = begin;
+
+    for(int i = begin; i < end; ++i)
+    {
+      //twice the area, only the comparison matters
+      const double area = qAbs((a.x() - averageX) * (points[i].y() - a.y()) -
+                               (a.x() - points[i].x()) * (averageY - a.y()));
+      if(area <= maxArea) continue;
+
+      maxArea = area;
+      candidate = i;
+    }
+
+    sampled.append(points[candidate]);
+    selected = candidate;
+  }
+
+  sampled.append(points[count - 1]);
+
+  return sampled;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QPointF>
+#include <QVector>
+
+namespace Ssmr
+{
+
+/**
+ * @brief The Decimation class reduces series to the points needed to draw them at a given width
+ */
+class Decimation
+{
+public:
+
+	/**
+	 * @brief LargestTriangleThreeBuckets Downsample with the Largest-Triangle-Three-Buckets algorithm
+	 *
+	 * The first and the last point are kept, the points in between are split into equally sized buckets and of each
+	 * bucket the point spanning the largest triangle with the previously selected point and the average of the next
+	 * bucket is kept. Peaks survive the decimation, unlike with plain averaging or picking every n-th point.
+	 * @param points Sorted by x
+	 * @param count
+	 * @param threshold How many points to keep, at least 3
+	 * @return All points if there are not more than the threshold
+	 */
+	static QVector<QPointF> LargestTriangleThreeBuckets(const QPointF* points, int count, int threshold);
+};
+
+}
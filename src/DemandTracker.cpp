@@ -0,0 +1,312 @@
+#include "DemandTracker.h"
+
+#include <QtMath>
+#include <QDateTime>
+#include <QFileInfo>
+
+#include "qtcsv/stringdata.h"
+#include "qtcsv/reader.h"
+#include "qtcsv/writer.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  const QStringList cBillingPeriodNames = {QString("day"), QString("week"), QString("month")};
+
+  /*
+   * Returns the start of the width aligned interval containing the given timestamp
+   */
+  qint64 AlignDown(const qint64 &timestamp, const qint64 &width)
+  {
+    const qint64 remainder = timestamp % width;
+    return timestamp - ((0 > remainder) ? (remainder + width) : remainder);
+  }
+}
+
+DemandConfiguration DemandConfiguration::Load(QSettings &settings)
+{
+  DemandConfiguration configuration;
+
+  settings.beginGroup("demand");
+
+  configuration.obisNumber = settings.value("obis", configuration.obisNumber).toString();
+  configuration.subintervals = settings.value("subintervals", configuration.subintervals).toInt();
+  configuration.peakCount = settings.value("peaks", configuration.peakCount).toInt();
+
+  //the interval is stored in seconds like the mapping intervals
+  if(true == settings.contains("interval"))
+  {
+    configuration.interval = Duration::FromString(QString("%1s").arg(settings.value("interval").toULongLong()));
+  }
+
+  const int period = cBillingPeriodNames.indexOf(settings.value("period").toString());
+  if(0 <= period) configuration.billingPeriod = static_cast<CalendarPeriod>(period);
+
+  settings.endGroup();
+
+  return configuration;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+DemandConfiguration::DemandConfiguration()
+  : obisNumber("1-0:16.7.0*255")
+  , interval(0, 15, 0)
+  , subintervals(1)
+  , peakCount(3)
+  , billingPeriod(CalendarPeriod::eMonth)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool DemandConfiguration::isValid() const
+{
+  return (false == obisNumber.isEmpty()) && (true == interval.isValid()) && (0 < subintervals) && (0 < peakCount);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+DemandTracker::DemandTracker(const DemandConfiguration &configuration)
+  : m_Configuration(configuration)
+  , m_IntervalClosed()
+  , m_Steps(qMax(0, configuration.subintervals - 1), 0.0)
+  , m_NextStep(0)
+  , m_ClosedSteps(-1)
+  , m_WindowEnergy(0.0)
+  , m_StepStart(-1)
+  , m_StepEnergy(0.0)
+  , m_LastTimestamp(-1)
+  , m_LastValue(0.0)
+  , m_PeriodStart()
+  , m_Peaks()
+  , m_PreviousPeaks()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const DemandConfiguration &DemandTracker::getConfiguration() const
+{
+  return m_Configuration;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void DemandTracker::setIntervalClosedCallback(const IntervalClosedCallback &callback)
+{
+  m_IntervalClosed = callback;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void DemandTracker::addSample(const qint64 &timestamp, const double &value)
+{
+  if((false == m_Configuration.isValid()) || (true == qIsNaN(value))) return;
+  if(timestamp < m_LastTimestamp) return;
+
+  if(0 > m_StepStart)
+  {
+    m_StepStart = AlignDown(timestamp, getStepWidth());
+  }
+  else
+  {
+    hold(timestamp);
+  }
+
+  m_LastTimestamp = timestamp;
+  m_LastValue = value;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void DemandTracker::reset()
+{
+  m_Steps.fill(0.0);
+  m_NextStep = 0;
+  m_ClosedSteps = -1;
+  m_WindowEnergy = 0.0;
+  m_StepStart = -1;
+  m_StepEnergy = 0.0;
+  m_LastTimestamp = -1;
+  m_LastValue = 0.0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double DemandTracker::getProjectedDemand() const
+{
+  if((0 > m_StepStart) || (0 > m_LastTimestamp)) return qQNaN();
+
+  const qint64 remaining = qMax<qint64>(0, m_StepStart + getStepWidth() - m_LastTimestamp);
+  const double energy = m_WindowEnergy + m_StepEnergy + m_LastValue * static_cast<double>(remaining);
+
+  return energy / static_cast<double>(m_Configuration.interval.toMilliseconds());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const QList<DemandPeak> &DemandTracker::getPeaks() const
+{
+  return m_Peaks;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const QList<DemandPeak> &DemandTracker::getPreviousPeaks() const
+{
+  return m_PreviousPeaks;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double DemandTracker::getPeakDemand() const
+{
+  return (true == m_Peaks.isEmpty()) ? qQNaN() : m_Peaks.first().demand;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool DemandTracker::load(const QString &filePath)
+{
+  if(false == QFileInfo::exists(filePath)) return false;
+
+  m_PeriodStart = QDate();
+  m_Peaks.clear();
+  m_PreviousPeaks.clear();
+
+  const QList<QStringList> rows = QtCSV::Reader::readToList(filePath);
+
+  for(const auto &row : rows)
+  {
+    if(4 != row.size()) continue;
+
+    if(QString("period") == row.at(0))
+    {
+      m_PeriodStart = QDate::fromString(row.at(1), Qt::ISODate);
+      continue;
+    }
+
+    const DemandPeak peak{row.at(1).toLongLong(), row.at(2).toLongLong(), row.at(3).toDouble()};
+
+    if(QString("peak") == row.at(0)) m_Peaks.append(peak);
+    if(QString("previous") == row.at(0)) m_PreviousPeaks.append(peak);
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool DemandTracker::save(const QString &filePath) const
+{
+  QtCSV::StringData data;
+  data.addRow(QStringList() << QString("type") << QString("start") << QString("end") << QString("demand"));
+  data.addRow(QStringList() << QString("period") << m_PeriodStart.toString(Qt::ISODate) << QString() << QString());
+
+  const QList<QPair<QString, const QList<DemandPeak>*>> lists = {qMakePair(QString("peak"), &m_Peaks),
+                                                                 qMakePair(QString("previous"), &m_PreviousPeaks)};
+  for(const auto &list : lists)
+  {
+    for(const auto &peak : *list.second)
+    {
+      data.addRow(QStringList() << list.first
+                                << QString::number(peak.start)
+                                << QString::number(peak.end)
+                                << QString::number(peak.demand, 'f', 3));
+    }
+  }
+
+  return QtCSV::Writer::write(filePath, data);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void DemandTracker::hold(const qint64 &until)
+{
+  const qint64 width = getStepWidth();
+  const qint64 intervalWidth = static_cast<qint64>(m_Configuration.interval.toMilliseconds());
+
+  //like the rollups a value is not held forever, e.g. if the connection was interrupted
+  const qint64 heldUntil = qMin(until, m_LastTimestamp + cMaxHoldMilliseconds);
+
+  qint64 from = m_LastTimestamp;
+
+  while(true)
+  {
+    const qint64 stepEnd = m_StepStart + width;
+    const qint64 held = qMin(qMin(until, stepEnd), heldUntil) - from;
+
+    if(0 < held) m_StepEnergy += m_LastValue * static_cast<double>(held);
+    if(until < stepEnd) break;
+
+    closeStep();
+    from = stepEnd;
+
+    //after a long gap there is nothing to account, so the empty steps are skipped instead of closed one by one
+    if((from >= heldUntil) && (until - m_StepStart > intervalWidth))
+    {
+      m_Steps.fill(0.0);
+      m_NextStep = 0;
+      m_ClosedSteps = -1;
+      m_WindowEnergy = 0.0;
+      m_StepStart = AlignDown(until, width);
+      m_StepEnergy = 0.0;
+      break;
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void DemandTracker::closeStep()
+{
+  const qint64 stepEnd = m_StepStart + getStepWidth();
+  const qint64 intervalWidth = static_cast<qint64>(m_Configuration.interval.toMilliseconds());
+
+  //only intervals which were observed completely are demands
+  if(m_ClosedSteps >= m_Steps.size())
+  {
+    const DemandPeak interval{stepEnd - intervalWidth,
+                              stepEnd,
+                              (m_WindowEnergy + m_StepEnergy) / static_cast<double>(intervalWidth)};
+
+    addPeak(interval);
+
+    if(nullptr != m_IntervalClosed) m_IntervalClosed(interval);
+  }
+
+  if(false == m_Steps.isEmpty())
+  {
+    m_WindowEnergy += m_StepEnergy - m_Steps.at(m_NextStep);
+    m_Steps[m_NextStep] = m_StepEnergy;
+    m_NextStep = (m_NextStep + 1) % m_Steps.size();
+  }
+
+  m_ClosedSteps = qMin(m_Steps.size(), m_ClosedSteps + 1);
+  m_StepStart = stepEnd;
+  m_StepEnergy = 0.0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void DemandTracker::addPeak(const DemandPeak &interval)
+{
+  const QDate period = CalendarAggregates::PeriodStart(m_Configuration.billingPeriod,
+                                                       QDateTime::fromMSecsSinceEpoch(interval.start).date());
+
+  if((false == m_PeriodStart.isValid()) || (m_PeriodStart < period))
+  {
+    if(true == m_PeriodStart.isValid()) m_PreviousPeaks = m_Peaks;
+
+    m_Peaks.clear();
+    m_PeriodStart = period;
+  }
+
+  //intervals of an already finished billing period are not billed anymore
+  if(period < m_PeriodStart) return;
+
+  int index = 0;
+  while((index < m_Peaks.size()) && (m_Peaks.at(index).demand >= interval.demand)) ++index;
+
+  if(index >= m_Configuration.peakCount) return;
+
+  m_Peaks.insert(index, interval);
+  while(m_Peaks.size() > m_Configuration.peakCount) m_Peaks.removeLast();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 DemandTracker::getStepWidth() const
+{
+  return qMax<qint64>(1, static_cast<qint64>(m_Configuration.interval.toMilliseconds()) /
+                         qMax(1, m_Configuration.subintervals));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
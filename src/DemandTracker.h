@@ -0,0 +1,244 @@
+#pragma once
+
+#include <functional>
+
+#include <QDate>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QSettings>
+
+#include "TypeDefinitions.h"
+#include "CalendarAggregates.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The DemandConfiguration struct describes how the billed demand is measured
+ */
+struct DemandConfiguration
+{
+	/**
+	 * @brief Load Read the configuration from the "demand" group of the given settings
+	 * @param settings
+	 * @return The loaded configuration, the defaults are used for everything not configured
+	 */
+	static DemandConfiguration Load(QSettings &settings);
+
+	DemandConfiguration();
+
+	/**
+	 * @brief isValid
+	 * @return True if an obis number, an interval and at least one step per interval are set
+	 */
+	bool isValid() const;
+
+	//!The momentary power the demand is measured from
+	QString obisNumber;
+
+	//!The length of a demand interval, the demand is the average power within it
+	Duration interval;
+
+	//!1 for block demand. Sliding demand moves the interval in this many steps, e.g. 3 for 5 minute steps
+	int subintervals;
+
+	//!How many of the highest demands are kept per billing period
+	int peakCount;
+
+	//!The peaks start over with every billing period, in local time
+	CalendarPeriod billingPeriod;
+};
+
+/**
+ * @brief The DemandPeak struct contains the demand of a single closed interval
+ */
+struct DemandPeak
+{
+	//!The interval in milliseconds since epoch, the end is exclusive
+	qint64 start;
+	qint64 end;
+
+	//!The average power within the interval
+	double demand;
+};
+
+/**
+ * @brief The DemandTracker class measures the demand of a momentary power series while the values are received
+ *
+ * Each value is held until the next one arrives. The energy is accumulated per step of the interval, with block
+ * demand a step is the whole interval. Every time a step closes, the interval ending there is closed and its demand is
+ * compared to the peaks of the current billing period. Adding a value takes constant time per step passed since the
+ * last value.
+ */
+class DemandTracker
+{
+public:
+
+	/**
+	 * @brief IntervalClosedCallback Called for every closed demand interval
+	 */
+	typedef std::function<void(const DemandPeak &interval)> IntervalClosedCallback;
+
+	/**
+	 * @brief DemandTracker Constructor
+	 * @param configuration
+	 */
+	explicit DemandTracker(const DemandConfiguration &configuration = {});
+
+	/**
+	 * @brief getConfiguration
+	 * @return How the demand is measured
+	 */
+	const DemandConfiguration &getConfiguration() const;
+
+	/**
+	 * @brief setIntervalClosedCallback
+	 * @param callback
+	 */
+	void setIntervalClosedCallback(const IntervalClosedCallback &callback);
+
+	/**
+	 * @brief addSample Add a received power value
+	 * @param timestamp Time in milliseconds since epoch, values older than the last one are ignored
+	 * @param value
+	 */
+	void addSample(const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief reset Forget the running interval, e.g. when the connection was closed. The peaks are kept.
+	 */
+	void reset();
+
+	/**
+	 * @brief getProjectedDemand
+	 * @return The demand the running interval will end with if the last value is held until its end, NaN if unknown
+	 */
+	double getProjectedDemand() const;
+
+	/**
+	 * @brief getPeaks
+	 * @return The highest demands of the current billing period, the highest first
+	 */
+	const QList<DemandPeak> &getPeaks() const;
+
+	/**
+	 * @brief getPreviousPeaks
+	 * @return The highest demands of the previous billing period, the highest first
+	 */
+	const QList<DemandPeak> &getPreviousPeaks() const;
+
+	/**
+	 * @brief getPeakDemand
+	 * @return The highest demand of the current billing period, NaN if none
+	 */
+	double getPeakDemand() const;
+
+	/**
+	 * @brief load Replace the peaks with the ones stored in the given file
+	 * @param filePath
+	 * @return False if the file could not be read
+	 */
+	bool load(const QString &filePath);
+
+	/**
+	 * @brief save Store the peaks in the given file
+	 * @param filePath
+	 * @return False if the file could not be written
+	 */
+	bool save(const QString &filePath) const;
+
+private:
+
+	/**
+	 * @brief hold Account the last value until the given time and close all steps passed
+	 * @param until Time in milliseconds since epoch
+	 */
+	void hold(const qint64 &until);
+
+	/**
+	 * @brief closeStep Close the running step and the interval ending with it
+	 */
+	void closeStep();
+
+	/**
+	 * @brief addPeak Insert a closed interval into the peaks of its billing period
+	 * @param interval
+	 */
+	void addPeak(const DemandPeak &interval);
+
+	/**
+	 * @brief getStepWidth
+	 * @return The length of a single step in milliseconds
+	 */
+	qint64 getStepWidth() const;
+
+	/**
+	 * @brief m_Configuration How the demand is measured
+	 */
+	DemandConfiguration m_Configuration;
+
+	/**
+	 * @brief m_IntervalClosed Called for every closed interval
+	 */
+	IntervalClosedCallback m_IntervalClosed;
+
+	/**
+	 * @brief m_Steps The energy of the closed steps of the running interval in value times milliseconds, a ring buffer
+	 * with one step less than the interval has
+	 */
+	QVector<double> m_Steps;
+
+	/**
+	 * @brief m_NextStep The ring buffer index the running step is stored at when it is closed
+	 */
+	int m_NextStep;
+
+	/**
+	 * @brief m_ClosedSteps How many complete steps are in the ring buffer, -1 while the running step started without a
+	 * value held
+	 */
+	int m_ClosedSteps;
+
+	/**
+	 * @brief m_WindowEnergy The sum of the ring buffer
+	 */
+	double m_WindowEnergy;
+
+	/**
+	 * @brief m_StepStart The start of the running step, a negative time if none
+	 */
+	qint64 m_StepStart;
+
+	/**
+	 * @brief m_StepEnergy The energy of the running step so far
+	 */
+	double m_StepEnergy;
+
+	/**
+	 * @brief m_LastTimestamp The time of the last value, a negative time if none
+	 */
+	qint64 m_LastTimestamp;
+
+	/**
+	 * @brief m_LastValue The last value, held until the next one arrives
+	 */
+	double m_LastValue;
+
+	/**
+	 * @brief m_PeriodStart The first day of the current billing period
+	 */
+	QDate m_PeriodStart;
+
+	/**
+	 * @brief m_Peaks The highest demands of the current billing period
+	 */
+	QList<DemandPeak> m_Peaks;
+
+	/**
+	 * @brief m_PreviousPeaks The highest demands of the previous billing period
+	 */
+	QList<DemandPeak> m_PreviousPeaks;
+};
+
+}
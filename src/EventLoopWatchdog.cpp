@@ -0,0 +1,256 @@
+#include "EventLoopWatchdog.h"
+
+#include <QHash>
+#include <QDebug>
+#include <QTimer>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+
+#include "HelpFunctions.h"
+
+#include "qtcsv/stringdata.h"
+#include "qtcsv/writer.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  //the handler marked by the innermost scope on the GUI thread, nullptr if none is active
+  QAtomicPointer<const char> gActiveHandler(nullptr);
+
+  //while a probe is overdue the active handler is sampled this often
+  const int cSampleInterval = 20;
+
+  const char* const cUnknownHandler = "unknown";
+}
+
+const int EventLoopWatchdog::cProbeInterval = 500;
+
+EventLoopWatchdogConfiguration EventLoopWatchdogConfiguration::Load(QSettings &settings)
+{
+  EventLoopWatchdogConfiguration configuration;
+
+  settings.beginGroup("watchdog");
+
+  configuration.enabled = settings.value("enabled", configuration.enabled).toBool();
+  configuration.overlay = settings.value("overlay", configuration.overlay).toBool();
+  configuration.threshold = qMax(1, settings.value("threshold", configuration.threshold).toInt());
+
+  settings.endGroup();
+
+  return configuration;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+EventLoopWatchdogConfiguration::EventLoopWatchdogConfiguration()
+  : enabled(false)
+  , overlay(false)
+  , threshold(200)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+WatchdogScope::WatchdogScope(const char *handler)
+  : m_Previous(gActiveHandler.fetchAndStoreRelease(handler))
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+WatchdogScope::~WatchdogScope()
+{
+  gActiveHandler.storeRelease(m_Previous);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+class EventLoopWatchdog::Worker : public QObject
+{
+public:
+
+  Worker(EventLoopWatchdog* watchdog, const qint64 &threshold)
+    : QObject()
+    , m_Watchdog(watchdog)
+    , m_Threshold(threshold)
+    , m_Clock()
+    , m_Timer(nullptr)
+    , m_Pending(false)
+    , m_Posted(0)
+    , m_Answered(-1)
+    , m_MaximumLatency(0)
+    , m_Samples()
+  {
+  }
+
+  void start()
+  {
+    m_Clock.start();
+
+    m_Timer = new QTimer(this);
+    m_Timer->setSingleShot(true);
+    connect(m_Timer, &QTimer::timeout, this, [this]() { onTimeout(); });
+
+    probe();
+  }
+
+  void stop()
+  {
+    delete m_Timer;
+    m_Timer = nullptr;
+  }
+
+  qint64 takeMaximumLatency()
+  {
+    return m_MaximumLatency.fetchAndStoreRelaxed(0);
+  }
+
+private:
+
+  void probe()
+  {
+    m_Samples.clear();
+    m_Answered.storeRelease(-1);
+    m_Posted = m_Clock.elapsed();
+    m_Pending = true;
+
+    //run by the GUI thread once it processes its events again
+    QMetaObject::invokeMethod(m_Watchdog, [this]()
+    {
+      m_Answered.storeRelease(m_Clock.elapsed());
+    }, Qt::QueuedConnection);
+
+    //nothing has to be sampled unless the probe is still pending at the threshold
+    m_Timer->start(static_cast<int>(m_Threshold));
+  }
+
+  void onTimeout()
+  {
+    if(false == m_Pending)
+    {
+      probe();
+      return;
+    }
+
+    const qint64 answered = m_Answered.loadAcquire();
+
+    if(0 > answered)
+    {
+      const char* handler = gActiveHandler.loadAcquire();
+      ++m_Samples[(nullptr != handler) ? handler : cUnknownHandler];
+
+      m_Timer->start(cSampleInterval);
+      return;
+    }
+
+    m_Pending = false;
+    finish(answered - m_Posted);
+
+    m_Timer->start(static_cast<int>(qMax<qint64>(0, m_Posted + cProbeInterval - m_Clock.elapsed())));
+  }
+
+  void finish(const qint64 &latency)
+  {
+    qint64 maximum = m_MaximumLatency.loadRelaxed();
+    while((latency > maximum) && (false == m_MaximumLatency.testAndSetRelaxed(maximum, latency)))
+    {
+      maximum = m_MaximumLatency.loadRelaxed();
+    }
+
+    if(latency < m_Threshold) return;
+
+    //the handler which was sampled most often blocked the event loop for the longest part of the stall
+    const char* handler = cUnknownHandler;
+    int count = 0;
+    for(auto it = m_Samples.constBegin(); it != m_Samples.constEnd(); ++it)
+    {
+      if(it.value() <= count) continue;
+
+      handler = it.key();
+      count = it.value();
+    }
+
+    const qint64 timestamp = QDateTime::currentMSecsSinceEpoch() - (m_Clock.elapsed() - m_Posted);
+    const QString handlerName = QString::fromLatin1(handler);
+
+    qWarning() << "EventLoopWatchdog::Worker::finish() event loop stalled for" << latency << "ms in" << handlerName;
+
+    write(timestamp, latency, handlerName);
+
+    auto watchdog = m_Watchdog;
+    QMetaObject::invokeMethod(m_Watchdog, [watchdog, timestamp, latency, handlerName]()
+    {
+      emit watchdog->stallDetected(timestamp, latency, handlerName);
+    }, Qt::QueuedConnection);
+  }
+
+  void write(const qint64 &timestamp, const qint64 &duration, const QString &handler) const
+  {
+    const QString filePath = GetLogDirectory().absoluteFilePath(QString("stalls.csv"));
+
+    QtCSV::StringData data;
+
+    if(false == QFileInfo::exists(filePath))
+    {
+      data.addRow(QStringList() << QString("timestamp") << QString("duration") << QString("handler"));
+    }
+
+    data.addRow(QStringList() << QString::number(timestamp) << QString::number(duration) << handler);
+
+    //stalls are rare, so they are appended right away, this thread is not the one which stalled
+    QtCSV::Writer::write(filePath, data, QString(","), QString("\""), QtCSV::Writer::WriteMode::APPEND);
+  }
+
+  EventLoopWatchdog* m_Watchdog;
+  const qint64 m_Threshold;
+
+  //!Shared with the GUI thread, which only reads it
+  QElapsedTimer m_Clock;
+  QTimer* m_Timer;
+
+  //!True while a probe was posted and not answered yet
+  bool m_Pending;
+  qint64 m_Posted;
+
+  //!Set by the GUI thread when it ran the probe, -1 until then
+  QAtomicInteger<qint64> m_Answered;
+  QAtomicInteger<qint64> m_MaximumLatency;
+
+  //!How often each handler was active while the pending probe was overdue
+  QHash<const char*, int> m_Samples;
+};
+
+EventLoopWatchdog::EventLoopWatchdog(const EventLoopWatchdogConfiguration &configuration, QObject *parent)
+  : QObject(parent)
+  , m_Thread(new QThread(this))
+  , m_Worker(new Worker(this, configuration.threshold))
+{
+  m_Worker->moveToThread(m_Thread);
+  m_Thread->start();
+
+  auto worker = m_Worker;
+  QMetaObject::invokeMethod(m_Worker, [worker]() { worker->start(); }, Qt::QueuedConnection);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+EventLoopWatchdog::~EventLoopWatchdog()
+{
+  //the timer belongs to the worker thread, so it has to be deleted there
+  auto worker = m_Worker;
+  QMetaObject::invokeMethod(m_Worker, [worker]() { worker->stop(); }, Qt::BlockingQueuedConnection);
+
+  m_Thread->quit();
+  m_Thread->wait();
+
+  delete m_Worker;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 EventLoopWatchdog::takeMaximumLatency()
+{
+  return m_Worker->takeMaximumLatency();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QSettings>
+
+namespace Ssmr
+{
+
+/**
+ * @brief The EventLoopWatchdogConfiguration struct describes how the latency of the GUI event loop is watched
+ */
+struct EventLoopWatchdogConfiguration
+{
+	/**
+	 * @brief Load Read the configuration from the "watchdog" group of the given settings
+	 * @param settings
+	 * @return The loaded configuration, the defaults are used for everything not configured
+	 */
+	static EventLoopWatchdogConfiguration Load(QSettings &settings);
+
+	EventLoopWatchdogConfiguration();
+
+	//!True enables the watchdog, it is opt-in
+	bool enabled;
+
+	//!True shows the latency and the last stall in the status bar of the main window
+	bool overlay;
+
+	//!A probe which took at least this long in milliseconds is a stall, it is logged with its handler
+	int threshold;
+};
+
+/**
+ * @brief The WatchdogScope class marks the handler running on the GUI thread while it exists
+ *
+ * A stall is attributed to the marked handler which was active most of the time the event loop was blocked. Scopes
+ * nest, the previous handler is active again when a scope ends. Setting a marker is a single atomic store, so it can be
+ * placed in hot handlers. It must only be used on the GUI thread.
+ */
+class WatchdogScope
+{
+public:
+
+	/**
+	 * @brief WatchdogScope Mark the handler as active
+	 * @param handler A string literal like "Connection::onDataReceived()", it is not copied
+	 */
+	explicit WatchdogScope(const char* handler);
+
+	/**
+	 * @brief ~WatchdogScope Mark the previous handler as active again
+	 */
+	~WatchdogScope();
+
+private:
+
+	Q_DISABLE_COPY(WatchdogScope)
+
+	/**
+	 * @brief m_Previous The handler which was active before this scope
+	 */
+	const char* m_Previous;
+};
+
+/**
+ * @brief The EventLoopWatchdog class measures the latency of the GUI event loop and logs its stalls
+ *
+ * A worker thread periodically posts a probe to the GUI thread and measures how long it takes to be run. While a probe
+ * is overdue the worker samples the active WatchdogScope, so the handler which blocked the event loop is known even
+ * though the GUI thread cannot report anything itself. Every stall is appended to "stalls.csv" in the log directory.
+ */
+class EventLoopWatchdog : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief cProbeInterval How often the latency is measured in milliseconds
+	 */
+	static const int cProbeInterval;
+
+	/**
+	 * @brief EventLoopWatchdog Constructor, has to be called on the GUI thread
+	 * @param configuration
+	 * @param parent
+	 */
+	explicit EventLoopWatchdog(const EventLoopWatchdogConfiguration &configuration, QObject *parent = nullptr);
+
+	/**
+	 * @brief ~EventLoopWatchdog Destructor, stops the worker thread
+	 */
+	virtual ~EventLoopWatchdog() override;
+
+	/**
+	 * @brief takeMaximumLatency
+	 * @return The longest latency measured since the last call in milliseconds
+	 */
+	qint64 takeMaximumLatency();
+
+signals:
+
+	/**
+	 * @brief stallDetected Emitted after the event loop was blocked for at least the threshold
+	 * @param timestamp When the stall started in milliseconds since epoch
+	 * @param duration In milliseconds
+	 * @param handler The handler which was active most of the time, "unknown" if none was marked
+	 */
+	void stallDetected(const qint64 &timestamp, const qint64 &duration, const QString &handler);
+
+private:
+
+	class Worker;
+
+	/**
+	 * @brief m_Thread Runs the worker
+	 */
+	QThread* m_Thread;
+
+	/**
+	 * @brief m_Worker Posts the probes and samples the active handler
+	 */
+	Worker* m_Worker;
+};
+
+}
@@ -1,6 +1,8 @@
 #include "HelpFunctions.h"
 
 #include <QTextStream>
+#include <QCoreApplication>
+#include <QRegularExpression>
 #include <QMap>
 
 namespace Ssmr
@@ -17,6 +19,24 @@ namespace
     {{CommunicationProtocol::eUnknown, []() { return QObject::tr("unknown"); }},
      {CommunicationProtocol::eDSSInformation, []() { return QObject::tr("DSS-Information (SML)"); }},
      {CommunicationProtocol::eD0Dialog, []() { return QObject::tr("D0-Dialog (IEC 62056-21)"); }}};
+
+  const QMap<StorageBackend, QString> cStorageBackendMapping =
+    {{StorageBackend::eCsv, {"csv"}},
+     {StorageBackend::eSqlite, {"sqlite"}}};
+
+  const QMap<StorageBackend, std::function<QString()>> cStorageBackendDescriptionsMapping =
+    {{StorageBackend::eCsv, []() { return QObject::tr("CSV files"); }},
+     {StorageBackend::eSqlite, []() { return QObject::tr("SQLite database"); }}};
+
+  const QMap<CompressionMethod, QString> cCompressionMethodMapping =
+    {{CompressionMethod::eNone, {"none"}},
+     {CompressionMethod::eDeadband, {"deadband"}},
+     {CompressionMethod::eSwingingDoor, {"swingingdoor"}}};
+
+  const QMap<CompressionMethod, std::function<QString()>> cCompressionMethodDescriptionsMapping =
+    {{CompressionMethod::eNone, []() { return QObject::tr("None"); }},
+     {CompressionMethod::eDeadband, []() { return QObject::tr("Deadband"); }},
+     {CompressionMethod::eSwingingDoor, []() { return QObject::tr("Swinging door"); }}};
 }
 
 QString GetTooltipForSerialPortName(const QString &serialPortName)
@@ -111,4 +131,86 @@ QMap<CommunicationProtocol, std::function<QString ()>> GetCommunicationProtocolD
 }
 //----------------------------------------------------------------------------------------------------------------------
 
+StorageBackend ParseStorageBackendFromString(const QString &storage)
+{
+  return cStorageBackendMapping.key(storage.toLower(), StorageBackend::eCsv);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString ParseStringFromStorageBackend(const StorageBackend &storage)
+{
+  return cStorageBackendMapping.value(storage, QString());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QMap<StorageBackend, std::function<QString ()>> GetStorageBackendDescriptionsMapping()
+{
+  return cStorageBackendDescriptionsMapping;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+CompressionMethod ParseCompressionMethodFromString(const QString &compression)
+{
+  return cCompressionMethodMapping.key(compression.toLower(), CompressionMethod::eNone);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString ParseStringFromCompressionMethod(const CompressionMethod &compression)
+{
+  return cCompressionMethodMapping.value(compression, QString());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QMap<CompressionMethod, std::function<QString ()>> GetCompressionMethodDescriptionsMapping()
+{
+  return cCompressionMethodDescriptionsMapping;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 PackObisNumber(const QString &obisNumber)
+{
+  static const QRegularExpression r("^(\\d+)-(\\d+):(\\d+)\\.(\\d+)\\.(\\d+)\\*(\\d+)$");
+
+  const auto match = r.match(obisNumber);
+  if(false == match.hasMatch()) return -1;
+
+  qint64 packed{};
+
+  for(int i = 1; i <= 6; ++i)
+  {
+    const auto group = match.captured(i).toUInt();
+    if(255 < group) return -1;
+
+    packed = (packed << 8) | group;
+  }
+
+  return packed;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString UnpackObisNumber(const qint64 &packedObisNumber)
+{
+  const auto group = [packedObisNumber](int index) { return (packedObisNumber >> (8 * (5 - index))) & 0xFF; };
+
+  return QString("%1-%2:%3.%4.%5*%6").arg(group(0))
+                                     .arg(group(1))
+                                     .arg(group(2))
+                                     .arg(group(3))
+                                     .arg(group(4))
+                                     .arg(group(5));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QDir GetLogDirectory()
+{
+  QDir directory(QCoreApplication::applicationDirPath());
+
+  directory.cdUp();
+  directory.mkdir(QString("log"));
+  directory.cd(QString("log"));
+
+  return directory;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
 }
@@ -3,6 +3,7 @@
 #include "Connection.h"
 #include "TypeDefinitions.h"
 
+#include <QDir>
 #include <QString>
 #include <QSerialPortInfo>
 
@@ -66,4 +67,66 @@ GetCommunicationProtocolDescriptionsMapping();
  */
 extern QString ParseStringFromCommunicationProtocol(const CommunicationProtocol &protocol);
 
+/**
+ * @brief ParseStorageBackendFromString
+ * @param storage
+ * @return The storage backend, csv for unknown strings
+ */
+extern StorageBackend ParseStorageBackendFromString(const QString &storage);
+
+/**
+ * @brief ParseStringFromStorageBackend
+ * @param storage
+ * @return
+ */
+extern QString ParseStringFromStorageBackend(const StorageBackend &storage);
+
+/**
+ * @brief GetStorageBackendDescriptionsMapping
+ * @return A mapping from storage backends to translatable descriptions
+ */
+extern QMap<StorageBackend, std::function<QString()>>
+GetStorageBackendDescriptionsMapping();
+
+/**
+ * @brief ParseCompressionMethodFromString
+ * @param compression
+ * @return The compression method, none for unknown strings
+ */
+extern CompressionMethod ParseCompressionMethodFromString(const QString &compression);
+
+/**
+ * @brief ParseStringFromCompressionMethod
+ * @param compression
+ * @return
+ */
+extern QString ParseStringFromCompressionMethod(const CompressionMethod &compression);
+
+/**
+ * @brief GetCompressionMethodDescriptionsMapping
+ * @return A mapping from compression methods to translatable descriptions
+ */
+extern QMap<CompressionMethod, std::function<QString()>>
+GetCompressionMethodDescriptionsMapping();
+
+/**
+ * @brief PackObisNumber Pack an obis number "A-B:C.D.E*F" into a single integer with one byte per value group
+ * @param obisNumber
+ * @return The packed number or -1 if the obis number cannot be parsed
+ */
+extern qint64 PackObisNumber(const QString &obisNumber);
+
+/**
+ * @brief UnpackObisNumber
+ * @param packedObisNumber
+ * @return The obis number string for a number packed by PackObisNumber
+ */
+extern QString UnpackObisNumber(const qint64 &packedObisNumber);
+
+/**
+ * @brief GetLogDirectory
+ * @return The "log" directory next to the application directory, it is created if it does not exist
+ */
+extern QDir GetLogDirectory();
+
 }
@@ -0,0 +1,150 @@
+#include "HistoryLoader.h"
+
+#include <QtConcurrent>
+
+#include "Decimation.h"
+#include "QueryEngine.h"
+#include "StorageSink.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  //coarser passes would not show anything useful
+  const qint64 cMinBuckets = 16;
+
+  //finer passes are decimated to the width, but would take too long to load
+  const qint64 cMaxBucketsPerPoint = 16;
+}
+
+HistoryLoader::State::State()
+  : mutex()
+  , generation(0)
+  , loader(nullptr)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+HistoryLoader::HistoryLoader(QObject *parent)
+  : QObject(parent)
+  , m_Sink()
+  , m_Rollups(RollupConfiguration::Default())
+  , m_State(std::make_shared<State>())
+{
+  m_State->loader = this;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+HistoryLoader::~HistoryLoader()
+{
+  cancel();
+
+  //results queued before are removed together with the loader
+  QMutexLocker locker(&m_State->mutex);
+  m_State->loader = nullptr;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void HistoryLoader::setSink(const StorageSinkPtr &sink, const RollupConfiguration &rollups)
+{
+  //the running request keeps the previous sink until it stopped
+  cancel();
+
+  m_Sink = sink;
+  m_Rollups = rollups;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool HistoryLoader::load(const QStringList &obisNumbers, const qint64 &from, const qint64 &to, int width)
+{
+  const int generation = m_State->generation.fetchAndAddOrdered(1) + 1;
+
+  if((nullptr == m_Sink) || (true == obisNumbers.isEmpty()) || (from > to)) return false;
+
+  width = qMax(3, width);
+
+  const auto state = m_State;
+  const auto sink = m_Sink;
+  const auto passes = getPasses(from, to, width);
+
+  QueryEngine engine(sink.get(), m_Rollups);
+  engine.setCancellation([state, generation]() { return generation != state->generation.loadAcquire(); });
+
+  QtConcurrent::run([state, sink, engine, passes, obisNumbers, from, to, width, generation]()
+  {
+    for(int pass = 0; pass < passes.size(); ++pass)
+    {
+      const bool final = (pass + 1 == passes.size());
+      const qint64 half = static_cast<qint64>(passes.at(pass)) * 500;
+
+      for(const auto &obisNumber : obisNumbers)
+      {
+        const auto rows = engine.run(Query(obisNumber, from, to, QueryAggregate::eAverage,
+                                           Duration(0, 0, passes.at(pass))));
+
+        if(generation != state->generation.loadAcquire()) return;
+
+        QVector<QPointF> points;
+        points.reserve(rows.size());
+
+        //the average of a group is drawn in its middle
+        for(const auto &row : rows) points.append(QPointF(static_cast<double>(row.start + half), row.value));
+
+        points = Decimation::LargestTriangleThreeBuckets(points.constData(), points.size(), width);
+
+        QMutexLocker locker(&state->mutex);
+        if(nullptr == state->loader) return;
+
+        QMetaObject::invokeMethod(state->loader, [state, generation, obisNumber, points, final]()
+        {
+          //a newer request superseded this one while the result was queued
+          if(generation != state->generation.loadAcquire()) return;
+
+          emit state->loader->loaded(obisNumber, points, final);
+        }, Qt::QueuedConnection);
+      }
+    }
+  });
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void HistoryLoader::cancel()
+{
+  m_State->generation.fetchAndAddOrdered(1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<quint64> HistoryLoader::getPasses(const qint64 &from, const qint64 &to, int width) const
+{
+  QList<quint64> passes;
+
+  const qint64 range = to - from + 1;
+  qint64 finest = -1;
+
+  //the tiers are ordered from the finest to the coarsest
+  for(int i = m_Rollups.tiers.size() - 1; i >= 0; --i)
+  {
+    const auto &tier = m_Rollups.tiers.at(i);
+    if(false == tier.isValid()) continue;
+
+    const qint64 buckets = range / static_cast<qint64>(tier.width.toMilliseconds());
+    if((cMinBuckets > buckets) || (cMaxBucketsPerPoint * width < buckets)) continue;
+
+    passes.append(tier.width.toSeconds());
+    finest = buckets;
+  }
+
+  //the raw values are only needed if the rollups are coarser than a point, one group per point is read from them
+  if(finest < width)
+  {
+    passes.append(static_cast<quint64>(qMax<qint64>(1, range / width / 1000)));
+  }
+
+  return passes;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
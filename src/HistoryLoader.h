@@ -0,0 +1,120 @@
+#pragma once
+
+#include <QMutex>
+#include <QObject>
+#include <QPointF>
+#include <QVector>
+#include <QAtomicInt>
+#include <QStringList>
+
+#include <memory>
+
+#include "Rollup.h"
+#include "StorageSink.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The HistoryLoader class loads the stored history of several series in the background
+ *
+ * A request is answered in passes from the coarsest to the finest resolution. The passes use the rollup tiers with a
+ * useful number of buckets for the range, and the raw values only if even the finest tier is coarser than a pixel.
+ * The result of each pass is decimated to the requested width and delivered in the thread of the loader. A new request
+ * or cancel() supersedes the running one, it stops before the next segment of its query and its queued results are
+ * dropped. Nothing waits for a superseded request, it keeps its sink alive until it stopped.
+ */
+class HistoryLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief HistoryLoader Constructor
+	 * @param parent
+	 */
+	explicit HistoryLoader(QObject *parent = nullptr);
+
+	/**
+	 * @brief ~HistoryLoader Destructor, cancels the running request without waiting for it
+	 */
+	virtual ~HistoryLoader() override;
+
+	/**
+	 * @brief setSink Set where the history is read from, cancels the running request without waiting for it
+	 * @param sink nullptr to load nothing
+	 * @param rollups The rollup tiers written to the sink
+	 */
+	void setSink(const StorageSinkPtr &sink, const RollupConfiguration &rollups = RollupConfiguration::Default());
+
+	/**
+	 * @brief load Load the given series within [from, to], superseding the running request
+	 * @param obisNumbers
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @param width About how many points are needed per series, e.g. the width of the plot in pixels
+	 * @return False if nothing will be loaded
+	 */
+	bool load(const QStringList &obisNumbers, const qint64 &from, const qint64 &to, int width);
+
+	/**
+	 * @brief cancel Supersede the running request without a new one
+	 */
+	void cancel();
+
+signals:
+
+	/**
+	 * @brief loaded Emitted for every series after each pass
+	 * @param obisNumber
+	 * @param points x in milliseconds since epoch, ascending
+	 * @param final True for the last pass of the request
+	 */
+	void loaded(const QString &obisNumber, const QVector<QPointF> &points, bool final);
+
+private:
+
+	/**
+	 * @brief The State struct is shared with the running request, which may outlive the loader
+	 */
+	struct State
+	{
+		State();
+
+		//!Guards the loader while a result is queued to it
+		QMutex mutex;
+
+		//!Incremented by every request, a request stops once it is not the current one anymore
+		QAtomicInt generation;
+
+		//!nullptr once the loader is deleted
+		HistoryLoader* loader;
+	};
+
+	/**
+	 * @brief getPasses
+	 * @param from
+	 * @param to
+	 * @param width
+	 * @return The bucket widths of the passes from the coarsest to the finest in seconds
+	 */
+	QList<quint64> getPasses(const qint64 &from, const qint64 &to, int width) const;
+
+	/**
+	 * @brief m_Sink Where the history is read from
+	 */
+	StorageSinkPtr m_Sink;
+
+	/**
+	 * @brief m_Rollups The rollup tiers written to the sink
+	 */
+	RollupConfiguration m_Rollups;
+
+	/**
+	 * @brief m_State Shared with the running request
+	 */
+	std::shared_ptr<State> m_State;
+};
+
+}
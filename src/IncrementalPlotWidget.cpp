@@ -0,0 +1,455 @@
+#include "IncrementalPlotWidget.h"
+
+#include <QtMath>
+#include <QPainter>
+#include <QDateTime>
+#include <QWheelEvent>
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "TypeDefinitions.h"
+#include "TickScheduler.h"
+#include "EventLoopWatchdog.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  //10 frames per second
+  const int cTickInterval = 100;
+
+  //values may be received a little after their timestamp, the columns of this time span are drawn again
+  const qint64 cLateMilliseconds = 2000;
+
+  const qint64 cDefaultSpan = 10 * 60 * 1000;
+  const double cWheelZoomFactor = 1.25;
+
+  //the value range leaves some room, so it does not have to grow with every new extreme
+  const double cRangeMargin = 0.1;
+
+  const int cValueAxisWidth = 60;
+  const int cSpacing = 4;
+  const int cValueTicks = 4;
+  const int cTimeTicks = 2;
+
+  const QList<QColor> cColors = {QColor(31, 119, 180), QColor(255, 127, 14), QColor(44, 160, 44),
+                                 QColor(214, 39, 40), QColor(148, 103, 189), QColor(140, 86, 75),
+                                 QColor(227, 119, 194), QColor(127, 127, 127)};
+
+  bool IsBefore(const QPointF &point, const double &x)
+  {
+    return point.x() < x;
+  }
+}
+
+const qint64 IncrementalPlotWidget::cMinSpan = 10 * 1000;
+
+IncrementalPlotWidget::IncrementalPlotWidget(QWidget *parent)
+  : QWidget(parent)
+  , m_History()
+  , m_Series()
+  , m_Pixmap()
+  , m_Span(cDefaultSpan)
+  , m_MaximumSpan(24 * 60 * 60 * 1000)
+  , m_RightColumn(0)
+  , m_OpenColumn(0)
+  , m_Min(0.0)
+  , m_Max(1.0)
+  , m_Unit()
+  , m_FullRedraw(true)
+  , m_Tick(-1)
+{
+  //the pixmap covers the whole plot area
+  setAttribute(Qt::WA_OpaquePaintEvent);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::setHistoryCallback(const HistoryCallback &callback)
+{
+  m_History = callback;
+  m_FullRedraw = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::addSeries(const QString &key, const QString &name)
+{
+  for(auto &series : m_Series)
+  {
+    if(series.key != key) continue;
+
+    //the legend is not part of the pixmap
+    series.name = name;
+    update();
+    return;
+  }
+
+  m_Series.append(Series{key, name, cColors.at(m_Series.size() % cColors.size())});
+  m_FullRedraw = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::removeSeries(const QString &key)
+{
+  for(int i = 0; i < m_Series.size(); ++i)
+  {
+    if(m_Series.at(i).key != key) continue;
+
+    m_Series.removeAt(i);
+    m_FullRedraw = true;
+    return;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::setSpan(const qint64 &span)
+{
+  const qint64 bounded = qBound(cMinSpan, span, qMax(cMinSpan, m_MaximumSpan));
+  if(bounded == m_Span) return;
+
+  m_Span = bounded;
+  m_FullRedraw = true;
+
+  onTick();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 IncrementalPlotWidget::getSpan() const
+{
+  return m_Span;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::setMaximumSpan(const qint64 &span)
+{
+  m_MaximumSpan = span;
+  setSpan(m_Span);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::setUnit(const QString &unit)
+{
+  m_Unit = unit;
+  update();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::paintEvent(QPaintEvent *event)
+{
+  const WatchdogScope scope("IncrementalPlotWidget::paintEvent()");
+
+  Q_UNUSED(event)
+
+  QPainter painter(this);
+  painter.fillRect(rect(), palette().window());
+
+  const QRect plot = getPlotRect();
+  const int lineHeight = fontMetrics().height();
+
+  painter.drawPixmap(plot.topLeft(), m_Pixmap);
+
+  painter.setPen(palette().text().color());
+  painter.drawRect(plot.adjusted(-1, -1, 0, 0));
+
+  //only the labels are drawn on every paint, they are few
+  for(int i = 0; i <= cValueTicks; ++i)
+  {
+    const double value = m_Min + (m_Max - m_Min) * static_cast<double>(i) / static_cast<double>(cValueTicks);
+    const int y = plot.top() + toY(value);
+
+    painter.drawText(QRect(0, y - lineHeight / 2, plot.left() - cSpacing, lineHeight),
+                     Qt::AlignRight | Qt::AlignVCenter,
+                     QString::number(value, 'g', 4));
+  }
+
+  painter.drawText(QRect(0, 0, plot.left() - cSpacing, lineHeight), Qt::AlignRight | Qt::AlignVCenter, m_Unit);
+
+  const double millisecondsPerColumn = getMillisecondsPerColumn();
+  const QString format = (m_Span <= 24 * 60 * 60 * 1000) ? QString("hh:mm:ss") : QString("dd.MM hh:mm");
+
+  for(int i = 0; i <= cTimeTicks; ++i)
+  {
+    const int offset = (plot.width() - 1) * i / cTimeTicks;
+    const qint64 column = m_RightColumn - (plot.width() - 1) + offset;
+    const QString text = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(column * millisecondsPerColumn))
+                         .toString(format);
+
+    const int x = plot.left() + offset;
+    const int y = plot.bottom() + cSpacing;
+
+    if(0 == i)
+    {
+      painter.drawText(QRect(x, y, plot.width(), lineHeight), Qt::AlignLeft | Qt::AlignVCenter, text);
+    }
+    else if(cTimeTicks == i)
+    {
+      painter.drawText(QRect(x - plot.width(), y, plot.width(), lineHeight), Qt::AlignRight | Qt::AlignVCenter, text);
+    }
+    else
+    {
+      painter.drawText(QRect(x - plot.width() / 2, y, plot.width(), lineHeight), Qt::AlignCenter, text);
+    }
+  }
+
+  int x = plot.left();
+  for(const auto &series : m_Series)
+  {
+    painter.setPen(series.color);
+    painter.drawText(QRect(x, 0, width() - x, lineHeight), Qt::AlignLeft | Qt::AlignVCenter, series.name);
+
+    x += fontMetrics().horizontalAdvance(series.name) + 2 * cSpacing;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::resizeEvent(QResizeEvent *event)
+{
+  m_FullRedraw = true;
+  QWidget::resizeEvent(event);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::showEvent(QShowEvent *event)
+{
+  QWidget::showEvent(event);
+
+  TickScheduler::Instance()->unsubscribe(m_Tick);
+  m_Tick = TickScheduler::Instance()->subscribe(this, cTickInterval, [this](const qint64 &) { onTick(); });
+  onTick();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::hideEvent(QHideEvent *event)
+{
+  QWidget::hideEvent(event);
+  TickScheduler::Instance()->unsubscribe(m_Tick);
+  m_Tick = -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::wheelEvent(QWheelEvent *event)
+{
+  const double steps = static_cast<double>(event->angleDelta().y()) / 120.0;
+  if(0.0 == steps)
+  {
+    QWidget::wheelEvent(event);
+    return;
+  }
+
+  //scrolling up zooms in
+  setSpan(qRound64(static_cast<double>(m_Span) * qPow(cWheelZoomFactor, -steps)));
+  event->accept();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::onTick()
+{
+  const WatchdogScope scope("IncrementalPlotWidget::onTick()");
+
+  if(false == isVisible()) return;
+
+  const QRect plot = getPlotRect();
+  if((0 >= plot.width()) || (0 >= plot.height())) return;
+
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+  if((true == m_FullRedraw) || (m_Pixmap.size() != plot.size()))
+  {
+    redraw(now);
+    update();
+    return;
+  }
+
+  const qint64 column = toColumn(static_cast<double>(now));
+  const qint64 shift = column - m_RightColumn;
+
+  //nothing of the pixmap would remain, or the clock was set back
+  if((0 > shift) || (shift >= m_Pixmap.width()))
+  {
+    redraw(now);
+    update();
+    return;
+  }
+
+  if(0 < shift)
+  {
+    m_Pixmap.scroll(static_cast<int>(-shift), 0, m_Pixmap.rect());
+    m_RightColumn = column;
+  }
+
+  //the open columns cover the columns revealed by the scroll
+  const qint64 open = toColumn(static_cast<double>(now - cLateMilliseconds));
+
+  if(false == drawColumns(qMin(m_OpenColumn, open), column))
+  {
+    redraw(now);
+  }
+  else
+  {
+    m_OpenColumn = open;
+  }
+
+  update();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QRect IncrementalPlotWidget::getPlotRect() const
+{
+  const int lineHeight = fontMetrics().height();
+
+  return QRect(cValueAxisWidth,
+               lineHeight + cSpacing,
+               qMax(0, width() - cValueAxisWidth - cSpacing),
+               qMax(0, height() - 2 * (lineHeight + cSpacing)));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double IncrementalPlotWidget::getMillisecondsPerColumn() const
+{
+  return qMax(1.0, static_cast<double>(m_Span) / static_cast<double>(qMax(1, m_Pixmap.width())));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 IncrementalPlotWidget::toColumn(const double &timestamp) const
+{
+  return static_cast<qint64>(std::floor(timestamp / getMillisecondsPerColumn()));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int IncrementalPlotWidget::toY(const double &value) const
+{
+  if(m_Max <= m_Min) return 0;
+
+  return qRound((m_Max - value) / (m_Max - m_Min) * static_cast<double>(m_Pixmap.height() - 1));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void IncrementalPlotWidget::redraw(const qint64 &now)
+{
+  const QRect plot = getPlotRect();
+  if(m_Pixmap.size() != plot.size()) m_Pixmap = QPixmap(plot.size());
+
+  m_RightColumn = toColumn(static_cast<double>(now));
+
+  const qint64 left = m_RightColumn - m_Pixmap.width() + 1;
+  const double millisecondsPerColumn = getMillisecondsPerColumn();
+
+  double min = std::numeric_limits<double>::max();
+  double max = std::numeric_limits<double>::lowest();
+
+  for(const auto &series : m_Series)
+  {
+    if(nullptr == m_History) break;
+
+    const auto history = m_History(series.key);
+
+    const QPointF* end = history.second;
+    const QPointF* point = std::lower_bound(history.first, end, static_cast<double>(left) * millisecondsPerColumn,
+                                            IsBefore);
+
+    for(; (point != end) && (toColumn(point->x()) <= m_RightColumn); ++point)
+    {
+      min = qMin(min, point->y());
+      max = qMax(max, point->y());
+    }
+  }
+
+  if(min > max)
+  {
+    m_Min = 0.0;
+    m_Max = 1.0;
+  }
+  else
+  {
+    const double margin = (min < max) ? (max - min) * cRangeMargin : qMax(1.0, qAbs(min) * cRangeMargin);
+
+    m_Min = min - margin;
+    m_Max = max + margin;
+  }
+
+  drawColumns(left, m_RightColumn);
+
+  m_OpenColumn = toColumn(static_cast<double>(now - cLateMilliseconds));
+  m_FullRedraw = false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool IncrementalPlotWidget::drawColumns(const qint64 &from, const qint64 &to)
+{
+  const qint64 left = m_RightColumn - m_Pixmap.width() + 1;
+  const qint64 first = qMax(from, left);
+
+  if(first > to) return true;
+
+  QPainter painter(&m_Pixmap);
+  painter.fillRect(QRect(static_cast<int>(first - left), 0, static_cast<int>(to - first) + 1, m_Pixmap.height()),
+                   palette().base());
+
+  if(nullptr == m_History) return true;
+
+  const double millisecondsPerColumn = getMillisecondsPerColumn();
+
+  for(const auto &series : m_Series)
+  {
+    const auto history = m_History(series.key);
+
+    const QPointF* begin = history.first;
+    const QPointF* end = history.second;
+    const QPointF* point = std::lower_bound(begin, end, static_cast<double>(first) * millisecondsPerColumn, IsBefore);
+
+    painter.setPen(series.color);
+
+    //the line from the previous value is drawn again, it may reach into the cleared columns
+    bool previous = (point != begin);
+    double previousTime = (true == previous) ? (point - 1)->x() : 0.0;
+    int previousX = (true == previous) ? static_cast<int>(toColumn(previousTime) - left) : 0;
+    int previousY = (true == previous) ? toY((point - 1)->y()) : 0;
+
+    while(point != end)
+    {
+      const qint64 column = toColumn(point->x());
+      if(column > to) break;
+
+      const double firstTime = point->x();
+      const double firstValue = point->y();
+
+      double min = firstValue;
+      double max = firstValue;
+      double last = firstValue;
+      double lastTime = firstTime;
+
+      for(; (point != end) && (toColumn(point->x()) == column); ++point)
+      {
+        min = qMin(min, point->y());
+        max = qMax(max, point->y());
+        last = point->y();
+        lastTime = point->x();
+      }
+
+      if((min < m_Min) || (max > m_Max)) return false;
+
+      const int x = static_cast<int>(column - left);
+
+      //values are not joined across gaps, like the rollups do not hold them
+      if((true == previous) && (firstTime - previousTime <= static_cast<double>(cMaxHoldMilliseconds)))
+      {
+        painter.drawLine(previousX, previousY, x, toY(firstValue));
+      }
+
+      //the envelope of all values in this column
+      painter.drawLine(x, toY(min), x, toY(max));
+
+      previous = true;
+      previousTime = lastTime;
+      previousX = x;
+      previousY = toY(last);
+    }
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
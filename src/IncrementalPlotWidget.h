@@ -0,0 +1,221 @@
+#pragma once
+
+#include <functional>
+
+#include <QList>
+#include <QPair>
+#include <QColor>
+#include <QPixmap>
+#include <QPointF>
+#include <QWidget>
+
+namespace Ssmr
+{
+
+/**
+ * @brief The IncrementalPlotWidget class plots the latest values of many series at a low cost
+ *
+ * The plot is kept in a backing pixmap with one column per pixel. On every tick the pixmap is scrolled by the time
+ * passed and only the columns of the new values are drawn, each as the min/max envelope of its values. The whole
+ * pixmap is only drawn again when the widget is resized, the span is changed or a value leaves the value range.
+ * The values are not copied, they are read from the history of the owner when a column is drawn.
+ */
+class IncrementalPlotWidget : public QWidget
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief HistoryCallback Returns the values of the series with the given key as [begin, end) with x in
+	 * milliseconds since epoch, ascending
+	 */
+	typedef std::function<QPair<const QPointF*, const QPointF*>(const QString &key)> HistoryCallback;
+
+	/**
+	 * @brief cMinSpan The shortest time span which can be shown in milliseconds
+	 */
+	static const qint64 cMinSpan;
+
+	/**
+	 * @brief IncrementalPlotWidget Constructor
+	 * @param parent
+	 */
+	explicit IncrementalPlotWidget(QWidget *parent = nullptr);
+
+	/**
+	 * @brief setHistoryCallback
+	 * @param callback
+	 */
+	void setHistoryCallback(const HistoryCallback &callback);
+
+	/**
+	 * @brief addSeries Plot the series with the given key, an already plotted one is renamed
+	 * @param key
+	 * @param name Shown in the legend
+	 */
+	void addSeries(const QString &key, const QString &name);
+
+	/**
+	 * @brief removeSeries
+	 * @param key
+	 */
+	void removeSeries(const QString &key);
+
+	/**
+	 * @brief setSpan Set the time span up to now which is shown
+	 * @param span In milliseconds, at least cMinSpan and at most the maximum span
+	 */
+	void setSpan(const qint64 &span);
+
+	/**
+	 * @brief getSpan
+	 * @return The time span up to now which is shown in milliseconds
+	 */
+	qint64 getSpan() const;
+
+	/**
+	 * @brief setMaximumSpan Limit the span, e.g. to how long the history is kept
+	 * @param span In milliseconds
+	 */
+	void setMaximumSpan(const qint64 &span);
+
+	/**
+	 * @brief setUnit Set the unit shown at the value axis
+	 * @param unit
+	 */
+	void setUnit(const QString &unit);
+
+protected:
+
+	virtual void paintEvent(QPaintEvent *event) override;
+	virtual void resizeEvent(QResizeEvent *event) override;
+
+	/**
+	 * @brief showEvent Resume the ticks, the values missed while hidden are drawn with the first one
+	 * @param event
+	 */
+	virtual void showEvent(QShowEvent *event) override;
+
+	/**
+	 * @brief hideEvent Suspend the ticks while hidden, e.g. minimized to the tray
+	 * @param event
+	 */
+	virtual void hideEvent(QHideEvent *event) override;
+
+	/**
+	 * @brief wheelEvent Change the span with the mouse wheel
+	 * @param event
+	 */
+	virtual void wheelEvent(QWheelEvent *event) override;
+
+private slots:
+
+	/**
+	 * @brief onTick Scroll the pixmap to now and draw the new values
+	 */
+	void onTick();
+
+private:
+
+	/**
+	 * @brief The Series struct contains how a series is drawn
+	 */
+	struct Series
+	{
+		QString key;
+		QString name;
+		QColor color;
+	};
+
+	/**
+	 * @brief getPlotRect
+	 * @return Where the pixmap is drawn, without the axis labels and the legend
+	 */
+	QRect getPlotRect() const;
+
+	/**
+	 * @brief getMillisecondsPerColumn
+	 * @return The time span of a single pixel column
+	 */
+	double getMillisecondsPerColumn() const;
+
+	/**
+	 * @brief toColumn
+	 * @param timestamp
+	 * @return The pixel column containing the given time in milliseconds since epoch
+	 */
+	qint64 toColumn(const double &timestamp) const;
+
+	/**
+	 * @brief toY
+	 * @param value
+	 * @return The pixel row of the value in the pixmap
+	 */
+	int toY(const double &value) const;
+
+	/**
+	 * @brief redraw Draw the whole pixmap again, the value range is fitted to the visible values
+	 * @param now The time at the right edge in milliseconds since epoch
+	 */
+	void redraw(const qint64 &now);
+
+	/**
+	 * @brief drawColumns Clear and draw the given columns of the pixmap
+	 * @param from
+	 * @param to
+	 * @return False if a value is outside the value range, the pixmap has to be drawn again then
+	 */
+	bool drawColumns(const qint64 &from, const qint64 &to);
+
+	/**
+	 * @brief m_History Where the values are read from
+	 */
+	HistoryCallback m_History;
+
+	/**
+	 * @brief m_Series The plotted series in the order they were added
+	 */
+	QList<Series> m_Series;
+
+	/**
+	 * @brief m_Pixmap The backing pixmap of the plot area, the right edge is m_RightColumn
+	 */
+	QPixmap m_Pixmap;
+
+	/**
+	 * @brief m_Span The shown time span and its maximum in milliseconds
+	 */
+	qint64 m_Span;
+	qint64 m_MaximumSpan;
+
+	/**
+	 * @brief m_RightColumn The column at the right edge of the pixmap
+	 */
+	qint64 m_RightColumn;
+
+	/**
+	 * @brief m_OpenColumn The first column which may still receive values, it is drawn again on the next tick
+	 */
+	qint64 m_OpenColumn;
+
+	/**
+	 * @brief m_Min The value range of the pixmap
+	 */
+	double m_Min;
+	double m_Max;
+
+	QString m_Unit;
+
+	/**
+	 * @brief m_FullRedraw True if the whole pixmap has to be drawn on the next tick
+	 */
+	bool m_FullRedraw;
+
+	/**
+	 * @brief m_Tick The tick subscription while visible, -1 while hidden
+	 */
+	int m_Tick;
+};
+
+}
@@ -0,0 +1,100 @@
+#include "LiveSeriesAligner.h"
+
+#include "TickScheduler.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  //the watermark is advanced at least this often, so long steps are not forced much later than due
+  const qint64 cMaxWatermarkInterval = 60 * 1000;
+}
+
+LiveAlignmentConfiguration LiveAlignmentConfiguration::Load(QSettings &settings)
+{
+  LiveAlignmentConfiguration configuration;
+
+  settings.beginGroup("alignment");
+
+  configuration.series = settings.value("series", configuration.series).toStringList();
+
+  if(true == settings.contains("step"))
+  {
+    configuration.step = Duration::FromString(settings.value("step").toString());
+  }
+
+  if((true == settings.contains("method")) &&
+     (false == SeriesAligner::ParseMethod(settings.value("method").toString(), configuration.method)))
+  {
+    configuration.method = AlignMethod::eLast;
+  }
+
+  settings.endGroup();
+
+  return configuration;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+LiveAlignmentConfiguration::LiveAlignmentConfiguration()
+  : series()
+  , step(0, 1, 0)
+  , method(AlignMethod::eLast)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool LiveAlignmentConfiguration::isValid() const
+{
+  return (false == series.isEmpty()) && (true == step.isValid());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+LiveSeriesAligner::LiveSeriesAligner(const QList<QPair<ConnectionPtr, QString>> &series,
+                                     const Duration &step,
+                                     const AlignMethod &method,
+                                     QObject *parent)
+  : QObject(parent)
+  , m_Aligner(series.size(), step, method)
+  , m_Step(qMax<qint64>(1, static_cast<qint64>(step.toMilliseconds())))
+  , m_Watermark(-1)
+{
+  m_Aligner.setRowCallback([this](const qint64 &timestamp, const QVector<double> &values)
+  {
+    emit rowAligned(timestamp, values);
+  });
+
+  for(int i = 0; i < series.size(); ++i)
+  {
+    const auto &connection = series.at(i).first;
+    const auto obisNumber = series.at(i).second;
+
+    if(nullptr == connection) continue;
+
+    connect(connection.get(), &Connection::dataValueReceived, this,
+            [this, i, obisNumber](const QString &obisValue, const qint64 &timestamp, const QVariant &dataValue)
+    {
+      if((obisValue != obisNumber) || (QMetaType::Double != dataValue.userType())) return;
+
+      m_Aligner.addSample(i, timestamp, dataValue.toDouble());
+    });
+  }
+
+  m_Watermark = TickScheduler::Instance()->subscribe(this, static_cast<int>(qMin(m_Step, cMaxWatermarkInterval)),
+                                                     [this](const qint64 &now) { onWatermark(now); });
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+LiveSeriesAligner::~LiveSeriesAligner()
+{
+  TickScheduler::Instance()->unsubscribe(m_Watermark);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void LiveSeriesAligner::onWatermark(const qint64 &now)
+{
+  m_Aligner.advance(now - m_Step);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
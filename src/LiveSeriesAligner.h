@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QList>
+#include <QPair>
+#include <QObject>
+#include <QVector>
+#include <QSettings>
+#include <QStringList>
+
+#include "Connection.h"
+#include "SeriesAligner.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The LiveAlignmentConfiguration struct describes which received series are aligned and logged while running
+ */
+struct LiveAlignmentConfiguration
+{
+	/**
+	 * @brief Load Read the configuration from the "alignment" group of the given settings
+	 * @param settings
+	 * @return The loaded configuration, the defaults are used for everything not configured
+	 */
+	static LiveAlignmentConfiguration Load(QSettings &settings);
+
+	LiveAlignmentConfiguration();
+
+	/**
+	 * @brief isValid
+	 * @return True if there are series and a valid step
+	 */
+	bool isValid() const;
+
+	//!The series like "connection/obis", nothing is aligned without any
+	QStringList series;
+
+	//!The distance of the grid points
+	Duration step;
+
+	//!How the value of a series at a grid point is determined
+	AlignMethod method;
+};
+
+/**
+ * @brief The LiveSeriesAligner class aligns the received values of series from any number of connections
+ *
+ * The values are passed to a SeriesAligner while they are received. Grid points are emitted as soon as all series
+ * passed them, a grid point is forced one step after the wall clock passed it, so a silent meter does not block the
+ * others.
+ */
+class LiveSeriesAligner : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief LiveSeriesAligner Constructor
+	 * @param series The connection and obis number of each series, in the order of the emitted values
+	 * @param step The distance of the grid points
+	 * @param method
+	 * @param parent
+	 */
+	LiveSeriesAligner(const QList<QPair<ConnectionPtr, QString>> &series,
+										const Duration &step,
+										const AlignMethod &method,
+										QObject *parent = nullptr);
+
+	/**
+	 * @brief ~LiveSeriesAligner Destructor
+	 */
+	virtual ~LiveSeriesAligner() override;
+
+signals:
+
+	/**
+	 * @brief rowAligned Emitted for every grid point
+	 * @param timestamp The grid point in milliseconds since epoch
+	 * @param values The value of each series, NaN if a series has none
+	 */
+	void rowAligned(const qint64 &timestamp, const QVector<double> &values);
+
+private:
+
+	/**
+	 * @brief onWatermark Force the grid points which are overdue
+	 * @param now Time of the tick in milliseconds since epoch
+	 */
+	void onWatermark(const qint64 &now);
+
+	/**
+	 * @brief m_Aligner
+	 */
+	SeriesAligner m_Aligner;
+
+	/**
+	 * @brief m_Step The distance of the grid points in milliseconds
+	 */
+	qint64 m_Step;
+
+	/**
+	 * @brief m_Watermark The tick subscription which forces overdue grid points
+	 */
+	int m_Watermark;
+};
+
+}
@@ -3,44 +3,63 @@
 
 #include "ConnectionDialog.h"
 #include "ConnectionWindow.h"
+#include "ConnectionStorage.h"
+#include "ConnectionListModel.h"
 #include "ConnectionSerializer.h"
+#include "EventLoopWatchdog.h"
+#include "LiveSeriesAligner.h"
 #include "HelpFunctions.h"
+#include "TickScheduler.h"
 
+#include <QtMath>
 #include <QDebug>
+#include <QDateTime>
+#include <QFileInfo>
 #include <QMessageBox>
 
+#include "qtcsv/stringdata.h"
+#include "qtcsv/writer.h"
+
 namespace Ssmr
 {
 
 namespace
 {
-
-ConnectionPtr GetConnectionForListWidgetItem(QListWidgetItem* item,
-                                             QMap<ConnectionPtr, QPair<QListWidgetItem*, QWidget*>> mapping)
-{
-  if(nullptr == item) return {};
-
-  for(const auto &connection : mapping.keys())
-  {
-    if(nullptr == connection) continue;
-
-    if(mapping.value(connection).first == item) return connection;
-  }
-
-  return {};
-}
-//----------------------------------------------------------------------------------------------------------------------
-
+  //how often the latency shown in the overlay is updated
+  const int cWatchdogOverlayInterval = 1000;
 }
 
 MainWindow::MainWindow(QWidget *parent)
   : QMainWindow(parent)
   , ui(new Ui::MainWindow)
   , m_Settings()
+  , m_Connections(new ConnectionListModel(this))
+  , m_ConnectionStorages()
+  , m_ConnectionWindows()
+  , m_RuleActions(new RuleActionDispatcher(this))
+  , m_Watchdog(nullptr)
+  , m_WatchdogOverlay(nullptr)
+  , m_LastStall()
+  , m_LiveAlignment(nullptr)
 {
   ui->setupUi(this);
 
-  ui->btnRemoveConnection->setEnabled(!ui->listWidget->selectedItems().isEmpty());
+  const auto watchdog = EventLoopWatchdogConfiguration::Load(m_Settings);
+  if(true == watchdog.enabled)
+  {
+    m_Watchdog = new EventLoopWatchdog(watchdog, this);
+
+    if(true == watchdog.overlay) createWatchdogOverlay();
+  }
+
+  ui->listConnections->setModel(m_Connections);
+
+  connect(ui->listConnections->selectionModel(), &QItemSelectionModel::currentChanged,
+          this, &MainWindow::onCurrentConnectionChanged);
+  connect(ui->listConnections->selectionModel(), &QItemSelectionModel::selectionChanged,
+          this, &MainWindow::onConnectionSelectionChanged);
+
+  onConnectionSelectionChanged();
 
   connect(this, &MainWindow::connectionAdded, this, &MainWindow::onAddConnection);
 
@@ -53,16 +72,13 @@ MainWindow::MainWindow(QWidget *parent)
     qApp->exit(0);
   });
 
-  m_Connections = ConnectionSerializer::DeserializeConnections(m_Settings);
-  for(const auto &connection : m_Connections)
+  for(const auto &connection : ConnectionSerializer::DeserializeConnections(m_Settings))
   {
-    const ConnectionWeakPtr connectionWeakPtr = connection;
-
-    connect(connection.get(), &Connection::connectionChanged,
-            this, std::bind(&MainWindow::onChangedConnectionState, this, connectionWeakPtr, std::placeholders::_1));
+    connectRuleActions(connection);
+    appendConnection(connection);
   }
 
-  rebuildConnectionList();
+  createLiveAlignment();
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -78,13 +94,111 @@ QMenu *MainWindow::getConnectionsMenu()
 }
 //----------------------------------------------------------------------------------------------------------------------
 
+RuleActionDispatcher *MainWindow::getRuleActions()
+{
+  return m_RuleActions;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void MainWindow::createWatchdogOverlay()
+{
+  m_WatchdogOverlay = new QLabel(this);
+  ui->statusbar->addPermanentWidget(m_WatchdogOverlay);
+
+  connect(m_Watchdog, &EventLoopWatchdog::stallDetected,
+          this, [this](const qint64 &timestamp, const qint64 &duration, const QString &handler)
+  {
+    const QString time = QDateTime::fromMSecsSinceEpoch(timestamp).toString("hh:mm:ss");
+    m_LastStall = tr("last stall %1 ms in %2 at %3").arg(duration).arg(handler).arg(time);
+  });
+
+  TickScheduler::Instance()->subscribe(m_WatchdogOverlay, cWatchdogOverlayInterval, [this](const qint64 &)
+  {
+    //the maximum is taken even while hidden, so the overlay never shows a latency from before
+    const qint64 latency = m_Watchdog->takeMaximumLatency();
+    if(false == m_WatchdogOverlay->isVisible()) return;
+
+    QString text = tr("Event loop latency %1 ms").arg(latency);
+    if(false == m_LastStall.isEmpty()) text += QString(", ") + m_LastStall;
+
+    m_WatchdogOverlay->setText(text);
+  });
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void MainWindow::createLiveAlignment()
+{
+  const auto configuration = LiveAlignmentConfiguration::Load(m_Settings);
+  if(false == configuration.isValid()) return;
+
+  QList<QPair<ConnectionPtr, QString>> series;
+
+  for(const auto &name : configuration.series)
+  {
+    const int separator = name.indexOf(QChar('/'));
+
+    ConnectionPtr connection;
+    for(const auto &candidate : m_Connections->getConnections())
+    {
+      if((0 < separator) && (candidate->getName() == name.left(separator))) connection = candidate;
+    }
+
+    //an unknown series keeps its column, it is empty in every row
+    if(nullptr == connection) qWarning() << "MainWindow::createLiveAlignment() unknown series" << name;
+
+    series.append(qMakePair(connection, name.mid(separator + 1)));
+  }
+
+  const QString filePath = GetLogDirectory().absoluteFilePath(QString("aligned.csv"));
+
+  if(false == QFileInfo::exists(filePath))
+  {
+    QtCSV::StringData data;
+    data.addRow(QStringList() << QString("timestamp") << configuration.series);
+
+    QtCSV::Writer::write(filePath, data);
+  }
+
+  m_LiveAlignment = new LiveSeriesAligner(series, configuration.step, configuration.method, this);
+
+  connect(m_LiveAlignment, &LiveSeriesAligner::rowAligned,
+          this, [filePath](const qint64 &timestamp, const QVector<double> &values)
+  {
+    QStringList row;
+    row << QString::number(timestamp);
+
+    for(const auto &value : values)
+    {
+      row << ((true == qIsNaN(value)) ? QString() : QString::number(value, 'g', 15));
+    }
+
+    QtCSV::StringData data;
+    data.addRow(row);
+
+    QtCSV::Writer::write(filePath, data, QString(","), QString("\""), QtCSV::Writer::WriteMode::APPEND);
+  });
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void MainWindow::connectRuleActions(const ConnectionPtr &connection)
+{
+  if(nullptr == connection) return;
+
+  const auto connectionRaw = connection.get();
+
+  connect(connectionRaw, &Connection::ruleTriggered,
+          m_RuleActions, [this, connectionRaw](const RuleDefinition &rule, const qint64 &timestamp, const double &value)
+  {
+    m_RuleActions->onRuleTriggered(connectionRaw->getName(), rule, timestamp, value);
+  });
+}
+//----------------------------------------------------------------------------------------------------------------------
+
 void MainWindow::onAddConnection(const ConnectionData &data)
 {
   const auto connection = std::make_shared<Connection>(data);
-  const ConnectionWeakPtr connectionWeakPtr = connection;
 
-  connect(connection.get(), &Connection::connectionChanged,
-          this, [this, connectionWeakPtr](bool changed){ this->onChangedConnectionState(connectionWeakPtr, changed); });
+  connectRuleActions(connection);
 
   ConnectionSerializer s(connection);
 
@@ -92,66 +206,75 @@ void MainWindow::onAddConnection(const ConnectionData &data)
 
   if(true == saved)
   {
-    m_Connections.append(connection);
+    appendConnection(connection);
   }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void MainWindow::appendConnection(const ConnectionPtr &connection)
+{
+  if((nullptr == connection) || (true == m_ConnectionStorages.contains(connection))) return;
 
-  rebuildConnectionList();
+  //the page is only created when it is selected, the values are stored regardless
+  m_ConnectionStorages[connection] = new ConnectionStorage(connection, this);
+  m_Connections->addConnection(connection);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
-void MainWindow::onChangedConnectionState(const ConnectionWeakPtr &connection, const bool &connected)
+QWidget *MainWindow::getConnectionWindow(const ConnectionPtr &connection)
 {
-  const auto connectionPtr = connection.lock();
-  if(nullptr == connectionPtr) return;
+  QWidget* window = m_ConnectionWindows.value(connection, nullptr);
+  if(nullptr != window) return window;
+
+  ConnectionStorage* storage = m_ConnectionStorages.value(connection, nullptr);
+  if(nullptr == storage) return nullptr;
+
+  window = new ConnectionWindow(connection, storage, ui->stackedWidget);
+  ui->stackedWidget->addWidget(window);
 
-  const auto item = m_ConnectionMapping.value(connectionPtr).first;
-  if(nullptr == item) return;
+  m_ConnectionWindows[connection] = window;
 
-  item->setIcon(connected ? QIcon(":/connect.png") : QIcon(":/disconnect.png"));
+  return window;
 }
 //----------------------------------------------------------------------------------------------------------------------
 
-void MainWindow::rebuildConnectionList()
+void MainWindow::removeConnection(const ConnectionPtr &connection)
 {
-  //we only need to clear the widgets, the items belong to the list widget and will get deleted automatically by clear()
-  for(const auto &value : m_ConnectionMapping.values())
-  {
-    value.second->deleteLater();
-  }
-  m_ConnectionMapping.clear();
+  if(nullptr == connection) return;
 
-  ui->listWidget->clear();
-  ui->stackedWidget->setCurrentWidget(ui->pageNoConnection);
+  //removing the row moves the current index, so its page is shown before this one is deleted
+  m_Connections->removeConnection(connection);
 
-  for(const auto &connection : m_Connections)
+  QWidget* window = m_ConnectionWindows.take(connection);
+  if(nullptr != window)
   {
-    QListWidgetItem* item = new QListWidgetItem(QIcon(":/disconnect.png"), connection->getName());
-    ConnectionWindow* window = new ConnectionWindow(connection, ui->stackedWidget);
+    if(window == ui->stackedWidget->currentWidget()) ui->stackedWidget->setCurrentWidget(ui->pageNoConnection);
 
-    ui->listWidget->addItem(item);
+    ui->stackedWidget->removeWidget(window);
+    window->deleteLater();
+  }
 
-    ui->stackedWidget->addWidget(window);
+  //deleted after the window, which may still load from its sink
+  ConnectionStorage* storage = m_ConnectionStorages.take(connection);
+  if(nullptr != storage) storage->deleteLater();
 
-    m_ConnectionMapping[connection] = {item, window};
-  }
+  m_Settings.beginGroup("connections");
+  m_Settings.remove(connection->getName());
+  m_Settings.endGroup();
 }
 //----------------------------------------------------------------------------------------------------------------------
 
-void MainWindow::on_listWidget_itemClicked(QListWidgetItem *item)
+void MainWindow::onCurrentConnectionChanged(const QModelIndex &current)
 {
-  //reset in case the item is not found
-  ui->stackedWidget->setCurrentWidget(ui->pageNoConnection);
+  QWidget* window = getConnectionWindow(m_Connections->getConnection(current));
 
-  for(const auto &value : m_ConnectionMapping.values())
-  {
-    if(item == value.first) ui->stackedWidget->setCurrentWidget(value.second);
-  }
+  ui->stackedWidget->setCurrentWidget((nullptr != window) ? window : ui->pageNoConnection);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
-void MainWindow::on_listWidget_itemSelectionChanged()
+void MainWindow::onConnectionSelectionChanged()
 {
-  ui->btnRemoveConnection->setEnabled(!ui->listWidget->selectedItems().isEmpty());
+  ui->btnRemoveConnection->setEnabled(ui->listConnections->selectionModel()->hasSelection());
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -175,12 +298,10 @@ void MainWindow::on_btnRemoveConnection_clicked()
 {
   qDebug() << "MainWindow::on_btnRemoveConnection_clicked()";
 
-  if(true == ui->listWidget->selectedItems().isEmpty()) return;
-
-  const auto item = ui->listWidget->selectedItems().first();
-  if(nullptr == item) return;
+  const auto selected = ui->listConnections->selectionModel()->selectedIndexes();
+  if(true == selected.isEmpty()) return;
 
-  const auto connection = GetConnectionForListWidgetItem(item, m_ConnectionMapping);
+  const auto connection = m_Connections->getConnection(selected.first());
   if(nullptr == connection) return;
 
   QMessageBox msgBox;
@@ -193,16 +314,7 @@ void MainWindow::on_btnRemoveConnection_clicked()
 
   if(QMessageBox::Yes == ret)
   {
-    const auto pair = m_ConnectionMapping.value(connection);
-    m_ConnectionMapping.remove(connection);
-    m_Connections.removeAll(connection);
-
-    m_Settings.beginGroup("connections");
-    m_Settings.remove(connection->getName());
-    m_Settings.endGroup();
-
-    delete pair.first;
-    pair.second->deleteLater();
+    removeConnection(connection);
   }
 }
 //----------------------------------------------------------------------------------------------------------------------
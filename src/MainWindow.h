@@ -1,18 +1,24 @@
 #pragma once
 
 #include <QMap>
-#include <QPair>
+#include <QLabel>
 #include <QWidget>
 #include <QPointer>
 #include <QSettings>
 #include <QMainWindow>
-#include <QListWidgetItem>
+#include <QModelIndex>
 
 #include "Connection.h"
+#include "RuleActionDispatcher.h"
 
 namespace Ssmr
 {
 
+class EventLoopWatchdog;
+class LiveSeriesAligner;
+class ConnectionStorage;
+class ConnectionListModel;
+
 namespace Ui
 {
 class MainWindow;
@@ -41,6 +47,12 @@ public:
 	 */
 	QMenu* getConnectionsMenu();
 
+	/**
+	 * @brief getRuleActions
+	 * @return Executes the actions of the rules triggered by all connections
+	 */
+	RuleActionDispatcher* getRuleActions();
+
 signals:
 
 	/**
@@ -58,17 +70,10 @@ private slots:
 	void onAddConnection(const ConnectionData &data);
 
 	/**
-	 * @brief onChangedConnectionState Called when a single connection has changed its connection state
-	 * @param connection
-	 * @param connected
-	 */
-	void onChangedConnectionState(const ConnectionWeakPtr &connection, const bool &connected);
-
-	/**
-	 * @brief on_listWidget_itemClicked Called when the user clicks a connection in the list
-	 * @param item
+	 * @brief onCurrentConnectionChanged Show the page of the connection the user selected in the list
+	 * @param current
 	 */
-	void on_listWidget_itemClicked(QListWidgetItem *item);
+	void onCurrentConnectionChanged(const QModelIndex &current);
 
 	/**
 	 * @brief on_btnAddConnection_clicked Handle logic to add a new connection
@@ -77,14 +82,45 @@ private slots:
 
 	void on_btnRemoveConnection_clicked();
 
-	void on_listWidget_itemSelectionChanged();
+	void onConnectionSelectionChanged();
 
 private:
 
 	/**
-	 * @brief rebuildConnectionList Update ui to show available connections
+	 * @brief appendConnection Add the row and the storage of a connection, the other ones are left untouched
+	 * @param connection
+	 */
+	void appendConnection(const ConnectionPtr &connection);
+
+	/**
+	 * @brief getConnectionWindow Get the page of a connection, it is created when it is first requested
+	 * @param connection
+	 * @return nullptr if the connection is unknown
+	 */
+	QWidget* getConnectionWindow(const ConnectionPtr &connection);
+
+	/**
+	 * @brief removeConnection Remove the row and the page of a connection and its persistent settings
+	 * @param connection
+	 */
+	void removeConnection(const ConnectionPtr &connection);
+
+	/**
+	 * @brief createWatchdogOverlay Show the event loop latency and the last stall in the status bar
+	 */
+	void createWatchdogOverlay();
+
+	/**
+	 * @brief createLiveAlignment Align the configured series of the established connections and log the rows to
+	 * "aligned.csv", the series are resolved once at start
 	 */
-	void rebuildConnectionList();
+	void createLiveAlignment();
+
+	/**
+	 * @brief connectRuleActions Execute the actions of the rules triggered by the given connection
+	 * @param connection
+	 */
+	void connectRuleActions(const ConnectionPtr &connection);
 
 	Ui::MainWindow *ui;
 
@@ -94,14 +130,44 @@ private:
 	QSettings m_Settings;
 
 	/**
-	 * @brief m_Connections The already established connections
+	 * @brief m_Connections The already established connections as list rows
+	 */
+	ConnectionListModel* m_Connections;
+
+	/**
+	 * @brief m_ConnectionStorages Stores the values of each connection, also of the ones whose page was never shown
+	 */
+	QMap<ConnectionPtr, ConnectionStorage*> m_ConnectionStorages;
+
+	/**
+	 * @brief m_ConnectionWindows Contains the stacked widget which belongs to which connection, once it was selected
+	 */
+	QMap<ConnectionPtr, QWidget*> m_ConnectionWindows;
+
+	/**
+	 * @brief m_RuleActions Executes the actions of the rules triggered by all connections
+	 */
+	RuleActionDispatcher* m_RuleActions;
+
+	/**
+	 * @brief m_Watchdog Measures the latency of the event loop and logs its stalls, nullptr if disabled
+	 */
+	EventLoopWatchdog* m_Watchdog;
+
+	/**
+	 * @brief m_WatchdogOverlay Shows the latency in the status bar, nullptr if the overlay is disabled
+	 */
+	QLabel* m_WatchdogOverlay;
+
+	/**
+	 * @brief m_LastStall The description of the last stall shown in the overlay
 	 */
-	QList<ConnectionPtr> m_Connections;
+	QString m_LastStall;
 
 	/**
-	 * @brief m_ConnectionMapping Contains the information which list item and stacked widget belongs to which connection
+	 * @brief m_LiveAlignment Aligns the configured series while they are received, nullptr if none are configured
 	 */
-	QMap<ConnectionPtr, QPair<QListWidgetItem*, QWidget*>> m_ConnectionMapping;
+	LiveSeriesAligner* m_LiveAlignment;
 
 };
 
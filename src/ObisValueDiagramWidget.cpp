@@ -2,41 +2,134 @@
 #include "ui_ObisValueDiagramWidget.h"
 
 #include <QChart>
+#include <QtMath>
 #include <QValueAxis>
 #include <QChartView>
 #include <QLineSeries>
+#include <QWheelEvent>
 #include <QDateTimeAxis>
 
+#include <limits>
+#include <algorithm>
 
-ObisValueDiagramWidget::ObisValueDiagramWidget(QWidget *parent) :
-  QWidget(parent),
-  ui(new Ui::ObisValueDiagramWidget)
+#include "Decimation.h"
+#include "TickScheduler.h"
+#include "EventLoopWatchdog.h"
+#include "IncrementalPlotWidget.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  //how often the collected values are pushed to the chart
+  const int cRefreshInterval = 500;
+
+  //how much a single step of the mouse wheel zooms or pans
+  const double cWheelZoomFactor = 1.25;
+  const double cWheelPanFraction = 0.1;
+
+  const qint64 cMillisecondsPerDay = 24 * 60 * 60 * 1000;
+
+  bool IsBefore(const QPointF &point, const double &x)
+  {
+    return point.x() < x;
+  }
+
+  bool IsAfter(const double &x, const QPointF &point)
+  {
+    return x < point.x();
+  }
+
+  /*
+   * Appends the decimated values of [begin, end) within [from, to] and updates their value range
+   */
+  void AppendVisible(const QPointF* begin,
+                     const QPointF* end,
+                     const double &from,
+                     const double &to,
+                     int width,
+                     double &min,
+                     double &max,
+                     QVector<QPointF> &points)
+  {
+    const QPointF* lower = std::lower_bound(begin, end, from, IsBefore);
+    const QPointF* upper = std::upper_bound(lower, end, to, IsAfter);
+
+    for(const QPointF* point = lower; point != upper; ++point)
+    {
+      min = qMin(min, point->y());
+      max = qMax(max, point->y());
+    }
+
+    //one more value on each side, so the lines reach the edges of the visible range
+    if(lower != begin) --lower;
+    if(upper != end) ++upper;
+
+    points += Decimation::LargestTriangleThreeBuckets(lower, static_cast<int>(upper - lower), width);
+  }
+}
+
+const qint64 ObisValueDiagramWidget::cHistoryMilliseconds = 7 * cMillisecondsPerDay;
+
+ObisValueDiagramWidget::ObisValueDiagramWidget(const ConnectionPtr &connection, QWidget *parent)
+  : QWidget(parent)
+  , ui(new Ui::ObisValueDiagramWidget)
+  , m_Connection(connection)
+  , m_Chart(new QtCharts::QChart())
+  , m_ChartView(nullptr)
+  , m_Plot(new IncrementalPlotWidget(this))
+  , m_AxisX(new QtCharts::QDateTimeAxis())
+  , m_AxisY(new QtCharts::QValueAxis())
+  , m_Traces()
+  , m_Changed(false)
+  , m_Updating(false)
+  , m_ReloadHistory(false)
+  , m_Loading()
+  , m_Loader()
+  , m_Refresh(-1)
 {
   ui->setupUi(this);
 
-  QtCharts::QLineSeries *series = new QtCharts::QLineSeries();
+  m_Chart->legend()->setAlignment(Qt::AlignBottom);
 
-  QtCharts::QChart *chart = new QtCharts::QChart();
-  chart->addSeries(series);
-  chart->legend()->hide();
+  m_AxisX->setTickCount(7);
+  m_Chart->addAxis(m_AxisX, Qt::AlignBottom);
 
-  QtCharts::QDateTimeAxis *axisX = new QtCharts::QDateTimeAxis;
-  axisX->setTickCount(10);
-  axisX->setFormat("dd.MM");
-  axisX->setTitleText("Date");
-  chart->addAxis(axisX, Qt::AlignBottom);
-  series->attachAxis(axisX);
+  m_AxisY->setLabelFormat("%g");
+  m_Chart->addAxis(m_AxisY, Qt::AlignLeft);
 
-  QtCharts::QValueAxis *axisY = new QtCharts::QValueAxis;
-  axisY->setLabelFormat("%f");
-  axisY->setTitleText("Power");
-  chart->addAxis(axisY, Qt::AlignLeft);
-  series->attachAxis(axisY);
+  m_ChartView = new QtCharts::QChartView(m_Chart, this);
+  m_ChartView->setRenderHint(QPainter::Antialiasing);
+  m_ChartView->setRubberBand(QtCharts::QChartView::HorizontalRubberBand);
+  m_ChartView->viewport()->installEventFilter(this);
 
-  QtCharts::QChartView *chartView = new QtCharts::QChartView(chart);
-  chartView->setRenderHint(QPainter::Antialiasing);
+  m_Plot->setMaximumSpan(cHistoryMilliseconds);
+  m_Plot->setHistoryCallback([this](const QString &key) -> QPair<const QPointF*, const QPointF*>
+  {
+    const auto trace = m_Traces.constFind(key);
+    if(trace == m_Traces.cend()) return {nullptr, nullptr};
 
-  ui->gridLayoutContent->addWidget(chartView);
+    return {trace->points.constData() + trace->first, trace->points.constData() + trace->points.size()};
+  });
+
+  //the live values are plotted incrementally, the chart is only used to browse the history
+  ui->gridLayoutContent->addWidget(m_Plot, 1, 0);
+  ui->gridLayoutContent->addWidget(m_ChartView, 2, 0);
+  m_ChartView->setVisible(false == ui->chkFollow->isChecked());
+  m_Plot->setVisible(true == ui->chkFollow->isChecked());
+
+  for(const auto &mapping : m_Connection->getConnectionData().mappings)
+  {
+    addTrace(mapping);
+  }
+
+  connect(m_Connection.get(), &Connection::mappingAdded, this, &ObisValueDiagramWidget::onMappingAdded);
+  connect(m_Connection.get(), &Connection::mappingRemoved, this, &ObisValueDiagramWidget::onMappingRemoved);
+  connect(m_Connection.get(), &Connection::mappingChanged, this, &ObisValueDiagramWidget::onMappingChanged);
+  connect(m_AxisX, &QtCharts::QDateTimeAxis::rangeChanged, this, &ObisValueDiagramWidget::onRangeChanged);
+  connect(m_Chart, &QtCharts::QChart::plotAreaChanged, this, [this](const QRectF &) { scheduleRefresh(); });
+  connect(&m_Loader, &HistoryLoader::loaded, this, &ObisValueDiagramWidget::onHistoryLoaded);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -45,3 +138,335 @@ ObisValueDiagramWidget::~ObisValueDiagramWidget()
   delete ui;
 }
 //----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::setSink(const StorageSinkPtr &sink, const RollupConfiguration &rollups)
+{
+  m_Loader.setSink(sink, rollups);
+  m_ReloadHistory = (nullptr != sink);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::onDataValueReceived(const QString &obisValue,
+                                                 const qint64 &timestamp,
+                                                 const QVariant &dataValue)
+{
+  auto trace = m_Traces.find(obisValue);
+  if(trace == m_Traces.end()) return;
+
+  bool ok{};
+  const double value = dataValue.toDouble(&ok);
+  if((false == ok) || (true == qIsNaN(value))) return;
+
+  const double x = static_cast<double>(timestamp);
+
+  //the history has to stay sorted for the decimation
+  if((false == trace->points.isEmpty()) && (x < trace->points.last().x())) return;
+
+  trace->points.append(QPointF(x, value));
+  trim(*trace);
+
+  m_Changed = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::showEvent(QShowEvent *event)
+{
+  QWidget::showEvent(event);
+
+  TickScheduler::Instance()->unsubscribe(m_Refresh);
+  m_Refresh = TickScheduler::Instance()->subscribe(this, cRefreshInterval, [this](const qint64 &) { onRefresh(); });
+  onRefresh();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::hideEvent(QHideEvent *event)
+{
+  QWidget::hideEvent(event);
+  TickScheduler::Instance()->unsubscribe(m_Refresh);
+  m_Refresh = -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ObisValueDiagramWidget::eventFilter(QObject *watched, QEvent *event)
+{
+  if((watched != m_ChartView->viewport()) || (QEvent::Wheel != event->type()))
+  {
+    return QWidget::eventFilter(watched, event);
+  }
+
+  const auto wheel = static_cast<QWheelEvent*>(event);
+  const double steps = static_cast<double>(wheel->angleDelta().y()) / 120.0;
+
+  if(0.0 == steps) return false;
+
+  if(0 != (wheel->modifiers() & Qt::ControlModifier))
+  {
+    m_Chart->zoom(qPow(cWheelZoomFactor, steps));
+  }
+  else
+  {
+    //scrolling up goes back in time
+    m_Chart->scroll(-steps * cWheelPanFraction * m_Chart->plotArea().width(), 0.0);
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::onMappingAdded(const ObisValueMapping &mapping)
+{
+  addTrace(mapping);
+  scheduleRefresh();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::onMappingRemoved(const ObisValueMapping &mapping)
+{
+  auto trace = m_Traces.find(mapping.obisNumber);
+  if(trace == m_Traces.end()) return;
+
+  m_Chart->removeSeries(trace->series);
+  delete trace->series;
+
+  m_Traces.erase(trace);
+
+  m_Plot->removeSeries(mapping.obisNumber);
+  m_Plot->setUnit(getUnit());
+  scheduleRefresh();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::onMappingChanged(const ObisValueMapping &mapping)
+{
+  auto trace = m_Traces.find(mapping.obisNumber);
+  if(trace == m_Traces.end()) return;
+
+  trace->unit = mapping.unit;
+  trace->series->setName((true == mapping.description.isEmpty()) ? mapping.obisNumber : mapping.description);
+
+  m_Plot->addSeries(mapping.obisNumber, trace->series->name());
+  m_Plot->setUnit(getUnit());
+  scheduleRefresh();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::onRangeChanged()
+{
+  if(true == m_Updating) return;
+
+  //the user zoomed or panned, keep the chosen range
+  ui->chkFollow->setChecked(false);
+  m_ReloadHistory = true;
+  scheduleRefresh();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::on_chkFollow_toggled(bool checked)
+{
+  m_Plot->setVisible(checked);
+  m_ChartView->setVisible(false == checked);
+
+  if(false == checked)
+  {
+    //browsing starts with the span which was plotted live
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    m_Updating = true;
+    m_AxisX->setRange(QDateTime::fromMSecsSinceEpoch(now - m_Plot->getSpan()), QDateTime::fromMSecsSinceEpoch(now));
+    m_Updating = false;
+
+    m_ReloadHistory = true;
+  }
+  else
+  {
+    m_Loader.cancel();
+    setLoading({});
+  }
+
+  scheduleRefresh();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::onRefresh()
+{
+  const WatchdogScope scope("ObisValueDiagramWidget::onRefresh()");
+
+  //the live plot draws itself
+  if((false == m_Changed) || (true == ui->chkFollow->isChecked())) return;
+  m_Changed = false;
+
+  const double from = static_cast<double>(m_AxisX->min().toMSecsSinceEpoch());
+  const double to = static_cast<double>(m_AxisX->max().toMSecsSinceEpoch());
+
+  //about one point per pixel, more would not be visible anyway
+  const int width = qMax(3, qRound(m_Chart->plotArea().width()));
+
+  //the history is loaded at most once per refresh, so zooming with the mouse wheel does not start a load per step
+  if(true == m_ReloadHistory) loadHistory(static_cast<qint64>(from), static_cast<qint64>(to), width);
+
+  double min = std::numeric_limits<double>::max();
+  double max = std::numeric_limits<double>::lowest();
+
+  for(auto &trace : m_Traces)
+  {
+    QVector<QPointF> points;
+
+    //the loaded history ends where the received values start
+    AppendVisible(trace.stored.constData(), trace.stored.constData() + trace.stored.size(),
+                  from, to, width, min, max, points);
+    AppendVisible(trace.points.constData() + trace.first, trace.points.constData() + trace.points.size(),
+                  from, to, width, min, max, points);
+
+    trace.series->replace(points);
+  }
+
+  updateAxes(static_cast<qint64>(from), static_cast<qint64>(to), min, max);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::onHistoryLoaded(const QString &obisNumber, const QVector<QPointF> &points, bool final)
+{
+  const WatchdogScope scope("ObisValueDiagramWidget::onHistoryLoaded()");
+
+  if(true == final)
+  {
+    auto loading = m_Loading;
+    loading.remove(obisNumber);
+    setLoading(loading);
+  }
+
+  auto trace = m_Traces.find(obisNumber);
+  if(trace == m_Traces.end()) return;
+
+  trace->stored = points;
+
+  //the received values are more recent and more detailed than the stored ones
+  if(trace->first < trace->points.size())
+  {
+    const double received = trace->points.at(trace->first).x();
+    trace->stored.erase(std::lower_bound(trace->stored.begin(), trace->stored.end(), received, IsBefore),
+                        trace->stored.end());
+  }
+
+  scheduleRefresh();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::addTrace(const ObisValueMapping &mapping)
+{
+  if((false == mapping.isValid()) || (true == m_Traces.contains(mapping.obisNumber))) return;
+
+  auto series = new QtCharts::QLineSeries();
+  series->setName((true == mapping.description.isEmpty()) ? mapping.obisNumber : mapping.description);
+
+  m_Chart->addSeries(series);
+  series->attachAxis(m_AxisX);
+  series->attachAxis(m_AxisY);
+
+  m_Traces.insert(mapping.obisNumber, Trace{series, mapping.unit, {}, 0, {}});
+
+  m_Plot->addSeries(mapping.obisNumber, series->name());
+  m_Plot->setUnit(getUnit());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::trim(Trace &trace) const
+{
+  const double oldest = trace.points.last().x() - static_cast<double>(cHistoryMilliseconds);
+
+  const QPointF* begin = trace.points.constData() + trace.first;
+  const QPointF* end = trace.points.constData() + trace.points.size();
+
+  trace.first += static_cast<int>(std::lower_bound(begin, end, oldest, IsBefore) - begin);
+
+  //the dropped values are only removed once they are the larger part, so appending stays amortized constant
+  if(trace.first > trace.points.size() / 2)
+  {
+    trace.points.remove(0, trace.first);
+    trace.first = 0;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::loadHistory(const qint64 &from, const qint64 &to, int width)
+{
+  m_ReloadHistory = false;
+
+  //only the time before the received values has to be read from the storage
+  qint64 received = -1;
+
+  for(const auto &trace : m_Traces)
+  {
+    if(trace.first >= trace.points.size()) continue;
+
+    received = qMax(received, static_cast<qint64>(trace.points.at(trace.first).x()));
+  }
+
+  const qint64 until = (0 <= received) ? qMin(to, received - 1) : to;
+  const auto obisNumbers = m_Traces.keys();
+
+  if((from <= until) && (true == m_Loader.load(obisNumbers, from, until, width)))
+  {
+    setLoading(QSet<QString>(obisNumbers.cbegin(), obisNumbers.cend()));
+  }
+  else
+  {
+    m_Loader.cancel();
+    setLoading({});
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::setLoading(const QSet<QString> &loading)
+{
+  m_Loading = loading;
+
+  if(true == m_Loading.isEmpty())
+  {
+    m_ChartView->unsetCursor();
+  }
+  else
+  {
+    m_ChartView->setCursor(Qt::BusyCursor);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::scheduleRefresh()
+{
+  m_Changed = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueDiagramWidget::updateAxes(qint64 from, qint64 to, double min, double max)
+{
+  m_Updating = true;
+
+  const qint64 span = to - from;
+  m_AxisX->setFormat((span <= cMillisecondsPerDay) ? QString("hh:mm:ss")
+                                                   : ((span <= 7 * cMillisecondsPerDay) ? QString("dd.MM hh:mm")
+                                                                                        : QString("dd.MM.yyyy")));
+
+  if(min <= max)
+  {
+    const double margin = (min < max) ? (max - min) * 0.05 : qMax(1.0, qAbs(min) * 0.05);
+    m_AxisY->setRange(min - margin, max + margin);
+  }
+
+  m_AxisY->setTitleText(getUnit());
+
+  m_Updating = false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString ObisValueDiagramWidget::getUnit() const
+{
+  //the unit is only shown if all series share it
+  QSet<QString> units;
+  for(const auto &trace : m_Traces) units.insert(trace.unit);
+
+  return (1 == units.size()) ? *units.cbegin() : QString();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -1,22 +1,266 @@
-#ifndef OBISVALUEDIAGRAMWIDGET_H
-#define OBISVALUEDIAGRAMWIDGET_H
+#pragma once
 
+#include <QSet>
+#include <QMap>
 #include <QWidget>
+#include <QVector>
+#include <QPointF>
 
-namespace Ui {
+#include "Connection.h"
+#include "HistoryLoader.h"
+
+namespace QtCharts
+{
+class QChart;
+class QChartView;
+class QLineSeries;
+class QValueAxis;
+class QDateTimeAxis;
+}
+
+namespace Ssmr
+{
+
+class IncrementalPlotWidget;
+
+namespace Ui
+{
 class ObisValueDiagramWidget;
 }
 
+/**
+ * @brief The ObisValueDiagramWidget class shows the received values of all mappings of a connection as a live chart
+ *
+ * The received values are kept for a week. While following the latest values they are drawn by an incremental plot
+ * which only draws the new values on each tick. To browse the history a chart is shown instead, only its visible
+ * range is drawn, decimated to about one point per pixel and pushed to the chart in one batch per refresh. Zooming and
+ * panning decimate the history again, so the chart stays interactive with hundreds of thousands of values per series.
+ * The part of the range before the received values is loaded from the storage in the background, coarse first.
+ */
 class ObisValueDiagramWidget : public QWidget
 {
 	Q_OBJECT
 
 public:
-	explicit ObisValueDiagramWidget(QWidget *parent = nullptr);
-	~ObisValueDiagramWidget();
+
+	/**
+	 * @brief cHistoryMilliseconds How long the received values are kept
+	 */
+	static const qint64 cHistoryMilliseconds;
+
+	/**
+	 * @brief ObisValueDiagramWidget Constructor
+	 * @param connection
+	 * @param parent
+	 */
+	explicit ObisValueDiagramWidget(const ConnectionPtr &connection, QWidget *parent = nullptr);
+
+	/**
+	 * @brief ~ObisValueDiagramWidget Destructor
+	 */
+	virtual ~ObisValueDiagramWidget() override;
+
+	/**
+	 * @brief setSink Set where the history before the received values is loaded from
+	 * @param sink nullptr while there is none
+	 * @param rollups The rollup tiers written to the sink
+	 */
+	void setSink(const StorageSinkPtr &sink, const RollupConfiguration &rollups = RollupConfiguration::Default());
+
+public slots:
+
+	/**
+	 * @brief onDataValueReceived Add a received value, it is drawn with the next refresh
+	 * @param obisValue
+	 * @param timestamp
+	 * @param dataValue
+	 */
+	void onDataValueReceived(const QString &obisValue, const qint64 &timestamp, const QVariant &dataValue);
+
+protected:
+
+	/**
+	 * @brief showEvent Resume the refreshes of the chart and refresh it once
+	 * @param event
+	 */
+	virtual void showEvent(QShowEvent *event) override;
+
+	/**
+	 * @brief hideEvent Suspend the refreshes of the chart, the received values are still kept
+	 * @param event
+	 */
+	virtual void hideEvent(QHideEvent *event) override;
+
+	/**
+	 * @brief eventFilter Pan with the mouse wheel and zoom with control and the mouse wheel
+	 * @param watched
+	 * @param event
+	 * @return
+	 */
+	virtual bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+
+	/**
+	 * @brief onMappingAdded Add a series for the mapping
+	 * @param mapping
+	 */
+	void onMappingAdded(const ObisValueMapping &mapping);
+
+	/**
+	 * @brief onMappingRemoved Remove the series of the mapping
+	 * @param mapping
+	 */
+	void onMappingRemoved(const ObisValueMapping &mapping);
+
+	/**
+	 * @brief onMappingChanged Rename the series of the mapping and take over its unit
+	 * @param mapping
+	 */
+	void onMappingChanged(const ObisValueMapping &mapping);
+
+	/**
+	 * @brief onRangeChanged Stop following the latest values if the user zoomed or panned
+	 */
+	void onRangeChanged();
+
+	/**
+	 * @brief on_chkFollow_toggled Switch between the live plot and the chart to browse the history
+	 * @param checked
+	 */
+	void on_chkFollow_toggled(bool checked);
+
+	/**
+	 * @brief onHistoryLoaded Show the loaded history of a series, it replaces the previously loaded one
+	 * @param obisNumber
+	 * @param points
+	 * @param final True if no finer history follows for this request
+	 */
+	void onHistoryLoaded(const QString &obisNumber, const QVector<QPointF> &points, bool final);
+
+	/**
+	 * @brief onRefresh Push the decimated visible range of all series to the chart while browsing the history
+	 */
+	void onRefresh();
 
 private:
+
+	/**
+	 * @brief The Trace struct contains the series of a single mapping and its history
+	 */
+	struct Trace
+	{
+		QtCharts::QLineSeries* series;
+		QString unit;
+
+		//!Received values with x in milliseconds since epoch, ascending. Values before first are already dropped.
+		QVector<QPointF> points;
+		int first;
+
+		//!The history loaded for the browsed range, it ends before the received values
+		QVector<QPointF> stored;
+	};
+
+	/**
+	 * @brief addTrace Add a series for the mapping
+	 * @param mapping
+	 */
+	void addTrace(const ObisValueMapping &mapping);
+
+	/**
+	 * @brief trim Drop the values which are older than the history
+	 * @param trace
+	 */
+	void trim(Trace &trace) const;
+
+	/**
+	 * @brief loadHistory Load the history of the browsed range which is older than the received values
+	 * @param from
+	 * @param to
+	 * @param width
+	 */
+	void loadHistory(const qint64 &from, const qint64 &to, int width);
+
+	/**
+	 * @brief setLoading Set the series whose history is still loaded and show a busy cursor while there are any
+	 * @param loading
+	 */
+	void setLoading(const QSet<QString> &loading);
+
+	/**
+	 * @brief scheduleRefresh Redraw all series with the next refresh, e.g. after the range changed
+	 */
+	void scheduleRefresh();
+
+	/**
+	 * @brief getUnit
+	 * @return The unit of all series, empty if they differ
+	 */
+	QString getUnit() const;
+
+	/**
+	 * @brief updateAxes Set the range and format of the axes
+	 * @param from
+	 * @param to
+	 * @param min
+	 * @param max
+	 */
+	void updateAxes(qint64 from, qint64 to, double min, double max);
+
+	/**
+	 * @brief ui The user interface
+	 */
 	Ui::ObisValueDiagramWidget *ui;
+
+	/**
+	 * @brief m_Connection Which connection to represent
+	 */
+	ConnectionPtr m_Connection;
+
+	QtCharts::QChart* m_Chart;
+	QtCharts::QChartView* m_ChartView;
+	QtCharts::QDateTimeAxis* m_AxisX;
+	QtCharts::QValueAxis* m_AxisY;
+
+	/**
+	 * @brief m_Plot Plots the latest values while following them
+	 */
+	IncrementalPlotWidget* m_Plot;
+
+	/**
+	 * @brief m_Traces The series by obis number
+	 */
+	QMap<QString, Trace> m_Traces;
+
+	/**
+	 * @brief m_Changed True if values were added or the visible range changed since the last refresh
+	 */
+	bool m_Changed;
+
+	/**
+	 * @brief m_Updating True while the widget sets the range itself
+	 */
+	bool m_Updating;
+
+	/**
+	 * @brief m_ReloadHistory True if the history has to be loaded for the browsed range with the next refresh
+	 */
+	bool m_ReloadHistory;
+
+	/**
+	 * @brief m_Loading The series whose history is still loaded
+	 */
+	QSet<QString> m_Loading;
+
+	/**
+	 * @brief m_Loader Loads the history in the background
+	 */
+	HistoryLoader m_Loader;
+
+	/**
+	 * @brief m_Refresh The tick subscription pushing the changes to the chart while visible, -1 while hidden
+	 */
+	int m_Refresh;
 };
 
-#endif // OBISVALUEDIAGRAMWIDGET_H
+}
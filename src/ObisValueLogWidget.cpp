@@ -1,7 +1,10 @@
 #include "ObisValueLogWidget.h"
 #include "ui_ObisValueLogWidget.h"
 
-#include <QDateTime>
+#include <QDebug>
+#include <QHeaderView>
+
+#include "ObisValueTableModel.h"
 
 namespace Ssmr
 {
@@ -10,20 +13,21 @@ ObisValueLogWidget::ObisValueLogWidget(const ConnectionPtr &connection, QWidget
   : QWidget(parent)
   , ui(new Ui::ObisValueLogWidget)
   , m_Connection(connection)
+  , m_Model(new ObisValueTableModel(connection, this))
 {
   ui->setupUi(this);
 
-  connect(m_Connection.get(), &Connection::connectionChanged, this, &ObisValueLogWidget::onConnectionChanged);
-  connect(m_Connection.get(), &Connection::mappingAdded, this, &ObisValueLogWidget::onMappingAdded);
-  connect(m_Connection.get(), &Connection::mappingRemoved, this, &ObisValueLogWidget::onMappingRemoved);
+  //nothing is formatted until the widget is shown
+  m_Model->setSuspended(true);
+  ui->tableValues->setModel(m_Model);
+  ui->tableValues->horizontalHeader()->setSectionResizeMode(ObisValueTableModel::eDescription,
+                                                            QHeaderView::ResizeToContents);
 
-  for(const auto &mapping : m_Connection->getConnectionData().mappings)
-  {
-    const auto &widget = new ObisValueWidget(mapping, this);
-    m_ValueWidgets[mapping.obisNumber] = widget;
+  //the value changes often, a fixed width avoids a layout pass per repaint
+  ui->tableValues->setColumnWidth(ObisValueTableModel::eValue, 120);
+  ui->tableValues->setColumnWidth(ObisValueTableModel::eTimestamp, 180);
 
-    ui->verticalLayoutObisValueWidgets->addWidget(widget);
-  }
+  connect(m_Connection.get(), &Connection::connectionChanged, this, &ObisValueLogWidget::onConnectionChanged);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -33,6 +37,20 @@ ObisValueLogWidget::~ObisValueLogWidget()
 }
 //----------------------------------------------------------------------------------------------------------------------
 
+void ObisValueLogWidget::showEvent(QShowEvent *event)
+{
+  QWidget::showEvent(event);
+  m_Model->setSuspended(false);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueLogWidget::hideEvent(QHideEvent *event)
+{
+  QWidget::hideEvent(event);
+  m_Model->setSuspended(true);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
 bool ObisValueLogWidget::onDataValueReceived(const QString &obisValue,
                                              const qint64 &timestamp,
                                              const QVariant &dataValue,
@@ -40,9 +58,6 @@ bool ObisValueLogWidget::onDataValueReceived(const QString &obisValue,
 {
   Q_UNUSED(unit)
 
-  const auto &widget = m_ValueWidgets.value(obisValue);
-  if(nullptr == widget) return false;
-
   bool ok{};
   const double value = dataValue.toDouble(&ok);
 
@@ -53,42 +68,13 @@ bool ObisValueLogWidget::onDataValueReceived(const QString &obisValue,
     return false;
   }
 
-  return widget->onNewValue(timestamp, value);
+  return m_Model->addSample(obisValue, timestamp, value);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
 void ObisValueLogWidget::onConnectionChanged(const bool &)
 {
-  for(const auto &widget : m_ValueWidgets.values())
-  {
-    if(nullptr == widget) continue;
-
-    widget->invalidate();
-  }
-}
-//----------------------------------------------------------------------------------------------------------------------
-
-void ObisValueLogWidget::onMappingAdded(const ObisValueMapping &mapping)
-{
-  if(false == mapping.isValid()) return;
-
-  const auto &widget = new ObisValueWidget(mapping, this);
-  m_ValueWidgets[mapping.obisNumber] = widget;
-
-  ui->verticalLayoutObisValueWidgets->addWidget(widget);
-}
-//----------------------------------------------------------------------------------------------------------------------
-
-void ObisValueLogWidget::onMappingRemoved(const ObisValueMapping &mapping)
-{
-  auto widget = m_ValueWidgets.value(mapping.obisNumber);
-  if(nullptr!= widget)
-  {
-    widget->close();
-    widget->deleteLater();
-  }
-
-  m_ValueWidgets.remove(mapping.obisNumber);
+  m_Model->invalidate();
 }
 //----------------------------------------------------------------------------------------------------------------------
 
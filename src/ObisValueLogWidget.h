@@ -1,10 +1,8 @@
 #pragma once
 
 #include <QWidget>
-#include <QTimer>
 
 #include "Connection.h"
-#include "ObisValueWidget.h"
 
 namespace Ssmr
 {
@@ -14,6 +12,8 @@ namespace Ui
 class ObisValueLogWidget;
 }
 
+class ObisValueTableModel;
+
 /**
  * @brief The ObisValueLogWidget class provides the ui to log received values
  */
@@ -34,10 +34,24 @@ public:
 	 */
 	virtual ~ObisValueLogWidget() override;
 
+protected:
+
+	/**
+	 * @brief showEvent Resume the repaints of the table
+	 * @param event
+	 */
+	virtual void showEvent(QShowEvent *event) override;
+
+	/**
+	 * @brief hideEvent Suspend the repaints of the table, the latest values are still kept
+	 * @param event
+	 */
+	virtual void hideEvent(QHideEvent *event) override;
+
 public slots:
 
 	/**
-	 * @brief onDataValueReceived Add a new line to the list of received values
+	 * @brief onDataValueReceived Show a new value in the row of its obis number with the next repaint
 	 * @param obisValue
 	 * @param timestamp
 	 * @param dataValue
@@ -51,23 +65,11 @@ public slots:
 private slots:
 
 	/**
-	 * @brief onConnectionChanged The connection status has changed. This will invalidate all log widgets
+	 * @brief onConnectionChanged The connection status has changed. This will invalidate all rows
 	 * @param connected
 	 */
 	void onConnectionChanged(const bool &connected);
 
-	/**
-	 * @brief onMappingAdded A new mapping added for this connection
-	 * @param mapping
-	 */
-	void onMappingAdded(const ObisValueMapping &mapping);
-
-	/**
-	 * @brief onMappingRemoved A mapping has been removed for this connection
-	 * @param mapping
-	 */
-	void onMappingRemoved(const ObisValueMapping &mapping);
-
 private:
 
 	/**
@@ -81,9 +83,9 @@ private:
 	ConnectionPtr m_Connection;
 
 	/**
-	 * @brief m_ValueWidgets Where to log each number
+	 * @brief m_Model The latest value of each mapping
 	 */
-	QMap<QString, ObisValueWidget*> m_ValueWidgets;
+	ObisValueTableModel* m_Model;
 };
 
 }
@@ -1,22 +1,42 @@
 #include "ObisValueMappingWidget.h"
 #include "ui_ObisValueMappingWidget.h"
 
+#include "HelpFunctions.h"
+#include "ChannelExpression.h"
+
 namespace Ssmr
 {
 
-ObisValueMappingWidget::ObisValueMappingWidget(const QString &obisValue,
-                                               const QString &description,
-                                               const QString &unit,
-                                               const Duration &interval,
-                                               QWidget *parent)
+ObisValueMappingWidget::ObisValueMappingWidget(const ObisValueMapping &mapping, QWidget *parent)
   : QWidget(parent)
   , ui(new Ui::ObisValueMappingWidget)
+  , m_ExpressionToolTip()
 {
   ui->setupUi(this);
-  ui->edtObisValue->setText(obisValue);
-  ui->edtDescription->setText(description);
-  ui->edtUnit->setText(unit);
-  ui->edtInterval->setText(QString("%1s").arg(interval.toSeconds()));
+  m_ExpressionToolTip = ui->edtExpression->toolTip();
+
+  ui->edtObisValue->setText(mapping.obisNumber);
+  ui->edtDescription->setText(mapping.description);
+  ui->edtUnit->setText(mapping.unit);
+  ui->edtInterval->setText(QString("%1s").arg(mapping.interval.toSeconds()));
+  ui->edtDeviation->setText(mapping.getDeviationString());
+  ui->edtMaxGap->setText(QString("%1s").arg(mapping.maxGap.toSeconds()));
+  ui->edtWindow->setText(QString("%1s").arg(mapping.window.toSeconds()));
+  ui->edtExpression->setText(mapping.expression);
+
+  const auto compressionMapping = GetCompressionMethodDescriptionsMapping();
+  for(const auto &compression : compressionMapping.keys())
+  {
+    const auto translator = compressionMapping.value(compression);
+    if(nullptr == translator) continue;
+
+    ui->comboBoxCompression->addItem(translator(), QVariant::fromValue(compression));
+  }
+
+  ui->comboBoxCompression->setCurrentIndex(ui->comboBoxCompression->findData(QVariant::fromValue(mapping.compression)));
+
+  connect(ui->edtExpression, &QLineEdit::textChanged, this, &ObisValueMappingWidget::onExpressionChanged);
+  onExpressionChanged(mapping.expression);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -28,10 +48,37 @@ ObisValueMappingWidget::~ObisValueMappingWidget()
 
 ObisValueMapping ObisValueMappingWidget::getMapping() const
 {
+  double deviation{};
+  bool relative{};
+
+  //an invalid deviation means no tolerance, only unchanged values are dropped then
+  if(false == ObisValueMapping::ParseDeviation(ui->edtDeviation->text(), deviation, relative))
+  {
+    deviation = 0.0;
+    relative = false;
+  }
+
   return {ui->edtObisValue->text(),
         ui->edtDescription->text(),
         ui->edtUnit->text(),
-        Duration::FromString(ui->edtInterval->text())};
+        Duration::FromString(ui->edtInterval->text()),
+        ui->comboBoxCompression->currentData().value<CompressionMethod>(),
+        deviation,
+        relative,
+        Duration::FromString(ui->edtMaxGap->text()),
+        Duration::FromString(ui->edtWindow->text()),
+        ui->edtExpression->text().trimmed()};
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueMappingWidget::onExpressionChanged(const QString &text)
+{
+  //an empty expression is a received value, everything else has to compile
+  const auto expression = ChannelExpression::Compile(text);
+  const bool valid = (true == text.trimmed().isEmpty()) || (true == expression.isValid());
+
+  ui->edtExpression->setStyleSheet((true == valid) ? QString() : QString("color: rgb(204, 0, 0);"));
+  ui->edtExpression->setToolTip((true == valid) ? m_ExpressionToolTip : expression.getError());
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -14,7 +14,7 @@ class ObisValueMappingWidget;
 
 /**
  * @brief The ObisValueMappingWidget class represents a single mapping from an OBIS number to a text description and
- * a unit string
+ * a unit string together with the interval and compression settings, or the expression of a virtual channel
  */
 class ObisValueMappingWidget : public QWidget
 {
@@ -25,13 +25,10 @@ public:
 
 	/**
 	 * @brief ObisValueMappingWidget Default constructor
+	 * @param mapping The mapping to edit
 	 * @param parent
 	 */
-	explicit ObisValueMappingWidget(const QString &obisValue = {},
-																	const QString &description = {},
-																	const QString &unit = {},
-																	const Duration &interval = {},
-																	QWidget *parent = nullptr);
+	explicit ObisValueMappingWidget(const ObisValueMapping &mapping = {}, QWidget *parent = nullptr);
 
 	/**
 	 * @brief ~ObisValueMappingWidget Default destructor
@@ -44,12 +41,25 @@ public:
 	 */
 	ObisValueMapping getMapping() const;
 
+private slots:
+
+	/**
+	 * @brief onExpressionChanged Mark the expression if it cannot be compiled and show why in its tool tip
+	 * @param text
+	 */
+	void onExpressionChanged(const QString &text);
+
 private:
 
 	/**
 	 * @brief ui The user interface instance for this widget
 	 */
 	Ui::ObisValueMappingWidget *ui;
+
+	/**
+	 * @brief m_ExpressionToolTip The tool tip of the valid expression
+	 */
+	QString m_ExpressionToolTip;
 };
 
 }
@@ -0,0 +1,338 @@
+#include "ObisValueTableModel.h"
+
+#include <QFont>
+#include <QtMath>
+#include <QDateTime>
+
+#include <limits>
+
+#include "TickScheduler.h"
+#include "EventLoopWatchdog.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  //the SI prefixes from 10^-12 to 10^12 in steps of 10^3
+  const char* const cSiPrefixes[] = {"p", "n", "µ", "m", "", "k", "M", "G", "T"};
+  const int cSiPrefixCount = static_cast<int>(sizeof(cSiPrefixes) / sizeof(cSiPrefixes[0]));
+  const int cSiPrefixNone = 4;
+
+  /*
+   * Splits the unit into its SI prefix and the base unit, e.g. "kWh" into the index of "k" and "Wh"
+   */
+  int SplitSiPrefix(const QString &unit, QString &baseUnit)
+  {
+    baseUnit = unit;
+
+    //a unit like "m³" is not a prefixed unit
+    if((2 > unit.size()) || (false == unit.at(1).isLetter())) return cSiPrefixNone;
+
+    const QString prefix = unit.left(1);
+
+    for(int i = 0; i < cSiPrefixCount; ++i)
+    {
+      if((cSiPrefixNone == i) || (prefix != QString::fromUtf8(cSiPrefixes[i]))) continue;
+
+      baseUnit = unit.mid(1);
+      return i;
+    }
+
+    return cSiPrefixNone;
+  }
+}
+
+const int ObisValueTableModel::cFlushInterval = 100;
+
+QString ObisValueTableModel::FormatValue(const double &value, const QString &unit)
+{
+  if(true == unit.isEmpty()) return QString::number(value, 'f', 1);
+
+  QString baseUnit;
+  int prefix = SplitSiPrefix(unit, baseUnit);
+
+  double scaled = value;
+
+  if(0.0 != value)
+  {
+    while((1000.0 < qAbs(scaled)) && (prefix + 1 < cSiPrefixCount))
+    {
+      scaled /= 1000.0;
+      ++prefix;
+    }
+
+    while((1.0 > qAbs(scaled)) && (0 < prefix))
+    {
+      scaled *= 1000.0;
+      --prefix;
+    }
+  }
+
+  return QString("%1 %2%3").arg(QString::number(scaled, 'f', 1))
+                           .arg(QString::fromUtf8(cSiPrefixes[prefix]))
+                           .arg(baseUnit);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ObisValueTableModel::ObisValueTableModel(const ConnectionPtr &connection, QObject *parent)
+  : QAbstractTableModel(parent)
+  , m_Connection(connection)
+  , m_Rows()
+  , m_RowIndex()
+  , m_FirstChanged(std::numeric_limits<int>::max())
+  , m_LastChanged(-1)
+  , m_Suspended(false)
+  , m_FlushTick(-1)
+{
+  for(const auto &mapping : m_Connection->getConnectionData().mappings)
+  {
+    onMappingAdded(mapping);
+  }
+
+  connect(m_Connection.get(), &Connection::mappingAdded, this, &ObisValueTableModel::onMappingAdded);
+  connect(m_Connection.get(), &Connection::mappingRemoved, this, &ObisValueTableModel::onMappingRemoved);
+  connect(m_Connection.get(), &Connection::mappingChanged, this, &ObisValueTableModel::onMappingChanged);
+
+  m_FlushTick = TickScheduler::Instance()->subscribe(this, cFlushInterval, [this](const qint64 &) { flush(); });
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int ObisValueTableModel::rowCount(const QModelIndex &parent) const
+{
+  return (true == parent.isValid()) ? 0 : m_Rows.size();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int ObisValueTableModel::columnCount(const QModelIndex &parent) const
+{
+  return (true == parent.isValid()) ? 0 : eColumnCount;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QVariant ObisValueTableModel::data(const QModelIndex &index, int role) const
+{
+  if((false == index.isValid()) || (index.row() >= m_Rows.size())) return QVariant();
+
+  const auto &row = m_Rows.at(index.row());
+
+  //only the cached strings are returned, nothing is formatted while painting
+  if(Qt::DisplayRole == role)
+  {
+    switch(index.column())
+    {
+      case eDescription: return row.mapping.description;
+      case eValue: return row.valueText;
+      case eTimestamp: return row.timestampText;
+      case eStatistics: return row.statisticsText;
+      default: return QVariant();
+    }
+  }
+
+  if(Qt::ToolTipRole == role)
+  {
+    if(eDescription == index.column()) return row.mapping.obisNumber;
+    if(eStatistics == index.column()) return row.statisticsToolTip;
+  }
+
+  if((Qt::TextAlignmentRole == role) && (eValue == index.column()))
+  {
+    return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
+  }
+
+  if((Qt::FontRole == role) && ((eDescription == index.column()) || (eValue == index.column())))
+  {
+    QFont font;
+    font.setBold(true);
+    return font;
+  }
+
+  return QVariant();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QVariant ObisValueTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if((Qt::Horizontal != orientation) || (Qt::DisplayRole != role)) return QVariant();
+
+  switch(section)
+  {
+    case eDescription: return tr("Description");
+    case eValue: return tr("Value");
+    case eTimestamp: return tr("Timestamp");
+    case eStatistics: return tr("Statistics");
+    default: return QVariant();
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ObisValueTableModel::addSample(const QString &obisNumber, const qint64 &timestamp, const double &value)
+{
+  const int index = m_RowIndex.value(obisNumber, -1);
+  if(0 > index) return false;
+
+  auto &row = m_Rows[index];
+
+  const auto elapsed = (static_cast<quint64>(row.interval.elapsed()) > row.mapping.interval.toMilliseconds());
+  if((false == elapsed) && (true == row.interval.isValid())) return false;
+
+  row.interval.restart();
+  row.timestamp = timestamp;
+  row.value = value;
+  row.changed = true;
+
+  m_FirstChanged = qMin(m_FirstChanged, index);
+  m_LastChanged = qMax(m_LastChanged, index);
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueTableModel::invalidate()
+{
+  for(auto &row : m_Rows)
+  {
+    row.interval.invalidate();
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueTableModel::setSuspended(bool suspended)
+{
+  if(suspended == m_Suspended) return;
+  m_Suspended = suspended;
+
+  if(true == m_Suspended)
+  {
+    TickScheduler::Instance()->unsubscribe(m_FlushTick);
+    m_FlushTick = -1;
+  }
+  else
+  {
+    m_FlushTick = TickScheduler::Instance()->subscribe(this, cFlushInterval, [this](const qint64 &) { flush(); });
+    flush();
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueTableModel::flush()
+{
+  const WatchdogScope scope("ObisValueTableModel::flush()");
+
+  if((true == m_Suspended) || (m_FirstChanged > m_LastChanged)) return;
+
+  for(int i = m_FirstChanged; i <= m_LastChanged; ++i)
+  {
+    auto &row = m_Rows[i];
+    if(false == row.changed) continue;
+
+    format(row);
+    row.changed = false;
+  }
+
+  emit dataChanged(index(m_FirstChanged, eValue), index(m_LastChanged, eStatistics),
+                   {Qt::DisplayRole, Qt::ToolTipRole});
+
+  m_FirstChanged = std::numeric_limits<int>::max();
+  m_LastChanged = -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueTableModel::onMappingAdded(const ObisValueMapping &mapping)
+{
+  if((false == mapping.isValid()) || (true == m_RowIndex.contains(mapping.obisNumber))) return;
+
+  Row row{mapping, 0, 0.0, QElapsedTimer(), false, QString(), QString(), QString(), QString()};
+  row.interval.invalidate();
+
+  const int index = m_Rows.size();
+
+  beginInsertRows(QModelIndex(), index, index);
+  m_Rows.append(row);
+  m_RowIndex.insert(mapping.obisNumber, index);
+  endInsertRows();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueTableModel::onMappingRemoved(const ObisValueMapping &mapping)
+{
+  const int index = m_RowIndex.value(mapping.obisNumber, -1);
+  if(0 > index) return;
+
+  beginRemoveRows(QModelIndex(), index, index);
+  m_Rows.remove(index);
+  reindex();
+  endRemoveRows();
+
+  //the changed range may refer to moved rows, flushing a few unchanged ones is harmless
+  if(m_FirstChanged <= m_LastChanged)
+  {
+    m_FirstChanged = 0;
+    m_LastChanged = m_Rows.size() - 1;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueTableModel::onMappingChanged(const ObisValueMapping &mapping)
+{
+  const int index = m_RowIndex.value(mapping.obisNumber, -1);
+  if(0 > index) return;
+
+  auto &row = m_Rows[index];
+  row.mapping = mapping;
+
+  //a shown value is formatted again in the new unit with the next flush
+  if(false == row.valueText.isEmpty())
+  {
+    row.changed = true;
+
+    m_FirstChanged = qMin(m_FirstChanged, index);
+    m_LastChanged = qMax(m_LastChanged, index);
+  }
+
+  emit dataChanged(this->index(index, eDescription), this->index(index, eDescription), {Qt::DisplayRole});
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueTableModel::format(Row &row) const
+{
+  row.valueText = FormatValue(row.value, row.mapping.unit);
+  row.timestampText = QDateTime::fromMSecsSinceEpoch(row.timestamp).toString();
+
+  const StreamingStatistics* statistics = m_Connection->getStatistics(row.mapping.obisNumber);
+
+  if((nullptr == statistics) || (0 == statistics->getCount()))
+  {
+    row.statisticsText.clear();
+    row.statisticsToolTip.clear();
+    return;
+  }
+
+  const quint64 minutes = statistics->getWindow().toSeconds() / 60;
+  const QString window = (0 == minutes % 60) ? QString("%1h").arg(minutes / 60) : QString("%1m").arg(minutes);
+  const QString &unit = row.mapping.unit;
+
+  row.statisticsText = tr("%1: mean %2, min %3, max %4, p95 %5").arg(window)
+                                                                 .arg(FormatValue(statistics->getMean(), unit))
+                                                                 .arg(FormatValue(statistics->getMin(), unit))
+                                                                 .arg(FormatValue(statistics->getMax(), unit))
+                                                                 .arg(FormatValue(statistics->getQuantile(0.95), unit));
+  row.statisticsToolTip = tr("EWMA %1, standard deviation %2, %3 values")
+                          .arg(FormatValue(statistics->getEwma(), unit))
+                          .arg(FormatValue(statistics->getStandardDeviation(), unit))
+                          .arg(statistics->getCount());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void ObisValueTableModel::reindex()
+{
+  m_RowIndex.clear();
+
+  for(int i = 0; i < m_Rows.size(); ++i)
+  {
+    m_RowIndex.insert(m_Rows.at(i).mapping.obisNumber, i);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
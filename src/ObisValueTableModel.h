@@ -0,0 +1,177 @@
+#pragma once
+
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QAbstractTableModel>
+
+#include "Connection.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The ObisValueTableModel class provides the latest value of each mapping of a connection as a table row
+ *
+ * Received values are only stored with their row. The display strings are formatted once per flush for the rows which
+ * changed since the last one and a single dataChanged covering them is emitted, so hundreds of live values cost one
+ * repaint per flush instead of one per value.
+ */
+class ObisValueTableModel : public QAbstractTableModel
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief The Column enum lists the columns of the table
+	 */
+	enum Column
+	{
+		eDescription = 0,
+		eValue = 1,
+		eTimestamp = 2,
+		eStatistics = 3,
+		eColumnCount = 4,
+	};
+
+	/**
+	 * @brief cFlushInterval How often the changed rows are formatted and repainted in milliseconds
+	 */
+	static const int cFlushInterval;
+
+	/**
+	 * @brief FormatValue Scale a value to a fitting SI prefix of its unit
+	 * @param value
+	 * @param unit
+	 * @return The value with one decimal and the scaled unit, e.g. "1.5 kW" for 1500 W
+	 */
+	static QString FormatValue(const double &value, const QString &unit);
+
+	/**
+	 * @brief ObisValueTableModel Constructor
+	 * @param connection
+	 * @param parent
+	 */
+	explicit ObisValueTableModel(const ConnectionPtr &connection, QObject *parent = nullptr);
+
+	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+	virtual int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+	virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+	/**
+	 * @brief addSample Store a received value with its row, it is shown with the next flush
+	 * @param obisNumber
+	 * @param timestamp
+	 * @param value
+	 * @return False if the mapping is unknown or its interval did not pass since the last accepted value
+	 */
+	bool addSample(const QString &obisNumber, const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief invalidate Accept the next value of every mapping regardless of its interval
+	 */
+	void invalidate();
+
+	/**
+	 * @brief setSuspended Stop flushing while no view is visible, the values are still stored with their rows
+	 * @param suspended False flushes the rows changed in the meantime right away
+	 */
+	void setSuspended(bool suspended);
+
+public slots:
+
+	/**
+	 * @brief flush Format the changed rows and emit a single dataChanged for them
+	 */
+	void flush();
+
+private slots:
+
+	/**
+	 * @brief onMappingAdded Append a row for the mapping
+	 * @param mapping
+	 */
+	void onMappingAdded(const ObisValueMapping &mapping);
+
+	/**
+	 * @brief onMappingRemoved Remove the row of the mapping
+	 * @param mapping
+	 */
+	void onMappingRemoved(const ObisValueMapping &mapping);
+
+	/**
+	 * @brief onMappingChanged Show the row with the new description and unit, the new interval applies to the next value
+	 * @param mapping
+	 */
+	void onMappingChanged(const ObisValueMapping &mapping);
+
+private:
+
+	/**
+	 * @brief The Row struct contains the latest value of a single mapping and its display strings
+	 */
+	struct Row
+	{
+		ObisValueMapping mapping;
+
+		qint64 timestamp;
+		double value;
+
+		//!When the last value was accepted, to apply the interval of the mapping
+		QElapsedTimer interval;
+
+		//!True if a value was received since the strings were formatted
+		bool changed;
+
+		QString valueText;
+		QString timestampText;
+		QString statisticsText;
+		QString statisticsToolTip;
+	};
+
+	/**
+	 * @brief format Format the display strings of the given row
+	 * @param row
+	 */
+	void format(Row &row) const;
+
+	/**
+	 * @brief reindex Rebuild the row index after rows were removed
+	 */
+	void reindex();
+
+	/**
+	 * @brief m_Connection Which connection to represent
+	 */
+	ConnectionPtr m_Connection;
+
+	/**
+	 * @brief m_Rows The rows in the order the mappings were added
+	 */
+	QVector<Row> m_Rows;
+
+	/**
+	 * @brief m_RowIndex The row of each obis number
+	 */
+	QHash<QString, int> m_RowIndex;
+
+	/**
+	 * @brief m_FirstChanged The range of rows with changes since the last flush, empty if m_FirstChanged > m_LastChanged
+	 */
+	int m_FirstChanged;
+	int m_LastChanged;
+
+	/**
+	 * @brief m_Suspended True while no view is visible
+	 */
+	bool m_Suspended;
+
+	/**
+	 * @brief m_FlushTick The tick subscription triggering the flushes, -1 while suspended
+	 */
+	int m_FlushTick;
+};
+
+}
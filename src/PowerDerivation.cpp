@@ -0,0 +1,128 @@
+#include "PowerDerivation.h"
+
+#include <QtMath>
+#include <QRegularExpression>
+
+#include <cmath>
+
+namespace Ssmr
+{
+
+namespace
+{
+  const double cMillisecondsPerHour = 60.0 * 60.0 * 1000.0;
+
+  /*
+   * The counter display of a meter rolls over at the next power of ten above its value
+   */
+  double RolloverModulus(const double &value)
+  {
+    return qPow(10.0, qFloor(std::log10(qMax(1.0, value))) + 1);
+  }
+}
+
+PowerDerivationConfiguration PowerDerivationConfiguration::Load(QSettings &settings)
+{
+  PowerDerivationConfiguration configuration;
+
+  settings.beginGroup("power");
+
+  //the span is stored in seconds like the mapping intervals
+  if(true == settings.contains("span"))
+  {
+    configuration.span = Duration::FromString(QString("%1s").arg(settings.value("span").toULongLong()));
+  }
+
+  configuration.maxPower = settings.value("maxpower", configuration.maxPower).toDouble();
+
+  settings.endGroup();
+
+  return configuration;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+PowerDerivationConfiguration::PowerDerivationConfiguration()
+  : span(0, 0, 30)
+  , maxPower(100000.0)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString PowerDerivation::PowerObisNumber(const QString &counterObisNumber)
+{
+  static const QRegularExpression r("^(\\d+-\\d+:\\d+)\\.8\\.(\\d+\\*\\d+)$");
+
+  const auto match = r.match(counterObisNumber);
+  if(false == match.hasMatch()) return {};
+
+  return QString("%1.7.%2").arg(match.captured(1)).arg(match.captured(2));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+PowerDerivation::PowerDerivation(const PowerDerivationConfiguration &configuration)
+  : m_Configuration(configuration)
+  , m_Counters()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double PowerDerivation::addSample(const QString &counterObisNumber,
+                                  const MeterClock &clock,
+                                  const qint64 &time,
+                                  const double &value)
+{
+  if(true == qIsNaN(value)) return qQNaN();
+
+  const qint64 span = qMax<qint64>(1, static_cast<qint64>(m_Configuration.span.toMilliseconds()));
+
+  auto counter = m_Counters.find(counterObisNumber);
+
+  //a meter clock going backwards means the meter was restarted, the deltas are not related anymore
+  if((counter == m_Counters.end()) || (counter->clock != clock) || (true == counter->values.isEmpty()) ||
+     (time < counter->values.last().time))
+  {
+    m_Counters.insert(counterObisNumber, Counter{clock, value, {CounterValue{time, value}}});
+    return qQNaN();
+  }
+
+  //several frames within the same meter second carry no new information
+  const CounterValue last = counter->values.last();
+  if(time == last.time) return qQNaN();
+
+  double delta = value - counter->received;
+
+  if(0.0 > delta)
+  {
+    //a rollover is only plausible if it does not result in an impossible power, otherwise the counter was reset
+    const double rollover = RolloverModulus(counter->received) - counter->received + value;
+    const double power = rollover * cMillisecondsPerHour / static_cast<double>(time - last.time);
+
+    if(power > m_Configuration.maxPower)
+    {
+      m_Counters.insert(counterObisNumber, Counter{clock, value, {CounterValue{time, value}}});
+      return qQNaN();
+    }
+
+    delta = rollover;
+  }
+
+  counter->received = value;
+  counter->values.append(CounterValue{time, last.value + delta});
+
+  //the oldest value is kept as long as the span without it is still covered
+  while((2 < counter->values.size()) && (time - counter->values.at(1).time >= span)) counter->values.removeFirst();
+
+  const auto &first = counter->values.first();
+  if(time - first.time < span) return qQNaN();
+
+  return (counter->values.last().value - first.value) * cMillisecondsPerHour / static_cast<double>(time - first.time);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void PowerDerivation::reset()
+{
+  m_Counters.clear();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
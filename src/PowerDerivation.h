@@ -0,0 +1,121 @@
+#pragma once
+
+#include <QMap>
+#include <QList>
+#include <QString>
+#include <QSettings>
+
+#include "TypeDefinitions.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The MeterClock enum describes where the time of a received value comes from
+ */
+enum class MeterClock
+{
+	//!The time the frame was parsed, it contains the delays of the serial port and the event loop
+	eReceived = 0,
+
+	//!The seconds since the meter started, from the secIndex of the SML entry
+	eSecondIndex = 1,
+
+	//!The unix time of the meter in seconds, from the timestamp of the SML entry
+	eTimestamp = 2,
+};
+
+/**
+ * @brief The PowerDerivationConfiguration struct describes how the power is derived from the energy counters
+ */
+struct PowerDerivationConfiguration
+{
+	/**
+	 * @brief Load Read the configuration from the "power" group of the given settings
+	 * @param settings
+	 * @return The loaded configuration, the defaults are used for everything not configured
+	 */
+	static PowerDerivationConfiguration Load(QSettings &settings);
+
+	PowerDerivationConfiguration();
+
+	//!The power is averaged over at least this span, so the resolution of the counter does not dominate
+	Duration span;
+
+	//!A decreasing counter is taken as rollover only if the resulting power is not above this many watts
+	double maxPower;
+};
+
+/**
+ * @brief The PowerDerivation class derives the average power from the deltas of energy counters
+ *
+ * Many meters publish only their counters, e.g. 1-0:1.8.0*255 in Wh. The power is derived into the matching power
+ * number of the same measurand, e.g. 1-0:1.7.0*255 in W. The time between two values is taken from the meter clock
+ * if the meter sends one, the jitter of the receive time would make the power noisy otherwise. Each counter keeps the
+ * values of the last span only, so adding a value takes amortized constant time.
+ */
+class PowerDerivation
+{
+public:
+
+	/**
+	 * @brief PowerObisNumber
+	 * @param counterObisNumber
+	 * @return The obis number of the power derived from the given energy counter, empty if it is no energy counter
+	 */
+	static QString PowerObisNumber(const QString &counterObisNumber);
+
+	/**
+	 * @brief PowerDerivation Constructor
+	 * @param configuration
+	 */
+	explicit PowerDerivation(const PowerDerivationConfiguration &configuration = {});
+
+	/**
+	 * @brief addSample Add a counter value
+	 * @param counterObisNumber
+	 * @param clock Where the time comes from, the counter starts over if it changes
+	 * @param time Time of the given clock in milliseconds
+	 * @param value The counter value in Wh
+	 * @return The average power in W over the last span, NaN until a span was observed or after a reset
+	 */
+	double addSample(const QString &counterObisNumber, const MeterClock &clock, const qint64 &time, const double &value);
+
+	/**
+	 * @brief reset Forget all counter values, e.g. when the connection was closed
+	 */
+	void reset();
+
+private:
+
+	struct CounterValue
+	{
+		qint64 time;
+
+		//!The value with all rollovers so far added, so it increases monotonically
+		double value;
+	};
+
+	struct Counter
+	{
+		MeterClock clock;
+
+		//!The last value as received, to detect rollovers
+		double received;
+
+		//!The values of the last span, the oldest first
+		QList<CounterValue> values;
+	};
+
+	/**
+	 * @brief m_Configuration How the power is derived
+	 */
+	PowerDerivationConfiguration m_Configuration;
+
+	/**
+	 * @brief m_Counters The recent values of every energy counter, by obis number
+	 */
+	QMap<QString, Counter> m_Counters;
+};
+
+}
@@ -0,0 +1,464 @@
+#include "QueryCommand.h"
+
+#include <memory>
+#include <algorithm>
+
+#include <QSettings>
+#include <QDateTime>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include "QueryEngine.h"
+#include "SeriesAligner.h"
+#include "ChannelExpression.h"
+#include "CalendarAggregates.h"
+#include "AggregationKernels.h"
+#include "StorageSink.h"
+#include "ConnectionSerializer.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  const char* cQueryOption = "--query";
+  const char* cBenchmarkOption = "--benchmark-kernels";
+  const char* cAlignOption = "--align";
+  const char* cCalendarOption = "--calendar";
+
+  //the history is aligned in chunks of this length, so the memory does not depend on the length of the range
+  const qint64 cAlignChunkMs = 24 * 60 * 60 * 1000;
+
+  //enough samples to exceed the caches, so the memory bandwidth is part of the measurement
+  const int cBenchmarkSamples = 10000000;
+
+  /*
+   * Parse an ISO 8601 date or date time, or milliseconds since epoch
+   */
+  bool ParseTime(const QString &text, qint64 &timestamp)
+  {
+    const auto dateTime = QDateTime::fromString(text, Qt::ISODate);
+    if(true == dateTime.isValid())
+    {
+      timestamp = dateTime.toMSecsSinceEpoch();
+      return true;
+    }
+
+    bool ok{};
+    timestamp = text.toLongLong(&ok);
+
+    return ok;
+  }
+
+  /*
+   * Align the stored history of the given series, named like "connection/obis", and print them as csv. The
+   * expressions are computed from the aligned values of each grid point.
+   */
+  int RunAlignment(QStringList series,
+                   const QStringList &expressionTexts,
+                   const qint64 &from,
+                   const qint64 &to,
+                   const Duration &step,
+                   const AlignMethod &method,
+                   QTextStream &out,
+                   QTextStream &err)
+  {
+    QList<ChannelExpression> expressions;
+
+    for(const auto &text : expressionTexts)
+    {
+      const auto expression = ChannelExpression::Compile(text);
+      if(false == expression.isValid())
+      {
+        err << "invalid expression " << text << ": " << expression.getError() << '\n';
+        return 1;
+      }
+
+      for(const auto &input : expression.getInputs())
+      {
+        if(false == series.contains(input)) series.append(input);
+      }
+
+      expressions.append(expression);
+    }
+
+    if(true == series.isEmpty())
+    {
+      err << "at least one series like connection/obis is required" << '\n';
+      return 1;
+    }
+
+    QSettings settings;
+    const auto connections = ConnectionSerializer::DeserializeConnectionData(settings);
+
+    //each connection is read from its own sink, the series only refer to them
+    QMap<QString, std::shared_ptr<StorageSink>> sinks;
+    QList<QPair<const StorageSink*, QString>> sources;
+
+    for(const auto &name : series)
+    {
+      const int separator = name.indexOf(QChar('/'));
+      const QString connectionName = name.left(separator);
+
+      if(false == sinks.contains(connectionName))
+      {
+        for(const auto &data : connections)
+        {
+          if(data.name != connectionName) continue;
+
+          sinks.insert(connectionName, std::shared_ptr<StorageSink>(CreateStorageSink(data)));
+        }
+      }
+
+      if((0 >= separator) || (false == sinks.contains(connectionName)))
+      {
+        err << "unknown series " << name << '\n';
+        return 1;
+      }
+
+      const StorageSink* sink = sinks.value(connectionName).get();
+      sources.append(qMakePair(sink, name.mid(separator + 1)));
+    }
+
+    out << "timestamp," << series.join(QChar(','));
+    for(const auto &text : expressionTexts) out << ",\"" << QString(text).replace(QChar('"'), QString("\"\"")) << '"';
+    out << '\n';
+
+    QVector<double> inputs;
+    int rows = 0;
+
+    //without a start the grid starts at the first stored value
+    SeriesAligner aligner(series.size(), step, method, (0 < from) ? from : -1);
+    aligner.setRowCallback([&](const qint64 &timestamp, const QVector<double> &values)
+    {
+      bool empty = true;
+      for(const auto &value : values) empty = (true == empty) && (true == qIsNaN(value));
+
+      if(true == empty) return;
+
+      out << QDateTime::fromMSecsSinceEpoch(timestamp, Qt::UTC).toString(Qt::ISODateWithMs);
+      for(const auto &value : values) out << ',' << QString::number(value, 'g', 15);
+
+      for(const auto &expression : expressions)
+      {
+        inputs.resize(expression.getInputs().size());
+        for(int i = 0; i < inputs.size(); ++i) inputs[i] = values.at(series.indexOf(expression.getInputs().at(i)));
+
+        out << ',' << QString::number(expression.evaluate(inputs), 'g', 15);
+      }
+
+      out << '\n';
+      ++rows;
+    });
+
+    //the chunks before the oldest stored value are skipped, --from defaults to the epoch
+    qint64 first = -1;
+    for(const auto &source : sources)
+    {
+      const qint64 timestamp = source.first->getFirstTimestamp(source.second);
+      if((0 <= timestamp) && ((0 > first) || (timestamp < first))) first = timestamp;
+    }
+
+    if(0 > first)
+    {
+      err << "0 rows" << '\n';
+      return 0;
+    }
+
+    for(qint64 chunk = qMax(from, first); chunk <= to; chunk += cAlignChunkMs)
+    {
+      const qint64 chunkEnd = qMin(to, chunk + cAlignChunkMs - 1);
+
+      for(int i = 0; i < sources.size(); ++i)
+      {
+        for(const auto &sample : sources.at(i).first->readRange(sources.at(i).second, chunk, chunkEnd))
+        {
+          aligner.addSample(i, sample.first, sample.second);
+        }
+      }
+
+      //the grid points near the end of the chunk may still be interpolated with values of the next one
+      aligner.advance(chunkEnd - cMaxHoldMilliseconds);
+    }
+
+    aligner.advance(to);
+
+    err << rows << " rows" << '\n';
+
+    return 0;
+  }
+
+  /*
+   * Print the consumption per calendar period of the energy counters of a connection as csv, as last saved by the
+   * running connection. Periods without consumption are left out.
+   */
+  int RunCalendar(const QString &connectionName,
+                  const QString &obisNumber,
+                  const CalendarPeriod &period,
+                  const qint64 &from,
+                  const qint64 &to,
+                  QTextStream &out,
+                  QTextStream &err)
+  {
+    CalendarAggregates aggregates;
+    if(false == aggregates.load(CalendarAggregates::GetFilePath(connectionName)))
+    {
+      err << "no calendar aggregates for connection " << connectionName << '\n';
+      return 1;
+    }
+
+    //the periods are local dates, like the aggregates
+    const QDate last = QDateTime::fromMSecsSinceEpoch(to).date();
+    int rows = 0;
+
+    out << "start,obis,value" << '\n';
+
+    for(QDate date = CalendarAggregates::PeriodStart(period, QDateTime::fromMSecsSinceEpoch(from).date());
+        date <= last;
+        date = CalendarAggregates::NextPeriodStart(period, date))
+    {
+      QHash<QString, double> consumption;
+
+      if(true == obisNumber.isEmpty())
+      {
+        consumption = aggregates.getConsumptionByTariff(period, date);
+      }
+      else
+      {
+        consumption.insert(obisNumber, aggregates.getConsumption(obisNumber, period, date));
+      }
+
+      auto tariffs = consumption.keys();
+      std::sort(tariffs.begin(), tariffs.end());
+
+      for(const auto &tariff : tariffs)
+      {
+        if(0.0 == consumption.value(tariff)) continue;
+
+        out << date.toString(Qt::ISODate) << ',' << tariff << ',' << QString::number(consumption.value(tariff), 'f', 3)
+            << '\n';
+        ++rows;
+      }
+    }
+
+    err << rows << " rows" << '\n';
+
+    return 0;
+  }
+}
+
+bool IsQueryCommand(int argc, char *argv[])
+{
+  for(int i = 1; i < argc; ++i)
+  {
+    if((0 == qstrcmp(argv[i], cQueryOption)) || (0 == qstrcmp(argv[i], cBenchmarkOption)) ||
+       (0 == qstrcmp(argv[i], cAlignOption)) || (0 == qstrcmp(argv[i], cCalendarOption)))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int RunQueryCommand(int argc, char *argv[])
+{
+  QCoreApplication a(argc, argv);
+
+  QCoreApplication::setOrganizationName("Ssmr");
+  QCoreApplication::setApplicationName("ssmr");
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QCoreApplication::translate("main", "Query the stored history of a connection. "
+                                                                       "Groups are aligned to UTC."));
+  parser.addHelpOption();
+
+  const QCommandLineOption queryOption(QString(cQueryOption).mid(2),
+                                       QCoreApplication::translate("main", "Run a query instead of the GUI."));
+  const QCommandLineOption benchmarkOption(QString(cBenchmarkOption).mid(2),
+                                           QCoreApplication::translate("main", "Compare the vectorized aggregation "
+                                                                               "kernels to the scalar ones."));
+  const QCommandLineOption alignOption(QString(cAlignOption).mid(2),
+                                       QCoreApplication::translate("main", "Align series of any connections onto a "
+                                                                           "common time grid."));
+  const QCommandLineOption calendarOption(QString(cCalendarOption).mid(2),
+                                          QCoreApplication::translate("main", "Print the consumption of the energy "
+                                                                              "counters per local day, week or "
+                                                                              "month."),
+                                          QString("period"));
+  const QCommandLineOption seriesOption({"s", "series"},
+                                        QCoreApplication::translate("main", "A series to align, can be repeated."),
+                                        QString("connection/obis"));
+  const QCommandLineOption stepOption(QString("step"),
+                                      QCoreApplication::translate("main", "The distance of the aligned grid points."),
+                                      QString("duration"),
+                                      QString("15m"));
+  const QCommandLineOption methodOption({"m", "method"},
+                                        QCoreApplication::translate("main", "last, linear or twa (time weighted "
+                                                                            "average) for aligned series."),
+                                        QString("method"),
+                                        QString("last"));
+  const QCommandLineOption expressionOption({"e", "expression"},
+                                            QCoreApplication::translate("main", "A column computed from the aligned "
+                                                                                "series, e.g. \"[pv/1-0:2.8.0*255] - "
+                                                                                "[home/1-0:1.8.0*255]\"."),
+                                            QString("expression"));
+  const QCommandLineOption connectionOption({"c", "connection"},
+                                            QCoreApplication::translate("main", "The name of the connection."),
+                                            QString("name"));
+  const QCommandLineOption obisOption({"o", "obis"},
+                                      QCoreApplication::translate("main", "The OBIS number to query."),
+                                      QString("obis"));
+  const QCommandLineOption fromOption(QString("from"),
+                                      QCoreApplication::translate("main", "Start of the range, ISO 8601 or ms."),
+                                      QString("time"),
+                                      QString("0"));
+  const QCommandLineOption toOption(QString("to"),
+                                    QCoreApplication::translate("main", "End of the range, ISO 8601 or ms."),
+                                    QString("time"));
+  const QCommandLineOption aggregateOption({"a", "aggregate"},
+                                           QCoreApplication::translate("main", "sum, avg, min, max, last or delta."),
+                                           QString("aggregate"),
+                                           QString("avg"));
+  const QCommandLineOption minOption(QString("min"),
+                                     QCoreApplication::translate("main", "Only use values of at least this."),
+                                     QString("value"));
+  const QCommandLineOption maxOption(QString("max"),
+                                     QCoreApplication::translate("main", "Only use values of at most this."),
+                                     QString("value"));
+  const QCommandLineOption bucketOption({"b", "bucket"},
+                                        QCoreApplication::translate("main", "Group width like 15m or 24h, the whole "
+                                                                            "range is a single group if not set."),
+                                        QString("duration"));
+
+  parser.addOptions({queryOption, benchmarkOption, connectionOption, obisOption, fromOption, toOption, aggregateOption,
+                     bucketOption, minOption, maxOption, alignOption, seriesOption, stepOption, methodOption,
+                     expressionOption, calendarOption});
+  parser.process(a);
+
+  if(true == parser.isSet(benchmarkOption))
+  {
+    AggregationKernels::Benchmark(out, cBenchmarkSamples);
+    return 0;
+  }
+
+  Query query;
+  query.obisNumber = parser.value(obisOption);
+  query.to = QDateTime::currentMSecsSinceEpoch();
+
+  if((false == ParseTime(parser.value(fromOption), query.from)) ||
+     ((true == parser.isSet(toOption)) && (false == ParseTime(parser.value(toOption), query.to))))
+  {
+    err << "invalid time range" << '\n';
+    return 1;
+  }
+
+  if(true == parser.isSet(alignOption))
+  {
+    AlignMethod method{};
+    const Duration step = Duration::FromString(parser.value(stepOption));
+
+    if((false == SeriesAligner::ParseMethod(parser.value(methodOption), method)) || (false == step.isValid()))
+    {
+      err << "invalid step or method" << '\n';
+      return 1;
+    }
+
+    return RunAlignment(parser.values(seriesOption), parser.values(expressionOption), query.from, query.to, step,
+                        method, out, err);
+  }
+
+  if(true == parser.isSet(calendarOption))
+  {
+    CalendarPeriod period{};
+    if(false == CalendarAggregates::ParsePeriod(parser.value(calendarOption), period))
+    {
+      err << "invalid period " << parser.value(calendarOption) << '\n';
+      return 1;
+    }
+
+    return RunCalendar(parser.value(connectionOption), query.obisNumber, period, query.from, query.to, out, err);
+  }
+
+  if(false == QueryEngine::ParseAggregate(parser.value(aggregateOption), query.aggregate))
+  {
+    err << "invalid aggregate " << parser.value(aggregateOption) << '\n';
+    return 1;
+  }
+
+  if(true == parser.isSet(bucketOption))
+  {
+    query.bucket = Duration::FromString(parser.value(bucketOption));
+
+    if(false == query.bucket.isValid())
+    {
+      err << "invalid bucket " << parser.value(bucketOption) << '\n';
+      return 1;
+    }
+  }
+
+  const QList<QPair<QCommandLineOption, double*>> bounds = {qMakePair(minOption, &query.values.min),
+                                                             qMakePair(maxOption, &query.values.max)};
+  for(const auto &bound : bounds)
+  {
+    if(false == parser.isSet(bound.first)) continue;
+
+    bool ok{};
+    *bound.second = parser.value(bound.first).toDouble(&ok);
+
+    if(false == ok)
+    {
+      err << "invalid value " << parser.value(bound.first) << '\n';
+      return 1;
+    }
+  }
+
+  if(false == query.isValid())
+  {
+    err << "an obis number and a valid time range are required" << '\n';
+    return 1;
+  }
+
+  QSettings settings;
+
+  ConnectionData connectionData;
+  for(const auto &data : ConnectionSerializer::DeserializeConnectionData(settings))
+  {
+    if(data.name == parser.value(connectionOption)) connectionData = data;
+  }
+
+  if(true == connectionData.name.isEmpty())
+  {
+    err << "unknown connection " << parser.value(connectionOption) << '\n';
+    return 1;
+  }
+
+  std::unique_ptr<StorageSink> sink(CreateStorageSink(connectionData));
+  const QueryEngine engine(sink.get(), RollupConfiguration::Load(settings));
+
+  QElapsedTimer timer;
+  timer.start();
+
+  const auto result = engine.run(query);
+
+  out << "timestamp,value,count" << '\n';
+  for(const auto &row : result)
+  {
+    out << QDateTime::fromMSecsSinceEpoch(row.start, Qt::UTC).toString(Qt::ISODateWithMs) << ','
+        << QString::number(row.value, 'g', 15) << ','
+        << row.count << '\n';
+  }
+
+  err << result.size() << " rows in " << timer.elapsed() << " ms" << '\n';
+
+  return 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+namespace Ssmr
+{
+
+/**
+ * @brief IsQueryCommand
+ * @param argc
+ * @param argv
+ * @return True if the application was started with "--query" or "--benchmark-kernels" and has to run RunQueryCommand
+ * instead of the GUI
+ */
+extern bool IsQueryCommand(int argc, char *argv[]);
+
+/**
+ * @brief RunQueryCommand Answer a single query over the stored history of a connection and print the result as csv
+ * @param argc
+ * @param argv
+ * @return The exit code
+ *
+ * Example: ssmr --query --connection home --obis "1-0:1.8.0*255" --from 2023-01-01 --aggregate delta --bucket 24h
+ *
+ * The quarter hours in which the momentary power exceeded 10 kW:
+ * ssmr --query --connection home --obis "1-0:16.7.0*255" --min 10000 --aggregate max --bucket 15m
+ */
+extern int RunQueryCommand(int argc, char *argv[]);
+
+}
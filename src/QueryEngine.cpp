@@ -0,0 +1,399 @@
+#include "QueryEngine.h"
+
+#include <QtMath>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <limits>
+#include <algorithm>
+
+#include "StorageSink.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  const QMap<QueryAggregate, QString> cAggregateMapping =
+    {{QueryAggregate::eSum, {"sum"}},
+     {QueryAggregate::eAverage, {"avg"}},
+     {QueryAggregate::eMin, {"min"}},
+     {QueryAggregate::eMax, {"max"}},
+     {QueryAggregate::eLast, {"last"}},
+     {QueryAggregate::eDelta, {"delta"}}};
+
+  //more segments than threads keep the threads busy if the segments differ in size and bound the memory per segment
+  const int cSegmentsPerThread = 8;
+
+  /*
+   * The increase of a counter from one value to the next, a counter running backwards was reset
+   */
+  double CounterStep(const double &from, const double &to)
+  {
+    return (to < from) ? to : (to - from);
+  }
+
+  /*
+   * Returns the start of the width aligned interval containing the given timestamp
+   */
+  qint64 AlignDown(const qint64 &timestamp, const qint64 &width)
+  {
+    const qint64 remainder = timestamp % width;
+    return timestamp - ((0 > remainder) ? (remainder + width) : remainder);
+  }
+}
+
+QueryPartial::QueryPartial()
+  : count(0)
+  , sum(0.0)
+  , min(std::numeric_limits<double>::infinity())
+  , max(-std::numeric_limits<double>::infinity())
+  , firstTimestamp(std::numeric_limits<qint64>::max())
+  , first(qQNaN())
+  , lastTimestamp(std::numeric_limits<qint64>::min())
+  , last(qQNaN())
+  , increase(0.0)
+  , weightedSum(0.0)
+  , weight(0.0)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void QueryPartial::add(const qint64 &timestamp, const double &value)
+{
+  QueryPartial single;
+  single.count = 1;
+  single.sum = value;
+  single.min = value;
+  single.max = value;
+  single.firstTimestamp = timestamp;
+  single.first = value;
+  single.lastTimestamp = timestamp;
+  single.last = value;
+
+  merge(single);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void QueryPartial::add(const SampleColumns &columns, int begin, int end, const qint64 &until)
+{
+  const auto aggregate = AggregationKernels::Aggregate(columns, begin, end);
+  if(0 == aggregate.count) return;
+
+  QueryPartial run;
+  run.count = aggregate.count;
+  run.sum = aggregate.sum;
+  run.min = aggregate.min;
+  run.max = aggregate.max;
+  run.firstTimestamp = aggregate.firstTimestamp;
+  run.first = aggregate.first;
+  run.lastTimestamp = aggregate.lastTimestamp;
+  run.last = aggregate.last;
+  run.increase = AggregationKernels::CounterDelta(columns, begin, end);
+
+  //values are held as long as in the rollups, so an outage does not stretch a stale value
+  const double mean = AggregationKernels::TimeWeightedMean(columns, begin, end, until,
+                                                           cMaxHoldMilliseconds, &run.weight);
+  run.weightedSum = (0.0 < run.weight) ? mean * run.weight : 0.0;
+
+  merge(run);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void QueryPartial::addRollup(const RollupBucket &bucket, const qint64 &width)
+{
+  if(false == bucket.isValid()) return;
+
+  count += bucket.count;
+  sum += bucket.average() * static_cast<double>(bucket.count);
+  weightedSum += bucket.average() * static_cast<double>(width);
+  weight += static_cast<double>(width);
+  min = qMin(min, bucket.min);
+  max = qMax(max, bucket.max);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void QueryPartial::merge(const QueryPartial &other)
+{
+  if(0 == other.count) return;
+
+  //the counter step between both time ranges, only meaningful if both contain raw values
+  if((0 < count) && (false == qIsNaN(last)) && (false == qIsNaN(other.first)))
+  {
+    increase += (other.firstTimestamp > lastTimestamp) ? CounterStep(last, other.first)
+                                                       : CounterStep(other.last, first);
+  }
+
+  increase += other.increase;
+  count += other.count;
+  sum += other.sum;
+  weightedSum += other.weightedSum;
+  weight += other.weight;
+  min = qMin(min, other.min);
+  max = qMax(max, other.max);
+
+  if(other.firstTimestamp < firstTimestamp)
+  {
+    firstTimestamp = other.firstTimestamp;
+    first = other.first;
+  }
+
+  if(other.lastTimestamp >= lastTimestamp)
+  {
+    lastTimestamp = other.lastTimestamp;
+    last = other.last;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double QueryPartial::result(const QueryAggregate &aggregate, const double &previousLast) const
+{
+  switch(aggregate)
+  {
+    case QueryAggregate::eSum: return sum;
+    case QueryAggregate::eAverage:
+      //runs without elapsed time, e.g. a single value, fall back to the arithmetic mean
+      if(0.0 < weight) return weightedSum / weight;
+      return (0 < count) ? sum / static_cast<double>(count) : qQNaN();
+    case QueryAggregate::eMin: return min;
+    case QueryAggregate::eMax: return max;
+    case QueryAggregate::eLast: return last;
+    case QueryAggregate::eDelta:
+      return increase + ((true == qIsNaN(previousLast)) ? 0.0 : CounterStep(previousLast, first));
+  }
+
+  return qQNaN();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool QueryEngine::ParseAggregate(const QString &text, QueryAggregate &aggregate)
+{
+  const QString key = (QString("average") == text.toLower()) ? QString("avg") : text.toLower();
+  if(false == cAggregateMapping.values().contains(key)) return false;
+
+  aggregate = cAggregateMapping.key(key);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString QueryEngine::AggregateToString(const QueryAggregate &aggregate)
+{
+  return cAggregateMapping.value(aggregate);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QueryEngine::QueryEngine(const StorageSink *sink, const RollupConfiguration &rollups)
+  : m_Sink(sink)
+  , m_Rollups(rollups)
+  , m_Cancellation()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void QueryEngine::setCancellation(const QueryCancellation &cancellation)
+{
+  m_Cancellation = cancellation;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QueryResult QueryEngine::run(const Query &query) const
+{
+  QueryResult result;
+
+  if((nullptr == m_Sink) || (false == query.isValid())) return result;
+
+  Partials partials;
+  QList<QPair<qint64, qint64>> rawRanges;
+
+  const int tierIndex = selectTier(query);
+
+  if(true == isCanceled()) return result;
+
+  if(0 <= tierIndex)
+  {
+    const auto &tier = m_Rollups.tiers.at(tierIndex);
+    const qint64 width = static_cast<qint64>(tier.width.toMilliseconds());
+
+    //only buckets completely within the range are used, the edges are read from the raw values
+    const qint64 first = AlignDown(query.from + width - 1, width);
+    const auto buckets = m_Sink->readRollups(query.obisNumber, tier.name, first, query.to - width + 1);
+
+    for(const auto &bucket : buckets)
+    {
+      partials[GroupStart(query, bucket.start)].addRollup(bucket, width);
+    }
+
+    if(false == buckets.isEmpty())
+    {
+      const qint64 coveredFrom = buckets.first().start;
+      const qint64 coveredTo = buckets.last().start + width - 1;
+
+      if(query.from < coveredFrom) rawRanges.append(qMakePair(query.from, coveredFrom - 1));
+      if(coveredTo < query.to) rawRanges.append(qMakePair(coveredTo + 1, query.to));
+    }
+    else
+    {
+      rawRanges.append(qMakePair(query.from, query.to));
+    }
+  }
+  else
+  {
+    rawRanges.append(qMakePair(query.from, query.to));
+  }
+
+  for(const auto &range : rawRanges)
+  {
+    scanRaw(query, range.first, range.second, partials);
+  }
+
+  //the partials of skipped segments are missing
+  if(true == isCanceled()) return result;
+
+  result.reserve(partials.size());
+
+  double previousLast = qQNaN();
+  for(auto it = partials.cbegin(); it != partials.cend(); ++it)
+  {
+    if(0 == it->count) continue;
+
+    result.append(QueryRow{it.key(), it->result(query.aggregate, previousLast), it->count});
+    previousLast = it->last;
+  }
+
+  return result;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QFuture<QueryResult> QueryEngine::runAsync(const Query &query) const
+{
+  const QueryEngine engine = *this;
+
+  return QtConcurrent::run([engine, query]() { return engine.run(query); });
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int QueryEngine::selectTier(const Query &query) const
+{
+  //rollups do not keep the first and last values and the raw sums, and cannot be filtered by value
+  if(true == query.values.isBounded()) return -1;
+
+  if((QueryAggregate::eAverage != query.aggregate) &&
+     (QueryAggregate::eMin != query.aggregate) &&
+     (QueryAggregate::eMax != query.aggregate))
+  {
+    return -1;
+  }
+
+  const qint64 range = query.to - query.from + 1;
+
+  for(int i = m_Rollups.tiers.size() - 1; i >= 0; --i)
+  {
+    const auto &tier = m_Rollups.tiers.at(i);
+    if(false == tier.isValid()) continue;
+
+    const qint64 width = static_cast<qint64>(tier.width.toMilliseconds());
+
+    if(true == query.bucket.isValid())
+    {
+      //every rollup bucket has to fall into exactly one group
+      if(0 == static_cast<qint64>(query.bucket.toMilliseconds()) % width) return i;
+    }
+    else
+    {
+      //the edges of the range are read from the raw values, so they should stay small
+      if(4 * width <= range) return i;
+    }
+  }
+
+  return -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void QueryEngine::scanRaw(const Query &query, const qint64 &from, const qint64 &to, Partials &partials) const
+{
+  const int count = QThreadPool::globalInstance()->maxThreadCount() * cSegmentsPerThread;
+  const auto segments = m_Sink->getSegments(query.obisNumber, from, to, count, query.values);
+
+  const StorageSink* sink = m_Sink;
+  const QueryEngine* engine = this;
+
+  QList<QFuture<Partials>> futures;
+
+  for(const auto &segment : segments)
+  {
+    futures.append(QtConcurrent::run([sink, engine, query, segment]()
+    {
+      Partials segmentPartials;
+
+      //the remaining segments of a canceled query are skipped, it waits for the running ones only
+      if(true == engine->isCanceled()) return segmentPartials;
+
+      auto samples = sink->readRange(query.obisNumber, segment.first, segment.second);
+      if(true == engine->isCanceled()) return segmentPartials;
+
+      if(true == query.values.isBounded())
+      {
+        const auto outside = [&query](const ObisSample &sample)
+        {
+          return false == query.values.contains(sample.second);
+        };
+
+        samples.erase(std::remove_if(samples.begin(), samples.end(), outside), samples.end());
+      }
+
+      const auto columns = SampleColumns::FromSamples(samples);
+      const auto &timestamps = columns.timestamps;
+
+      //the samples are ordered by time, so each group is a contiguous run
+      int begin = 0;
+      while(begin < columns.size())
+      {
+        const qint64 groupStart = GroupStart(query, timestamps.at(begin));
+        const qint64 groupEnd = (true == query.bucket.isValid())
+                                ? groupStart + static_cast<qint64>(query.bucket.toMilliseconds())
+                                : std::numeric_limits<qint64>::max();
+
+        const int end = static_cast<int>(std::lower_bound(timestamps.cbegin() + begin, timestamps.cend(), groupEnd)
+                                         - timestamps.cbegin());
+
+        //the last value of a run is held until the next value, the end of the group or the end of the segment, but
+        //not longer than the rollups hold a value
+        const int runEnd = qMax(begin + 1, end);
+        const qint64 next = (runEnd < columns.size()) ? timestamps.at(runEnd) : (segment.second + 1);
+        const qint64 until = qMin(next, timestamps.at(runEnd - 1) + cMaxHoldMilliseconds);
+
+        segmentPartials[groupStart].add(columns, begin, runEnd, qMin(until, groupEnd));
+        begin = runEnd;
+      }
+
+      return segmentPartials;
+    }));
+  }
+
+  for(auto &future : futures)
+  {
+    const auto segmentPartials = future.result();
+
+    for(auto it = segmentPartials.cbegin(); it != segmentPartials.cend(); ++it)
+    {
+      partials[it.key()].merge(it.value());
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool QueryEngine::isCanceled() const
+{
+  return (nullptr != m_Cancellation) && (true == m_Cancellation());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 QueryEngine::GroupStart(const Query &query, const qint64 &timestamp)
+{
+  if(false == query.bucket.isValid()) return query.from;
+
+  return AlignDown(timestamp, static_cast<qint64>(query.bucket.toMilliseconds()));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <QMap>
+#include <QPair>
+#include <QFuture>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+#include "Rollup.h"
+#include "TypeDefinitions.h"
+#include "AggregationKernels.h"
+
+namespace Ssmr
+{
+
+class StorageSink;
+
+/**
+ * @brief The QueryAggregate enum selects how the values of a group are combined
+ */
+enum class QueryAggregate
+{
+	eSum = 0,
+	eAverage = 1,
+	eMin = 2,
+	eMax = 3,
+	eLast = 4,
+
+	//!The increase of a counter within the group, measured from the last value of the previous group
+	eDelta = 5,
+};
+
+/**
+ * @brief The Query struct selects a single series, a time range and how the values are grouped and combined
+ */
+struct Query
+{
+	Query(const QString &o = {},
+				const qint64 &f = 0,
+				const qint64 &t = 0,
+				const QueryAggregate &a = QueryAggregate::eAverage,
+				const Duration &b = {},
+				const ValueRange &v = {})
+		: obisNumber(o)
+		, from(f)
+		, to(t)
+		, aggregate(a)
+		, bucket(b)
+		, values(v)
+	{}
+
+	/**
+	 * @brief isValid
+	 * @return True if an obis number and a non empty time range are set
+	 */
+	bool isValid() const
+	{
+		return (false == obisNumber.isEmpty()) && (from <= to);
+	}
+
+	QString obisNumber;
+
+	//!The inclusive time range in milliseconds since epoch
+	qint64 from;
+	qint64 to;
+
+	QueryAggregate aggregate;
+
+	//!The width of the groups, aligned to the epoch. The whole range is a single group with an invalid bucket
+	Duration bucket;
+
+	//!Only raw values within this range are aggregated, e.g. to find the times a threshold was exceeded
+	ValueRange values;
+};
+
+/**
+ * @brief The QueryRow struct contains the result of a single group
+ */
+struct QueryRow
+{
+	//!Start of the group in milliseconds since epoch
+	qint64 start;
+
+	double value;
+
+	//!Number of values which contributed to this group
+	quint64 count;
+};
+
+typedef QVector<QueryRow> QueryResult;
+
+/**
+ * @brief The QueryPartial struct contains the aggregate state of a group, partials of disjoint time ranges can be
+ * merged in any order
+ */
+struct QueryPartial
+{
+	QueryPartial();
+
+	/**
+	 * @brief add Add a single raw value
+	 * @param timestamp
+	 * @param value
+	 */
+	void add(const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief add Add a run of raw values which are aggregated by the AggregationKernels
+	 * @param columns
+	 * @param begin
+	 * @param end
+	 * @param until The last value of the run is held until this time, used for the time weighted average. No value is
+	 * held longer than cMaxHoldMilliseconds.
+	 */
+	void add(const SampleColumns &columns, int begin, int end, const qint64 &until);
+
+	/**
+	 * @brief addRollup Add a stored rollup bucket, only sum, count, min, max and the time weighted average are updated
+	 * @param bucket
+	 * @param width The width of the bucket in milliseconds, the average of the bucket is weighted by it
+	 */
+	void addRollup(const RollupBucket &bucket, const qint64 &width);
+
+	/**
+	 * @brief merge Combine with the partial of another time range, the time ranges must not overlap
+	 * @param other
+	 */
+	void merge(const QueryPartial &other);
+
+	/**
+	 * @brief result
+	 * @param aggregate
+	 * @param previousLast The last value of the previous group, NaN if unknown. Only used for QueryAggregate::eDelta
+	 * @return The aggregated value
+	 */
+	double result(const QueryAggregate &aggregate, const double &previousLast) const;
+
+	quint64 count;
+	double sum;
+	double min;
+	double max;
+
+	qint64 firstTimestamp;
+	double first;
+
+	qint64 lastTimestamp;
+	double last;
+
+	//!The increase of a counter from the first to the last value, resets are detected like in CounterDelta
+	double increase;
+
+	//!The values multiplied by the milliseconds they were held, the average is weighted by time for raw and rollup data
+	double weightedSum;
+	double weight;
+};
+
+/**
+ * @brief QueryCancellation Returns true once the result of a running query is not needed anymore, it is called from
+ * the scanning threads
+ */
+typedef std::function<bool()> QueryCancellation;
+
+/**
+ * @brief The QueryEngine class answers time range queries over the stored history of a single connection
+ *
+ * The raw values are split into time segments by the storage sink (see StorageSink::getSegments) which are scanned in
+ * parallel on the global thread pool, the partial results of the segments are merged afterwards. Within a segment each
+ * group is a contiguous run of samples which is aggregated by the vectorized AggregationKernels.
+ *
+ * Averages, minima and maxima are read from the coarsest rollup tier whose width divides the group width, only the
+ * time not covered by stored rollup buckets is read from the raw values. This keeps queries over years fast. Queries
+ * with a value range always read the raw values, the sink leaves out the segments which cannot contain a match.
+ */
+class QueryEngine
+{
+public:
+
+	/**
+	 * @brief ParseAggregate Parse an aggregate like "avg" or "delta"
+	 * @param text
+	 * @param aggregate
+	 * @return False for unknown aggregates
+	 */
+	static bool ParseAggregate(const QString &text, QueryAggregate &aggregate);
+
+	/**
+	 * @brief AggregateToString
+	 * @param aggregate
+	 * @return The string which is parsed by ParseAggregate
+	 */
+	static QString AggregateToString(const QueryAggregate &aggregate);
+
+	/**
+	 * @brief QueryEngine Constructor
+	 * @param sink Where the history is read from, it has to outlive the engine and all running queries
+	 * @param rollups The rollup tiers written to the sink
+	 */
+	explicit QueryEngine(const StorageSink* sink,
+											 const RollupConfiguration &rollups = RollupConfiguration::Default());
+
+	/**
+	 * @brief setCancellation Set what is checked before every segment, a canceled query stops early
+	 * @param cancellation nullptr if queries are never canceled
+	 */
+	void setCancellation(const QueryCancellation &cancellation);
+
+	/**
+	 * @brief run Execute the given query and wait for the result
+	 * @param query
+	 * @return The non empty groups in time order, empty if the query was canceled
+	 */
+	QueryResult run(const Query &query) const;
+
+	/**
+	 * @brief runAsync Execute the given query on the global thread pool
+	 * @param query
+	 * @return
+	 */
+	QFuture<QueryResult> runAsync(const Query &query) const;
+
+	/**
+	 * @brief selectTier
+	 * @param query
+	 * @return The index of the rollup tier used for the given query, -1 if only raw values are used
+	 */
+	int selectTier(const Query &query) const;
+
+private:
+
+	typedef QMap<qint64, QueryPartial> Partials;
+
+	/**
+	 * @brief scanRaw Scan the raw values within [from, to] in parallel segments
+	 * @param query
+	 * @param from
+	 * @param to
+	 * @param partials The partials by group start to merge the result into
+	 */
+	void scanRaw(const Query &query, const qint64 &from, const qint64 &to, Partials &partials) const;
+
+	/**
+	 * @brief isCanceled
+	 * @return True if the running query is not needed anymore
+	 */
+	bool isCanceled() const;
+
+	/**
+	 * @brief GroupStart
+	 * @param query
+	 * @param timestamp
+	 * @return The start of the group containing the given timestamp
+	 */
+	static qint64 GroupStart(const Query &query, const qint64 &timestamp);
+
+	/**
+	 * @brief m_Sink Where the history is read from
+	 */
+	const StorageSink* m_Sink;
+
+	/**
+	 * @brief m_Rollups The rollup tiers written to the sink
+	 */
+	RollupConfiguration m_Rollups;
+
+	/**
+	 * @brief m_Cancellation Checked before every segment, nullptr if queries are never canceled
+	 */
+	QueryCancellation m_Cancellation;
+};
+
+}
@@ -0,0 +1,202 @@
+#include "Rollup.h"
+
+#include <QtMath>
+#include <QDebug>
+
+#include <limits>
+
+namespace Ssmr
+{
+
+namespace
+{
+
+/*
+ * Returns the start of the bucket containing the given timestamp
+ */
+qint64 BucketStart(const qint64 &timestamp, const qint64 &width)
+{
+  const qint64 remainder = timestamp % width;
+  return timestamp - ((0 > remainder) ? (remainder + width) : remainder);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
+
+RollupBucket::RollupBucket(qint64 s)
+  : start(s)
+  , min(std::numeric_limits<double>::infinity())
+  , max(-std::numeric_limits<double>::infinity())
+  , last(qQNaN())
+  , weightedSum(0.0)
+  , weight(0)
+  , count(0)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool RollupBucket::isValid() const
+{
+  return (0 < count) || (0 < weight);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double RollupBucket::average() const
+{
+  return (0 < weight) ? (weightedSum / static_cast<double>(weight)) : last;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RollupBucket::hold(const double &value, const qint64 &milliseconds)
+{
+  if(0 >= milliseconds) return;
+
+  weightedSum += value * static_cast<double>(milliseconds);
+  weight += milliseconds;
+
+  min = qMin(min, value);
+  max = qMax(max, value);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RollupBucket::add(const double &value)
+{
+  min = qMin(min, value);
+  max = qMax(max, value);
+  last = value;
+
+  ++count;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+RollupConfiguration RollupConfiguration::Default()
+{
+  RollupConfiguration configuration;
+
+  configuration.rawRetention = Duration();
+  configuration.tiers = {{"1m", {0, 1, 0}, {7 * 24, 0, 0}},
+                         {"15m", {0, 15, 0}, {90 * 24, 0, 0}},
+                         {"1h", {1, 0, 0}, {2 * 365 * 24, 0, 0}},
+                         {"1d", {24, 0, 0}, {}}};
+
+  return configuration;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+RollupConfiguration RollupConfiguration::Load(QSettings &settings)
+{
+  RollupConfiguration configuration = Default();
+
+  settings.beginGroup("rollups");
+
+  //retention values are stored in seconds like the mapping intervals, 0 keeps the values forever
+  const auto retention = [&settings](const QString &key, const Duration &defaultValue)
+  {
+    if(false == settings.contains(key)) return defaultValue;
+    return Duration::FromString(QString("%1s").arg(settings.value(key).toULongLong()));
+  };
+
+  configuration.rawRetention = retention(QString("raw"), configuration.rawRetention);
+
+  for(auto &tier : configuration.tiers)
+  {
+    tier.retention = retention(tier.name, tier.retention);
+  }
+
+  settings.endGroup();
+
+  return configuration;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+RollupStore::RollupStore(const RollupConfiguration &configuration)
+  : m_Configuration(configuration)
+  , m_Series()
+  , m_BucketClosed()
+{
+  //invalid tiers would end up in endless loops
+  for(int i = m_Configuration.tiers.size() - 1; i >= 0; --i)
+  {
+    if(false == m_Configuration.tiers.at(i).isValid()) m_Configuration.tiers.removeAt(i);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const RollupConfiguration &RollupStore::getConfiguration() const
+{
+  return m_Configuration;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RollupStore::setBucketClosedCallback(const BucketClosedCallback &callback)
+{
+  m_BucketClosed = callback;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RollupStore::addSample(const QString &obisNumber, const qint64 &timestamp, const double &value)
+{
+  auto &series = m_Series[obisNumber];
+
+  if(series.tiers.size() != m_Configuration.tiers.size())
+  {
+    series.tiers.resize(m_Configuration.tiers.size());
+  }
+
+  if(timestamp < series.lastTimestamp) return;
+
+  for(int i = 0; i < m_Configuration.tiers.size(); ++i)
+  {
+    const auto width = static_cast<qint64>(m_Configuration.tiers.at(i).width.toMilliseconds());
+    auto &state = series.tiers[i];
+
+    //the previous value was present until now, spread its hold time over all buckets in between
+    if(0 <= series.lastTimestamp)
+    {
+      qint64 from = series.lastTimestamp;
+      const qint64 to = qMin(timestamp, series.lastTimestamp + cMaxHoldMilliseconds);
+
+      while(from < to)
+      {
+        const qint64 start = BucketStart(from, width);
+        const qint64 end = qMin(to, start + width);
+
+        auto bucket = bucketFor(obisNumber, i, state, start);
+        if(nullptr != bucket) bucket->hold(series.lastValue, end - from);
+
+        from = end;
+      }
+    }
+
+    auto bucket = bucketFor(obisNumber, i, state, BucketStart(timestamp, width));
+    if(nullptr != bucket) bucket->add(value);
+  }
+
+  series.lastTimestamp = timestamp;
+  series.lastValue = value;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RollupStore::removeSeries(const QString &obisNumber)
+{
+  m_Series.remove(obisNumber);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+RollupBucket *RollupStore::bucketFor(const QString &obisNumber, int tierIndex, TierState &state, const qint64 &start)
+{
+  if(start == state.open.start) return &state.open;
+  if(start < state.open.start) return nullptr;
+
+  if(true == state.open.isValid())
+  {
+    if(nullptr != m_BucketClosed) m_BucketClosed(obisNumber, m_Configuration.tiers.at(tierIndex), state.open);
+  }
+
+  state.open = RollupBucket(start);
+
+  return &state.open;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <functional>
+
+#include <QMap>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QSettings>
+
+#include "TypeDefinitions.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The RollupTier struct describes a single rollup resolution
+ */
+struct RollupTier
+{
+	RollupTier(const QString &n = {}, const Duration &w = {}, const Duration &r = {})
+		: name(n)
+		, width(w)
+		, retention(r)
+	{}
+
+	/**
+	 * @brief isValid
+	 * @return True if the tier has a name and a bucket width
+	 */
+	bool isValid() const
+	{
+		return (false == name.isEmpty()) && (true == width.isValid());
+	}
+
+	//!The name of the tier, used as file name suffix
+	QString name;
+
+	//!The width of a single bucket
+	Duration width;
+
+	//!How long closed buckets are kept. Buckets of tiers with an invalid retention are kept forever
+	Duration retention;
+};
+
+/**
+ * @brief The RollupBucket struct contains the aggregated values of a single time bucket
+ *
+ * Each received value is held until the next value arrives. The average is weighted with this hold time, min and max
+ * cover all values which were present within the bucket.
+ */
+struct RollupBucket
+{
+	RollupBucket(qint64 s = {});
+
+	/**
+	 * @brief isValid
+	 * @return True if at least one value contributed to this bucket
+	 */
+	bool isValid() const;
+
+	/**
+	 * @brief average
+	 * @return The time weighted average, or the last value if no time passed within this bucket
+	 */
+	double average() const;
+
+	/**
+	 * @brief hold Add a value which was present for the given duration
+	 * @param value
+	 * @param milliseconds
+	 */
+	void hold(const double &value, const qint64 &milliseconds);
+
+	/**
+	 * @brief add Add a single received value
+	 * @param value
+	 */
+	void add(const double &value);
+
+	//!Start of the bucket in milliseconds since epoch
+	qint64 start;
+
+	double min;
+	double max;
+	double last;
+
+	//!Sum of value times hold time
+	double weightedSum;
+
+	//!Total hold time in milliseconds
+	qint64 weight;
+
+	//!Number of received values within this bucket
+	quint64 count;
+};
+
+/**
+ * @brief The RollupConfiguration struct contains the rollup tiers and the retention of the raw values
+ */
+struct RollupConfiguration
+{
+	/**
+	 * @brief Load Read the configuration from the "rollups" group of the given settings
+	 * @param settings
+	 * @return The loaded configuration, the default tiers are used for everything not configured
+	 */
+	static RollupConfiguration Load(QSettings &settings);
+
+	/**
+	 * @brief Default
+	 * @return Raw values are kept forever, rollups for 1 minute, 15 minutes, 1 hour and 1 day
+	 */
+	static RollupConfiguration Default();
+
+	//!How long the raw values are kept, raw values are kept forever with an invalid retention
+	Duration rawRetention;
+
+	//!The tiers ordered from the finest to the coarsest resolution
+	QList<RollupTier> tiers;
+};
+
+/**
+ * @brief The RollupStore class incrementally maintains the rollup tiers for any number of series
+ */
+class RollupStore
+{
+public:
+
+	/**
+	 * @brief BucketClosedCallback Called for every bucket which is closed and will not change anymore
+	 */
+	typedef std::function<void(const QString &obisNumber, const RollupTier &tier, const RollupBucket &bucket)>
+		BucketClosedCallback;
+
+	/**
+	 * @brief RollupStore Constructor
+	 * @param configuration
+	 */
+	explicit RollupStore(const RollupConfiguration &configuration = RollupConfiguration::Default());
+
+	/**
+	 * @brief getConfiguration
+	 * @return The used tiers and retention
+	 */
+	const RollupConfiguration &getConfiguration() const;
+
+	/**
+	 * @brief setBucketClosedCallback
+	 * @param callback
+	 */
+	void setBucketClosedCallback(const BucketClosedCallback &callback);
+
+	/**
+	 * @brief addSample Add a new value for the given series
+	 * @param obisNumber
+	 * @param timestamp Time in milliseconds since epoch, values older than the last one are ignored
+	 * @param value
+	 */
+	void addSample(const QString &obisNumber, const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief removeSeries Forget all buckets of the given series
+	 * @param obisNumber
+	 */
+	void removeSeries(const QString &obisNumber);
+
+private:
+
+	/**
+	 * @brief The TierState struct The open bucket of one tier of a single series, closed buckets are only passed to the
+	 * BucketClosedCallback
+	 */
+	struct TierState
+	{
+		RollupBucket open;
+	};
+
+	/**
+	 * @brief The SeriesState struct The state of a single series
+	 */
+	struct SeriesState
+	{
+		qint64 lastTimestamp{-1};
+		double lastValue{};
+		QVector<TierState> tiers;
+	};
+
+	/**
+	 * @brief bucketFor Returns the open bucket for the given bucket start and closes the previous one if required
+	 * @param obisNumber
+	 * @param tierIndex
+	 * @param state
+	 * @param start
+	 * @return A nullptr if the bucket is already closed
+	 */
+	RollupBucket* bucketFor(const QString &obisNumber, int tierIndex, TierState &state, const qint64 &start);
+
+	/**
+	 * @brief m_Configuration The tiers to maintain
+	 */
+	RollupConfiguration m_Configuration;
+
+	/**
+	 * @brief m_Series The state of all series by obis number
+	 */
+	QMap<QString, SeriesState> m_Series;
+
+	/**
+	 * @brief m_BucketClosed Informed about every closed bucket
+	 */
+	BucketClosedCallback m_BucketClosed;
+};
+
+}
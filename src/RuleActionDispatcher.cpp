@@ -0,0 +1,88 @@
+#include "RuleActionDispatcher.h"
+
+#include <QUrl>
+#include <QDebug>
+#include <QProcess>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QNetworkAccessManager>
+
+namespace Ssmr
+{
+
+RuleActionDispatcher::RuleActionDispatcher(QObject *parent)
+  : QObject(parent)
+  , m_Network(new QNetworkAccessManager(this))
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+RuleActionDispatcher::~RuleActionDispatcher()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RuleActionDispatcher::onRuleTriggered(const QString &connectionName,
+                                           const RuleDefinition &rule,
+                                           const qint64 &timestamp,
+                                           const double &value)
+{
+  const QString time = QDateTime::fromMSecsSinceEpoch(timestamp).toString(Qt::ISODateWithMs);
+
+  qInfo() << "RuleActionDispatcher::onRuleTriggered() rule=" << rule.name << "connection=" << connectionName
+          << "obis=" << rule.obisNumber << "value=" << value << "time=" << time;
+
+  switch(rule.action)
+  {
+    case RuleAction::eTray:
+    {
+      emit notificationRequested(rule.name, tr("%1: %2 is %3 at %4").arg(connectionName)
+                                                                     .arg(rule.obisNumber)
+                                                                     .arg(value)
+                                                                     .arg(time));
+      break;
+    }
+    case RuleAction::eScript:
+    {
+      //the program is started detached, a slow script must not delay the received values
+      const QStringList arguments = {rule.name, connectionName, rule.obisNumber, QString::number(value, 'g', 15), time};
+
+      if(false == QProcess::startDetached(rule.target, arguments))
+      {
+        qWarning() << "RuleActionDispatcher::onRuleTriggered() failed to start" << rule.target;
+      }
+      break;
+    }
+    case RuleAction::eWebhook:
+    {
+      QJsonObject event;
+      event.insert(QString("rule"), rule.name);
+      event.insert(QString("connection"), connectionName);
+      event.insert(QString("obis"), rule.obisNumber);
+      event.insert(QString("value"), value);
+      event.insert(QString("timestamp"), time);
+
+      QNetworkRequest request{QUrl(rule.target)};
+      request.setHeader(QNetworkRequest::ContentTypeHeader, QString("application/json"));
+
+      auto reply = m_Network->post(request, QJsonDocument(event).toJson(QJsonDocument::Compact));
+
+      connect(reply, &QNetworkReply::finished, reply, [reply]()
+      {
+        if(QNetworkReply::NoError != reply->error())
+        {
+          qWarning() << "RuleActionDispatcher::onRuleTriggered() webhook failed:" << reply->errorString();
+        }
+
+        reply->deleteLater();
+      });
+      break;
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
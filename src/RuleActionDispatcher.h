@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QObject>
+
+#include "RuleEngine.h"
+
+class QNetworkAccessManager;
+
+namespace Ssmr
+{
+
+/**
+ * @brief The RuleActionDispatcher class executes the actions of the triggered rules of all connections
+ */
+class RuleActionDispatcher : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief RuleActionDispatcher Constructor
+	 * @param parent
+	 */
+	explicit RuleActionDispatcher(QObject *parent = nullptr);
+
+	/**
+	 * @brief ~RuleActionDispatcher Default destructor
+	 */
+	virtual ~RuleActionDispatcher() override;
+
+public slots:
+
+	/**
+	 * @brief onRuleTriggered Execute the action of the given rule
+	 * @param connectionName The connection the rule was triggered by
+	 * @param rule
+	 * @param timestamp Time in milliseconds since epoch
+	 * @param value The value which triggered the rule
+	 */
+	void onRuleTriggered(const QString &connectionName,
+											 const RuleDefinition &rule,
+											 const qint64 &timestamp,
+											 const double &value);
+
+signals:
+
+	/**
+	 * @brief notificationRequested Emitted for rules with a tray notification
+	 * @param title
+	 * @param message
+	 */
+	void notificationRequested(const QString &title, const QString &message);
+
+private:
+
+	/**
+	 * @brief m_Network Posts the events of the webhook rules
+	 */
+	QNetworkAccessManager* m_Network;
+};
+
+}
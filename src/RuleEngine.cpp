@@ -0,0 +1,193 @@
+#include "RuleEngine.h"
+
+#include <QDebug>
+#include <QtMath>
+
+namespace Ssmr
+{
+
+namespace
+{
+  const QStringList cConditionNames = {QString("above"), QString("below"), QString("stalled"), QString("silent")};
+  const QStringList cActionNames = {QString("tray"), QString("script"), QString("webhook")};
+}
+
+QList<RuleDefinition> RuleDefinition::Load(QSettings &settings)
+{
+  QList<RuleDefinition> rules;
+
+  const int size = settings.beginReadArray("rules");
+  for(int i = 0; i < size; ++i)
+  {
+    settings.setArrayIndex(i);
+
+    RuleDefinition rule;
+    rule.name = settings.value("name").toString();
+    rule.connection = settings.value("connection").toString();
+    rule.obisNumber = settings.value("obis").toString();
+    rule.threshold = settings.value("threshold", rule.threshold).toDouble();
+    rule.duration = Duration::FromString(QString("%1s").arg(settings.value("duration").toULongLong()));
+    rule.target = settings.value("target").toString();
+
+    const int condition = cConditionNames.indexOf(settings.value("condition").toString());
+    const int action = cActionNames.indexOf(settings.value("action", cActionNames.first()).toString());
+
+    if(0 <= condition) rule.condition = static_cast<RuleCondition>(condition);
+    if(0 <= action) rule.action = static_cast<RuleAction>(action);
+
+    if((0 > condition) || (0 > action) || (false == rule.isValid()))
+    {
+      qWarning() << "RuleDefinition::Load() skipping invalid rule" << i << rule.name;
+      continue;
+    }
+
+    rules.append(rule);
+  }
+  settings.endArray();
+
+  return rules;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+RuleDefinition::RuleDefinition()
+  : name()
+  , connection()
+  , obisNumber()
+  , condition(RuleCondition::eAbove)
+  , threshold(0.0)
+  , duration()
+  , action(RuleAction::eTray)
+  , target()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool RuleDefinition::isValid() const
+{
+  return (false == name.isEmpty()) &&
+         ((RuleCondition::eSilent == condition) || (false == obisNumber.isEmpty())) &&
+         ((RuleAction::eTray == action) || (false == target.isEmpty()));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool RuleDefinition::appliesTo(const QString &connectionName) const
+{
+  return (true == connection.isEmpty()) || (connection == connectionName);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+RuleEngine::RuleEngine(const QList<RuleDefinition> &rules)
+  : m_Evaluators()
+  , m_EvaluatorsByObisNumber()
+  , m_FrameEvaluators()
+  , m_Triggered()
+{
+  for(const auto &rule : rules)
+  {
+    if(false == rule.isValid()) continue;
+
+    const int index = m_Evaluators.size();
+    m_Evaluators.append(Evaluator{rule, -1, qQNaN(), false});
+
+    if(RuleCondition::eSilent == rule.condition)
+    {
+      m_FrameEvaluators.append(index);
+    }
+    else
+    {
+      m_EvaluatorsByObisNumber[rule.obisNumber].append(index);
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RuleEngine::setTriggeredCallback(const TriggeredCallback &callback)
+{
+  m_Triggered = callback;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RuleEngine::addSample(const QString &obisNumber, const qint64 &timestamp, const double &value)
+{
+  const auto indices = m_EvaluatorsByObisNumber.constFind(obisNumber);
+  if(indices == m_EvaluatorsByObisNumber.cend()) return;
+
+  for(const int index : indices.value())
+  {
+    auto &evaluator = m_Evaluators[index];
+
+    bool holds = false;
+
+    switch(evaluator.rule.condition)
+    {
+      case RuleCondition::eAbove: holds = (value > evaluator.rule.threshold); break;
+      case RuleCondition::eBelow: holds = (value < evaluator.rule.threshold); break;
+      case RuleCondition::eStalled: holds = (0 <= evaluator.since) && (value == evaluator.last); break;
+      case RuleCondition::eSilent: break;
+    }
+
+    evaluator.last = value;
+
+    if(false == holds)
+    {
+      //a stalled value is measured from its last change
+      evaluator.since = (RuleCondition::eStalled == evaluator.rule.condition) ? timestamp : -1;
+      evaluator.triggered = false;
+      continue;
+    }
+
+    if(0 > evaluator.since) evaluator.since = timestamp;
+
+    trigger(evaluator, timestamp, value);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RuleEngine::addFrame(const qint64 &timestamp)
+{
+  for(const int index : m_FrameEvaluators)
+  {
+    auto &evaluator = m_Evaluators[index];
+
+    evaluator.since = timestamp;
+    evaluator.triggered = false;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RuleEngine::check(const qint64 &now)
+{
+  for(const int index : m_FrameEvaluators)
+  {
+    auto &evaluator = m_Evaluators[index];
+    if(0 > evaluator.since) continue;
+
+    //the value of a silent connection is the number of seconds since the last frame
+    trigger(evaluator, now, static_cast<double>(now - evaluator.since) / 1000.0);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RuleEngine::reset(const qint64 &now)
+{
+  for(auto &evaluator : m_Evaluators)
+  {
+    evaluator.since = (RuleCondition::eSilent == evaluator.rule.condition) ? now : -1;
+    evaluator.last = qQNaN();
+    evaluator.triggered = false;
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void RuleEngine::trigger(Evaluator &evaluator, const qint64 &timestamp, const double &value)
+{
+  if(true == evaluator.triggered) return;
+  if(timestamp - evaluator.since < static_cast<qint64>(evaluator.rule.duration.toMilliseconds())) return;
+
+  evaluator.triggered = true;
+
+  if(nullptr != m_Triggered) m_Triggered(evaluator.rule, timestamp, value);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
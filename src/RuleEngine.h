@@ -0,0 +1,195 @@
+#pragma once
+
+#include <functional>
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QSettings>
+
+#include "TypeDefinitions.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The RuleCondition enum selects what a rule watches
+ */
+enum class RuleCondition
+{
+	//!The value is above the threshold for at least the duration
+	eAbove = 0,
+
+	//!The value is below the threshold for at least the duration
+	eBelow = 1,
+
+	//!The value did not change for at least the duration, e.g. a stalled counter
+	eStalled = 2,
+
+	//!No frame was received for at least the duration, the obis number is not used
+	eSilent = 3,
+};
+
+/**
+ * @brief The RuleAction enum selects what happens when a rule is triggered
+ */
+enum class RuleAction
+{
+	//!Show a notification of the tray icon
+	eTray = 0,
+
+	//!Start the target program with the rule name, connection, obis number, value and time as arguments
+	eScript = 1,
+
+	//!Post the event as json to the target url, meant for local services
+	eWebhook = 2,
+};
+
+/**
+ * @brief The RuleDefinition struct describes a single alarm rule
+ */
+struct RuleDefinition
+{
+	/**
+	 * @brief Load Read all rules from the "rules" array of the given settings
+	 * @param settings
+	 * @return The valid rules, invalid ones are skipped
+	 */
+	static QList<RuleDefinition> Load(QSettings &settings);
+
+	RuleDefinition();
+
+	/**
+	 * @brief isValid
+	 * @return True if a name is set, an obis number unless the rule watches the frames and a target unless the
+	 * action is a tray notification
+	 */
+	bool isValid() const;
+
+	/**
+	 * @brief appliesTo
+	 * @param connectionName
+	 * @return True if the rule watches the given connection
+	 */
+	bool appliesTo(const QString &connectionName) const;
+
+	QString name;
+
+	//!The name of the watched connection, all connections if empty
+	QString connection;
+
+	QString obisNumber;
+	RuleCondition condition;
+	double threshold;
+
+	//!How long the condition has to hold before the rule is triggered, invalid means right away
+	Duration duration;
+
+	RuleAction action;
+
+	//!The program of eScript or the url of eWebhook
+	QString target;
+};
+
+/**
+ * @brief The RuleEngine class evaluates the rules of a single connection on the received values
+ *
+ * The rules are compiled into evaluators by obis number when the engine is created, so a value only visits the rules
+ * watching its obis number. A rule is triggered with the value which fulfilled its condition for the duration and is
+ * armed again once the condition does not hold anymore.
+ */
+class RuleEngine
+{
+public:
+
+	/**
+	 * @brief TriggeredCallback Called when a rule is triggered
+	 */
+	typedef std::function<void(const RuleDefinition &rule, const qint64 &timestamp, const double &value)>
+		TriggeredCallback;
+
+	/**
+	 * @brief RuleEngine Constructor
+	 * @param rules The rules of the connection
+	 */
+	explicit RuleEngine(const QList<RuleDefinition> &rules = {});
+
+	/**
+	 * @brief setTriggeredCallback
+	 * @param callback
+	 */
+	void setTriggeredCallback(const TriggeredCallback &callback);
+
+	/**
+	 * @brief addSample Evaluate the rules of the given obis number
+	 * @param obisNumber
+	 * @param timestamp Time in milliseconds since epoch
+	 * @param value
+	 */
+	void addSample(const QString &obisNumber, const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief addFrame Arm the rules watching the frames again
+	 * @param timestamp The time the frame was received
+	 */
+	void addFrame(const qint64 &timestamp);
+
+	/**
+	 * @brief check Evaluate the rules watching the frames, has to be called periodically while connected
+	 * @param now Time in milliseconds since epoch
+	 */
+	void check(const qint64 &now);
+
+	/**
+	 * @brief reset Forget the state of all rules, e.g. when the connection was opened
+	 * @param now The time the rules watching the frames start to count from, a negative time to stop them
+	 */
+	void reset(const qint64 &now);
+
+private:
+
+	struct Evaluator
+	{
+		RuleDefinition rule;
+
+		//!Since when the condition holds, a negative time if it does not
+		qint64 since;
+
+		//!The last value, to detect stalled values
+		double last;
+
+		//!True after the rule was triggered until the condition does not hold anymore
+		bool triggered;
+	};
+
+	/**
+	 * @brief trigger Trigger the rule of the given evaluator if its condition held long enough
+	 * @param evaluator
+	 * @param timestamp
+	 * @param value
+	 */
+	void trigger(Evaluator &evaluator, const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief m_Evaluators The state of all rules
+	 */
+	QVector<Evaluator> m_Evaluators;
+
+	/**
+	 * @brief m_EvaluatorsByObisNumber The indices of the evaluators watching each obis number
+	 */
+	QHash<QString, QVector<int>> m_EvaluatorsByObisNumber;
+
+	/**
+	 * @brief m_FrameEvaluators The indices of the evaluators watching the frames
+	 */
+	QVector<int> m_FrameEvaluators;
+
+	/**
+	 * @brief m_Triggered
+	 */
+	TriggeredCallback m_Triggered;
+};
+
+}
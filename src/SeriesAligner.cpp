@@ -0,0 +1,182 @@
+#include "SeriesAligner.h"
+
+#include <QMap>
+#include <QtMath>
+
+namespace Ssmr
+{
+
+namespace
+{
+  /*
+   * Returns the first multiple of the width which is not before the given timestamp
+   */
+  qint64 AlignUp(const qint64 &timestamp, const qint64 &width)
+  {
+    const qint64 remainder = timestamp % width;
+    if(0 == remainder) return timestamp;
+
+    return timestamp - remainder + ((0 < remainder) ? width : 0);
+  }
+}
+
+bool SeriesAligner::ParseMethod(const QString &text, AlignMethod &method)
+{
+  static const QMap<QString, AlignMethod> methods = {{QString("last"), AlignMethod::eLast},
+                                                     {QString("linear"), AlignMethod::eLinear},
+                                                     {QString("twa"), AlignMethod::eTimeWeighted}};
+
+  if(false == methods.contains(text)) return false;
+
+  method = methods.value(text);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+SeriesAligner::SeriesAligner(int seriesCount, const Duration &step, const AlignMethod &method, const qint64 &from)
+  : m_Step(qMax<qint64>(1, static_cast<qint64>(step.toMilliseconds())))
+  , m_Method(method)
+  , m_Next(-1)
+  , m_Series(qMax(0, seriesCount), Series{{}, qMakePair(qint64(-1), qQNaN()), 0.0, 0, -1})
+  , m_Row(qMax(0, seriesCount), qQNaN())
+  , m_RowCallback()
+{
+  if(0 <= from) m_Next = AlignUp(from, m_Step);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SeriesAligner::setRowCallback(const RowCallback &callback)
+{
+  m_RowCallback = callback;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SeriesAligner::addSample(int series, const qint64 &timestamp, const double &value)
+{
+  if((0 > series) || (series >= m_Series.size()) || (true == qIsNaN(value))) return;
+
+  auto &state = m_Series[series];
+
+  const qint64 latest = (true == state.pending.isEmpty()) ? state.held.first : state.pending.last().first;
+  if(timestamp < latest) return;
+
+  if(0 > m_Next) m_Next = AlignUp(timestamp, m_Step);
+
+  state.pending.append(qMakePair(timestamp, value));
+
+  emitReady();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SeriesAligner::advance(const qint64 &watermark)
+{
+  if(0 > m_Next) return;
+
+  while(m_Next <= watermark) emitNext();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 SeriesAligner::getNextTimestamp() const
+{
+  return m_Next;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SeriesAligner::emitReady()
+{
+  //linear interpolation needs the first value after the grid point, the other methods only the ones up to it
+  const bool after = (AlignMethod::eLinear == m_Method);
+
+  while(0 <= m_Next)
+  {
+    for(const auto &series : m_Series)
+    {
+      if(true == series.pending.isEmpty()) return;
+
+      const qint64 latest = series.pending.last().first;
+      if((latest < m_Next) || ((true == after) && (latest == m_Next))) return;
+    }
+
+    emitNext();
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SeriesAligner::emitNext()
+{
+  const qint64 timestamp = m_Next;
+
+  for(int i = 0; i < m_Series.size(); ++i)
+  {
+    auto &series = m_Series[i];
+
+    //the time weighted average only covers the interval ending at the grid point
+    series.position = qMax(series.position, timestamp - m_Step);
+
+    while((false == series.pending.isEmpty()) && (series.pending.first().first <= timestamp))
+    {
+      const auto sample = series.pending.takeFirst();
+
+      hold(series, sample.first);
+      series.held = sample;
+    }
+
+    hold(series, timestamp);
+
+    const bool held = (0 <= series.held.first) &&
+                      (timestamp - series.held.first <= cMaxHoldMilliseconds);
+
+    double value = (true == held) ? series.held.second : qQNaN();
+
+    if((AlignMethod::eLinear == m_Method) && (true == held) && (series.held.first < timestamp) &&
+       (false == series.pending.isEmpty()))
+    {
+      const auto &next = series.pending.first();
+
+      //values are not interpolated across gaps, the value at the grid point is the held one there
+      if(next.first - series.held.first <= cMaxHoldMilliseconds)
+      {
+        const double fraction = static_cast<double>(timestamp - series.held.first) /
+                                static_cast<double>(next.first - series.held.first);
+        value = series.held.second + (next.second - series.held.second) * fraction;
+      }
+    }
+
+    if(AlignMethod::eTimeWeighted == m_Method)
+    {
+      value = (0 < series.covered) ? series.area / static_cast<double>(series.covered) : qQNaN();
+
+      series.area = 0.0;
+      series.covered = 0;
+    }
+
+    m_Row[i] = value;
+  }
+
+  m_Next += m_Step;
+
+  if(nullptr != m_RowCallback) m_RowCallback(timestamp, m_Row);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SeriesAligner::hold(Series &series, const qint64 &until) const
+{
+  if(until <= series.position) return;
+
+  if(0 <= series.held.first)
+  {
+    //like the rollups a value is not held forever, e.g. if the connection was interrupted
+    const qint64 end = qMin(until, series.held.first + cMaxHoldMilliseconds);
+
+    if(end > series.position)
+    {
+      series.area += series.held.second * static_cast<double>(end - series.position);
+      series.covered += end - series.position;
+    }
+  }
+
+  series.position = until;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
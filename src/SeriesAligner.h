@@ -0,0 +1,158 @@
+#pragma once
+
+#include <functional>
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include "TypeDefinitions.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The AlignMethod enum selects how the value of a series at a grid point is determined
+ */
+enum class AlignMethod
+{
+	//!The last value at or before the grid point, an as-of join
+	eLast = 0,
+
+	//!Interpolated between the values around the grid point
+	eLinear = 1,
+
+	//!The time weighted average of the interval ending at the grid point, each value is held until the next one
+	eTimeWeighted = 2,
+};
+
+/**
+ * @brief The SeriesAligner class aligns any number of series onto a common, fixed time grid
+ *
+ * The series may come from different connections with unrelated timestamps. Each series has to be added in time
+ * order, the series can be interleaved in any way. A grid point is emitted as soon as every series has a value after
+ * it, or once the watermark passed it, e.g. at the end of the history or a while after the wall clock. The memory is
+ * bounded by the values received between the oldest pending grid point and the newest value of each series.
+ *
+ * Values are not held longer than cMaxHoldMilliseconds, a series has no value at grid points beyond.
+ */
+class SeriesAligner
+{
+public:
+
+	/**
+	 * @brief RowCallback Called with the values of all series at every emitted grid point, NaN if a series has none
+	 */
+	typedef std::function<void(const qint64 &timestamp, const QVector<double> &values)> RowCallback;
+
+	/**
+	 * @brief ParseMethod Parse a method like "last", "linear" or "twa"
+	 * @param text
+	 * @param method
+	 * @return False for unknown methods
+	 */
+	static bool ParseMethod(const QString &text, AlignMethod &method);
+
+	/**
+	 * @brief SeriesAligner Constructor
+	 * @param seriesCount
+	 * @param step The distance of the grid points, they are aligned to the epoch
+	 * @param method
+	 * @param from The first grid point is the first one not before this time, a negative time starts the grid at the
+	 * first value
+	 */
+	SeriesAligner(int seriesCount, const Duration &step, const AlignMethod &method, const qint64 &from = -1);
+
+	/**
+	 * @brief setRowCallback
+	 * @param callback
+	 */
+	void setRowCallback(const RowCallback &callback);
+
+	/**
+	 * @brief addSample Add a value of a series and emit the grid points which are complete now
+	 * @param series The index of the series
+	 * @param timestamp Time in milliseconds since epoch, older values than the last one of the series are ignored
+	 * @param value
+	 */
+	void addSample(int series, const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief advance Emit all grid points up to the given time, regardless of whether all series reached them
+	 * @param watermark Time in milliseconds since epoch, no older values are expected anymore
+	 */
+	void advance(const qint64 &watermark);
+
+	/**
+	 * @brief getNextTimestamp
+	 * @return The next grid point to emit, a negative time if the grid did not start yet
+	 */
+	qint64 getNextTimestamp() const;
+
+private:
+
+	struct Series
+	{
+		//!The values after the last emitted grid point, in time order
+		QList<ObisSample> pending;
+
+		//!The last value at or before the last emitted grid point, a negative time if none
+		ObisSample held;
+
+		//!The integral of the held values within the running interval and the time covered by them
+		double area;
+		qint64 covered;
+
+		//!Up to where the integral was accumulated
+		qint64 position;
+	};
+
+	/**
+	 * @brief emitReady Emit all grid points every series reached
+	 */
+	void emitReady();
+
+	/**
+	 * @brief emitNext Emit the next grid point and move on to the following one
+	 */
+	void emitNext();
+
+	/**
+	 * @brief hold Accumulate the held value of a series until the given time
+	 * @param series
+	 * @param until
+	 */
+	void hold(Series &series, const qint64 &until) const;
+
+	/**
+	 * @brief m_Step The distance of the grid points in milliseconds
+	 */
+	qint64 m_Step;
+
+	/**
+	 * @brief m_Method
+	 */
+	AlignMethod m_Method;
+
+	/**
+	 * @brief m_Next The next grid point to emit, a negative time until the first value
+	 */
+	qint64 m_Next;
+
+	/**
+	 * @brief m_Series The state of each series
+	 */
+	QVector<Series> m_Series;
+
+	/**
+	 * @brief m_Row The values of the emitted grid point, kept to emit without allocations
+	 */
+	QVector<double> m_Row;
+
+	/**
+	 * @brief m_RowCallback
+	 */
+	RowCallback m_RowCallback;
+};
+
+}
@@ -0,0 +1,148 @@
+#include "SeriesCompressor.h"
+
+#include <limits>
+
+namespace Ssmr
+{
+
+SeriesCompressor::SeriesCompressor(const ObisValueMapping &mapping)
+  : m_Mapping(mapping)
+  , m_LastAccepted(-1)
+  , m_HasArchived(false)
+  , m_Archived()
+  , m_HasHeld(false)
+  , m_Held()
+  , m_LowerSlope(-std::numeric_limits<double>::infinity())
+  , m_UpperSlope(std::numeric_limits<double>::infinity())
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const ObisValueMapping &SeriesCompressor::getMapping() const
+{
+  return m_Mapping;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ObisSampleList SeriesCompressor::addSample(const qint64 &timestamp, const double &value)
+{
+  ObisSampleList stored;
+
+  if(false == passesInterval(timestamp)) return stored;
+
+  const ObisSample sample = qMakePair(timestamp, value);
+
+  switch(m_Mapping.compression)
+  {
+    case CompressionMethod::eNone:
+    {
+      archive(sample, stored);
+      break;
+    }
+    case CompressionMethod::eDeadband:
+    {
+      const bool changed = (false == m_HasArchived) ||
+                           (qAbs(value - m_Archived.second) > m_Mapping.getTolerance(m_Archived.second));
+
+      if((true == changed) || (true == isGapExceeded(timestamp))) archive(sample, stored);
+      break;
+    }
+    case CompressionMethod::eSwingingDoor:
+    {
+      addSwingingDoorSample(sample, stored);
+      break;
+    }
+  }
+
+  return stored;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool SeriesCompressor::passesInterval(const qint64 &timestamp)
+{
+  if((true == m_Mapping.interval.isValid()) && (0 <= m_LastAccepted) &&
+     (static_cast<quint64>(timestamp - m_LastAccepted) <= m_Mapping.interval.toMilliseconds()))
+  {
+    return false;
+  }
+
+  m_LastAccepted = timestamp;
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ObisSampleList SeriesCompressor::flush()
+{
+  ObisSampleList stored;
+
+  if(true == m_HasHeld) stored.append(m_Held);
+
+  m_LastAccepted = -1;
+  m_HasArchived = false;
+  m_HasHeld = false;
+
+  return stored;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SeriesCompressor::addSwingingDoorSample(const ObisSample &sample, ObisSampleList &stored)
+{
+  if(false == m_HasArchived)
+  {
+    archive(sample, stored);
+    return;
+  }
+
+  const qint64 elapsed = sample.first - m_Archived.first;
+  if(0 >= elapsed) return;
+
+  const double slope = (sample.second - m_Archived.second) / elapsed;
+
+  //a segment from the archived value to this one has to keep all held back values within the tolerance
+  const bool fits = (false == m_HasHeld) || ((m_LowerSlope <= slope) && (slope <= m_UpperSlope));
+
+  if(true == fits)
+  {
+    if(true == isGapExceeded(sample.first))
+    {
+      archive(sample, stored);
+      return;
+    }
+
+    const double tolerance = m_Mapping.getTolerance(m_Archived.second);
+
+    m_LowerSlope = qMax(m_LowerSlope, (sample.second - tolerance - m_Archived.second) / elapsed);
+    m_UpperSlope = qMin(m_UpperSlope, (sample.second + tolerance - m_Archived.second) / elapsed);
+
+    m_Held = sample;
+    m_HasHeld = true;
+    return;
+  }
+
+  //the held back value passed this check when it was received, so it ends the current segment
+  archive(m_Held, stored);
+  addSwingingDoorSample(sample, stored);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SeriesCompressor::archive(const ObisSample &sample, ObisSampleList &stored)
+{
+  stored.append(sample);
+
+  m_Archived = sample;
+  m_HasArchived = true;
+  m_HasHeld = false;
+  m_LowerSlope = -std::numeric_limits<double>::infinity();
+  m_UpperSlope = std::numeric_limits<double>::infinity();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool SeriesCompressor::isGapExceeded(const qint64 &timestamp) const
+{
+  if((false == m_Mapping.maxGap.isValid()) || (false == m_HasArchived)) return false;
+
+  return static_cast<quint64>(qMax<qint64>(0, timestamp - m_Archived.first)) >= m_Mapping.maxGap.toMilliseconds();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "TypeDefinitions.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The SeriesCompressor class decides which received values of a single mapping are stored
+ *
+ * Values are first throttled by the interval of the mapping, the remaining values are thinned out by the configured
+ * compression method:
+ *
+ * - CompressionMethod::eNone stores every value which passed the interval
+ * - CompressionMethod::eDeadband stores a value if it deviates more than the tolerance from the last stored value, the
+ *   stored series reconstructs the received values as steps
+ * - CompressionMethod::eSwingingDoor stores the end points of straight segments, the stored series reconstructs the
+ *   received values by linear interpolation
+ *
+ * In both cases the reconstruction error does not exceed the tolerance of the mapping. With a valid max gap a value is
+ * stored at least that often. The swinging door holds back the latest value until it is known where the segment ends,
+ * flush() returns such a value.
+ */
+class SeriesCompressor
+{
+public:
+
+	/**
+	 * @brief SeriesCompressor Constructor
+	 * @param mapping The mapping providing interval and compression settings
+	 */
+	explicit SeriesCompressor(const ObisValueMapping &mapping = {});
+
+	/**
+	 * @brief getMapping
+	 * @return The mapping providing interval and compression settings
+	 */
+	const ObisValueMapping &getMapping() const;
+
+	/**
+	 * @brief addSample Process a received value
+	 * @param timestamp Time in milliseconds since epoch
+	 * @param value
+	 * @return The values to store, in time order. This can contain up to two values.
+	 */
+	ObisSampleList addSample(const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief passesInterval Throttle a value which cannot be compressed, e.g. a boolean, by the interval only
+	 * @param timestamp Time in milliseconds since epoch
+	 * @return True if the value has to be stored
+	 */
+	bool passesInterval(const qint64 &timestamp);
+
+	/**
+	 * @brief flush Release a held back value and start over, e.g. when the connection is closed
+	 * @return The value to store, if any
+	 */
+	ObisSampleList flush();
+
+private:
+
+	/**
+	 * @brief addSwingingDoorSample Process a value which passed the interval with the swinging door
+	 * @param sample
+	 * @param stored Values to store are appended here
+	 */
+	void addSwingingDoorSample(const ObisSample &sample, ObisSampleList &stored);
+
+	/**
+	 * @brief archive Store the given value and use it as start of the next segment
+	 * @param sample
+	 * @param stored
+	 */
+	void archive(const ObisSample &sample, ObisSampleList &stored);
+
+	/**
+	 * @brief isGapExceeded
+	 * @param timestamp
+	 * @return True if a value needs to be stored at the given time because of the max gap
+	 */
+	bool isGapExceeded(const qint64 &timestamp) const;
+
+	/**
+	 * @brief m_Mapping The interval and compression settings
+	 */
+	ObisValueMapping m_Mapping;
+
+	/**
+	 * @brief m_LastAccepted The last value which passed the interval, a negative time if none
+	 */
+	qint64 m_LastAccepted;
+
+	/**
+	 * @brief m_HasArchived True if m_Archived is set
+	 */
+	bool m_HasArchived;
+
+	/**
+	 * @brief m_Archived The last stored value
+	 */
+	ObisSample m_Archived;
+
+	/**
+	 * @brief m_HasHeld True if m_Held is set
+	 */
+	bool m_HasHeld;
+
+	/**
+	 * @brief m_Held The latest value which is not stored yet, swinging door only
+	 */
+	ObisSample m_Held;
+
+	/**
+	 * @brief m_LowerSlope The smallest slope from the archived value which keeps all held back values in tolerance
+	 */
+	double m_LowerSlope;
+
+	/**
+	 * @brief m_UpperSlope The largest slope from the archived value which keeps all held back values in tolerance
+	 */
+	double m_UpperSlope;
+};
+
+}
@@ -0,0 +1,616 @@
+#include "SqliteSink.h"
+
+#include <QDebug>
+#include <QDateTime>
+#include <QAtomicInt>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlDatabase>
+
+#include "HelpFunctions.h"
+#include "EventLoopWatchdog.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  const QString cDatabaseDriver = QString("QSQLITE");
+  const QString cDatabaseFileName = QString("ssmr.sqlite");
+
+  //expired rows are deleted once per hour
+  const int cRetentionIntervalMs = 60 * 60 * 1000;
+
+  //obis numbers which cannot be packed get ids above the packed range
+  const qint64 cFirstUnpackedId = Q_INT64_C(1) << 48;
+
+  const QStringList cSchema =
+    {QString("PRAGMA journal_mode=WAL"),
+     QString("PRAGMA synchronous=NORMAL"),
+     QString("PRAGMA busy_timeout=5000"),
+     QString("CREATE TABLE IF NOT EXISTS connections(id INTEGER PRIMARY KEY, name TEXT UNIQUE NOT NULL)"),
+     QString("CREATE TABLE IF NOT EXISTS series(connection INTEGER NOT NULL, obis INTEGER NOT NULL, "
+             "name TEXT NOT NULL, unit TEXT, PRIMARY KEY(connection, obis)) WITHOUT ROWID"),
+     QString("CREATE TABLE IF NOT EXISTS samples(connection INTEGER NOT NULL, obis INTEGER NOT NULL, "
+             "timestamp INTEGER NOT NULL, value, PRIMARY KEY(connection, obis, timestamp)) WITHOUT ROWID"),
+     QString("CREATE INDEX IF NOT EXISTS samples_by_time ON samples(timestamp, connection, obis, value)"),
+     QString("CREATE TABLE IF NOT EXISTS rollups(connection INTEGER NOT NULL, obis INTEGER NOT NULL, "
+             "tier TEXT NOT NULL, start INTEGER NOT NULL, average REAL, min REAL, max REAL, count INTEGER, "
+             "PRIMARY KEY(connection, obis, tier, start)) WITHOUT ROWID"),
+     QString("CREATE TABLE IF NOT EXISTS steps(connection INTEGER NOT NULL, obis INTEGER NOT NULL, "
+             "timestamp INTEGER NOT NULL, event TEXT NOT NULL, magnitude REAL, before_level REAL, after_level REAL, "
+             "duration INTEGER, PRIMARY KEY(connection, obis, timestamp)) WITHOUT ROWID")};
+
+  /*
+   * Execute a single statement and log failures
+   */
+  bool Execute(QSqlQuery &query, const QString &context)
+  {
+    if(true == query.exec()) return true;
+
+    qCritical() << context << "failed:" << query.lastError().text();
+    return false;
+  }
+
+  //makes the names of the reading connections unique across all threads
+  QAtomicInt gReadConnectionCount(0);
+
+  //makes the names of the writing connections unique, a replaced sink of the same connection may still be writing
+  QAtomicInt gSinkConnectionCount(0);
+
+  /*
+   * A reading connection of the calling thread, it is removed again when this goes out of scope. Connections cannot
+   * be shared between threads and keeping one per thread would leak it with every thread of a pool which expires.
+   */
+  class ReadDatabase
+  {
+  public:
+
+    explicit ReadDatabase(const QString &databasePath)
+      : m_Name(QString("ssmr-read-%1").arg(gReadConnectionCount.fetchAndAddRelaxed(1)))
+      , m_Database(QSqlDatabase::addDatabase(cDatabaseDriver, m_Name))
+    {
+      m_Database.setDatabaseName(databasePath);
+      m_Database.open();
+    }
+
+    ~ReadDatabase()
+    {
+      m_Database.close();
+
+      //the connection can only be removed once no handle refers to it anymore
+      m_Database = QSqlDatabase();
+      QSqlDatabase::removeDatabase(m_Name);
+    }
+
+    const QSqlDatabase &get() const
+    {
+      return m_Database;
+    }
+
+  private:
+
+    Q_DISABLE_COPY(ReadDatabase)
+
+    const QString m_Name;
+    QSqlDatabase m_Database;
+  };
+}
+
+/**
+ * @brief The SqliteSink::Worker class owns the writing database connection and lives in the sink thread
+ */
+class SqliteSink::Worker : public QObject
+{
+public:
+
+  Worker(const QString &databasePath, const QString &connectionName)
+    : QObject()
+    , m_DatabasePath(databasePath)
+    , m_ConnectionName(connectionName)
+    , m_DatabaseConnection(QString("ssmr-sink-%1-%2").arg(connectionName)
+                                                     .arg(gSinkConnectionCount.fetchAndAddRelaxed(1)))
+    , m_ConnectionId(-1)
+    , m_SeriesIds()
+  {
+  }
+
+  bool open()
+  {
+    auto database = QSqlDatabase::addDatabase(cDatabaseDriver, m_DatabaseConnection);
+    database.setDatabaseName(m_DatabasePath);
+
+    if(false == database.open())
+    {
+      qCritical() << "SqliteSink::Worker::open() failed to open" << m_DatabasePath << database.lastError().text();
+      return false;
+    }
+
+    for(const auto &statement : cSchema)
+    {
+      QSqlQuery query(database);
+      query.prepare(statement);
+
+      if(false == Execute(query, QString("SqliteSink::Worker::open()"))) return false;
+    }
+
+    QSqlQuery insert(database);
+    insert.prepare(QString("INSERT OR IGNORE INTO connections(name) VALUES(?)"));
+    insert.addBindValue(m_ConnectionName);
+    if(false == Execute(insert, QString("SqliteSink::Worker::open()"))) return false;
+
+    QSqlQuery select(database);
+    select.prepare(QString("SELECT id FROM connections WHERE name = ?"));
+    select.addBindValue(m_ConnectionName);
+    if((false == Execute(select, QString("SqliteSink::Worker::open()"))) || (false == select.next())) return false;
+
+    m_ConnectionId = select.value(0).toLongLong();
+
+    return true;
+  }
+
+  void close()
+  {
+    {
+      auto database = QSqlDatabase::database(m_DatabaseConnection, false);
+      database.close();
+    }
+
+    QSqlDatabase::removeDatabase(m_DatabaseConnection);
+    m_ConnectionId = -1;
+  }
+
+  void addSeries(const QString &obisNumber, const QString &unit)
+  {
+    const qint64 id = getSeriesId(obisNumber);
+    if(0 > id) return;
+
+    QSqlQuery query(QSqlDatabase::database(m_DatabaseConnection, false));
+    query.prepare(QString("UPDATE series SET unit = ? WHERE connection = ? AND obis = ?"));
+    query.addBindValue(unit);
+    query.addBindValue(m_ConnectionId);
+    query.addBindValue(id);
+
+    Execute(query, QString("SqliteSink::Worker::addSeries()"));
+  }
+
+  void write(const QVector<SampleRow> &samples, const QVector<RollupRow> &rollups, const QVector<EventRow> &events)
+  {
+    if(0 > m_ConnectionId) return;
+
+    auto database = QSqlDatabase::database(m_DatabaseConnection, false);
+
+    //a single transaction per batch, this is where the throughput comes from
+    database.transaction();
+
+    QSqlQuery sampleQuery(database);
+    sampleQuery.prepare(QString("INSERT OR REPLACE INTO samples(connection, obis, timestamp, value) "
+                                "VALUES(?, ?, ?, ?)"));
+
+    for(const auto &sample : samples)
+    {
+      const qint64 id = getSeriesId(sample.obisNumber);
+      if(0 > id) continue;
+
+      sampleQuery.bindValue(0, m_ConnectionId);
+      sampleQuery.bindValue(1, id);
+      sampleQuery.bindValue(2, sample.timestamp);
+      sampleQuery.bindValue(3, sample.value);
+
+      Execute(sampleQuery, QString("SqliteSink::Worker::write()"));
+    }
+
+    QSqlQuery rollupQuery(database);
+    rollupQuery.prepare(QString("INSERT OR REPLACE INTO rollups(connection, obis, tier, start, average, min, max, "
+                                "count) VALUES(?, ?, ?, ?, ?, ?, ?, ?)"));
+
+    for(const auto &rollup : rollups)
+    {
+      const qint64 id = getSeriesId(rollup.obisNumber);
+      if(0 > id) continue;
+
+      rollupQuery.bindValue(0, m_ConnectionId);
+      rollupQuery.bindValue(1, id);
+      rollupQuery.bindValue(2, rollup.tier);
+      rollupQuery.bindValue(3, rollup.bucket.start);
+      rollupQuery.bindValue(4, rollup.bucket.average());
+      rollupQuery.bindValue(5, rollup.bucket.min);
+      rollupQuery.bindValue(6, rollup.bucket.max);
+      rollupQuery.bindValue(7, rollup.bucket.count);
+
+      Execute(rollupQuery, QString("SqliteSink::Worker::write()"));
+    }
+
+    QSqlQuery eventQuery(database);
+    eventQuery.prepare(QString("INSERT OR REPLACE INTO steps(connection, obis, timestamp, event, magnitude, "
+                               "before_level, after_level, duration) VALUES(?, ?, ?, ?, ?, ?, ?, ?)"));
+
+    for(const auto &row : events)
+    {
+      const qint64 id = getSeriesId(row.obisNumber);
+      if(0 > id) continue;
+
+      eventQuery.bindValue(0, m_ConnectionId);
+      eventQuery.bindValue(1, id);
+      eventQuery.bindValue(2, row.event.timestamp);
+      eventQuery.bindValue(3, QString((true == row.event.on) ? "on" : "off"));
+      eventQuery.bindValue(4, row.event.magnitude);
+      eventQuery.bindValue(5, row.event.before);
+      eventQuery.bindValue(6, row.event.after);
+      eventQuery.bindValue(7, (0 <= row.event.duration) ? QVariant(row.event.duration) : QVariant());
+
+      Execute(eventQuery, QString("SqliteSink::Worker::write()"));
+    }
+
+    if(false == database.commit())
+    {
+      qCritical() << "SqliteSink::Worker::write() commit failed:" << database.lastError().text();
+      database.rollback();
+    }
+  }
+
+  void expire(const qint64 &rawCutoff, const QHash<QString, qint64> &tierCutoffs)
+  {
+    if(0 > m_ConnectionId) return;
+
+    auto database = QSqlDatabase::database(m_DatabaseConnection, false);
+    database.transaction();
+
+    if(0 < rawCutoff)
+    {
+      QSqlQuery query(database);
+      query.prepare(QString("DELETE FROM samples WHERE connection = ? AND timestamp < ?"));
+      query.addBindValue(m_ConnectionId);
+      query.addBindValue(rawCutoff);
+
+      Execute(query, QString("SqliteSink::Worker::expire()"));
+    }
+
+    for(auto it = tierCutoffs.cbegin(); it != tierCutoffs.cend(); ++it)
+    {
+      QSqlQuery query(database);
+      query.prepare(QString("DELETE FROM rollups WHERE connection = ? AND tier = ? AND start < ?"));
+      query.addBindValue(m_ConnectionId);
+      query.addBindValue(it.key());
+      query.addBindValue(it.value());
+
+      Execute(query, QString("SqliteSink::Worker::expire()"));
+    }
+
+    database.commit();
+  }
+
+private:
+
+  /*
+   * Returns the key of the given obis number within this connection and registers the series if required
+   */
+  qint64 getSeriesId(const QString &obisNumber)
+  {
+    const auto it = m_SeriesIds.constFind(obisNumber);
+    if(it != m_SeriesIds.cend()) return it.value();
+
+    auto database = QSqlDatabase::database(m_DatabaseConnection, false);
+
+    qint64 id = -1;
+
+    QSqlQuery select(database);
+    select.prepare(QString("SELECT obis FROM series WHERE connection = ? AND name = ?"));
+    select.addBindValue(m_ConnectionId);
+    select.addBindValue(obisNumber);
+
+    if((true == Execute(select, QString("SqliteSink::Worker::getSeriesId()"))) && (true == select.next()))
+    {
+      id = select.value(0).toLongLong();
+    }
+    else
+    {
+      id = PackObisNumber(obisNumber);
+
+      if(0 > id)
+      {
+        QSqlQuery next(database);
+        next.prepare(QString("SELECT MAX(obis) FROM series WHERE connection = ?"));
+        next.addBindValue(m_ConnectionId);
+
+        const bool found = (true == Execute(next, QString("SqliteSink::Worker::getSeriesId()"))) && next.next();
+        id = qMax(cFirstUnpackedId, ((true == found) ? next.value(0).toLongLong() : 0) + 1);
+      }
+
+      QSqlQuery insert(database);
+      insert.prepare(QString("INSERT INTO series(connection, obis, name) VALUES(?, ?, ?)"));
+      insert.addBindValue(m_ConnectionId);
+      insert.addBindValue(id);
+      insert.addBindValue(obisNumber);
+
+      if(false == Execute(insert, QString("SqliteSink::Worker::getSeriesId()"))) return -1;
+    }
+
+    m_SeriesIds.insert(obisNumber, id);
+
+    return id;
+  }
+
+  QString m_DatabasePath;
+  QString m_ConnectionName;
+  QString m_DatabaseConnection;
+  qint64 m_ConnectionId;
+  QHash<QString, qint64> m_SeriesIds;
+};
+
+const int SqliteSink::cBatchSize = 512;
+const int SqliteSink::cFlushIntervalMs = 500;
+
+SqliteSink::SqliteSink(const QString &connectionName, const QDir &directory, QObject *parent)
+  : StorageSink(parent)
+  , m_ConnectionName(connectionName)
+  , m_DatabasePath(directory.absoluteFilePath(cDatabaseFileName))
+  , m_Retention()
+  , m_PendingSamples()
+  , m_PendingRollups()
+  , m_PendingEvents()
+  , m_FlushTimer(new QTimer(this))
+  , m_RetentionTimer(new QTimer(this))
+  , m_Thread(new QThread(this))
+  , m_Worker(new Worker(m_DatabasePath, connectionName))
+{
+  m_PendingSamples.reserve(cBatchSize);
+
+  m_Worker->moveToThread(m_Thread);
+  m_Thread->start();
+
+  auto worker = m_Worker;
+  QMetaObject::invokeMethod(m_Worker, [worker]() { worker->open(); }, Qt::QueuedConnection);
+
+  //the timer only runs while values are pending, an idle sink causes no wakeups
+  m_FlushTimer->setSingleShot(true);
+
+  connect(m_FlushTimer, &QTimer::timeout, this, &SqliteSink::flush);
+  connect(m_RetentionTimer, &QTimer::timeout, this, &SqliteSink::applyRetention);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+SqliteSink::~SqliteSink()
+{
+  flush();
+
+  auto worker = m_Worker;
+  //wait until all queued batches are written, quitting the thread would drop them
+  QMetaObject::invokeMethod(m_Worker, [worker]() { worker->close(); }, Qt::BlockingQueuedConnection);
+
+  m_Thread->quit();
+  m_Thread->wait();
+
+  delete m_Worker;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+StorageBackend SqliteSink::getBackend() const
+{
+  return StorageBackend::eSqlite;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QString SqliteSink::getDatabasePath() const
+{
+  return m_DatabasePath;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SqliteSink::setRetention(const RollupConfiguration &configuration)
+{
+  m_Retention = configuration;
+
+  m_RetentionTimer->start(cRetentionIntervalMs);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+ObisSampleList SqliteSink::readRange(const QString &obisNumber, const qint64 &from, const qint64 &to) const
+{
+  ObisSampleList samples;
+
+  //declared before the query, so the query is destroyed first
+  const ReadDatabase database(m_DatabasePath);
+  if(false == database.get().isOpen()) return samples;
+
+  QSqlQuery query(database.get());
+  query.setForwardOnly(true);
+  query.prepare(QString("SELECT s.timestamp, s.value FROM samples s "
+                        "JOIN connections c ON c.id = s.connection "
+                        "JOIN series r ON r.connection = s.connection AND r.obis = s.obis "
+                        "WHERE c.name = ? AND r.name = ? AND s.timestamp BETWEEN ? AND ? "
+                        "ORDER BY s.timestamp"));
+  query.addBindValue(m_ConnectionName);
+  query.addBindValue(obisNumber);
+  query.addBindValue(from);
+  query.addBindValue(to);
+
+  if(false == Execute(query, QString("SqliteSink::readRange()"))) return samples;
+
+  while(true == query.next())
+  {
+    bool ok{};
+    const double value = query.value(1).toDouble(&ok);
+
+    if(true == ok) samples.append(qMakePair(query.value(0).toLongLong(), value));
+  }
+
+  return samples;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+qint64 SqliteSink::getFirstTimestamp(const QString &obisNumber) const
+{
+  const ReadDatabase database(m_DatabasePath);
+  if(false == database.get().isOpen()) return -1;
+
+  QSqlQuery query(database.get());
+  query.prepare(QString("SELECT MIN(s.timestamp) FROM samples s "
+                        "JOIN connections c ON c.id = s.connection "
+                        "JOIN series r ON r.connection = s.connection AND r.obis = s.obis "
+                        "WHERE c.name = ? AND r.name = ?"));
+  query.addBindValue(m_ConnectionName);
+  query.addBindValue(obisNumber);
+
+  if(false == Execute(query, QString("SqliteSink::getFirstTimestamp()"))) return -1;
+
+  //MIN() of no rows is NULL
+  if((false == query.next()) || (true == query.value(0).isNull())) return -1;
+
+  return query.value(0).toLongLong();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QVector<RollupBucket> SqliteSink::readRollups(const QString &obisNumber,
+                                              const QString &tierName,
+                                              const qint64 &from,
+                                              const qint64 &to) const
+{
+  QVector<RollupBucket> buckets;
+
+  //declared before the query, so the query is destroyed first
+  const ReadDatabase database(m_DatabasePath);
+  if(false == database.get().isOpen()) return buckets;
+
+  QSqlQuery query(database.get());
+  query.setForwardOnly(true);
+  query.prepare(QString("SELECT u.start, u.average, u.min, u.max, u.count FROM rollups u "
+                        "JOIN connections c ON c.id = u.connection "
+                        "JOIN series r ON r.connection = u.connection AND r.obis = u.obis "
+                        "WHERE c.name = ? AND r.name = ? AND u.tier = ? AND u.start BETWEEN ? AND ? "
+                        "ORDER BY u.start"));
+  query.addBindValue(m_ConnectionName);
+  query.addBindValue(obisNumber);
+  query.addBindValue(tierName);
+  query.addBindValue(from);
+  query.addBindValue(to);
+
+  if(false == Execute(query, QString("SqliteSink::readRollups()"))) return buckets;
+
+  while(true == query.next())
+  {
+    RollupBucket bucket(query.value(0).toLongLong());
+    bucket.min = query.value(2).toDouble();
+    bucket.max = query.value(3).toDouble();
+    bucket.count = query.value(4).toULongLong();
+
+    //the hold time is not stored, the count is used as weight instead
+    bucket.weight = qMax<qint64>(1, static_cast<qint64>(bucket.count));
+    bucket.weightedSum = query.value(1).toDouble() * static_cast<double>(bucket.weight);
+
+    buckets.append(bucket);
+  }
+
+  return buckets;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SqliteSink::addMapping(const ObisValueMapping &mapping)
+{
+  if(false == mapping.isValid()) return;
+
+  auto worker = m_Worker;
+  const auto obisNumber = mapping.obisNumber;
+  const auto unit = mapping.unit;
+
+  QMetaObject::invokeMethod(m_Worker, [worker, obisNumber, unit]() { worker->addSeries(obisNumber, unit); },
+                            Qt::QueuedConnection);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SqliteSink::removeMapping(const ObisValueMapping &)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool SqliteSink::write(const QString &obisNumber, const qint64 &timestamp, const QVariant &dataValue, const QString &)
+{
+  m_PendingSamples.append(SampleRow{obisNumber, timestamp, dataValue});
+
+  if(cBatchSize <= m_PendingSamples.size())
+  {
+    flush();
+  }
+  else if(false == m_FlushTimer->isActive())
+  {
+    m_FlushTimer->start(cFlushIntervalMs);
+  }
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool SqliteSink::writeRollup(const QString &obisNumber, const RollupTier &tier, const RollupBucket &bucket)
+{
+  if(false == bucket.isValid()) return false;
+
+  m_PendingRollups.append(RollupRow{obisNumber, tier.name, bucket});
+
+  if(false == m_FlushTimer->isActive()) m_FlushTimer->start(cFlushIntervalMs);
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+bool SqliteSink::writeEvent(const QString &obisNumber, const StepEvent &event)
+{
+  m_PendingEvents.append(EventRow{obisNumber, event});
+
+  if(false == m_FlushTimer->isActive()) m_FlushTimer->start(cFlushIntervalMs);
+
+  return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SqliteSink::flush()
+{
+  const WatchdogScope scope("SqliteSink::flush()");
+
+  m_FlushTimer->stop();
+
+  if((true == m_PendingSamples.isEmpty()) && (true == m_PendingRollups.isEmpty()) &&
+     (true == m_PendingEvents.isEmpty()))
+  {
+    return;
+  }
+
+  auto worker = m_Worker;
+  const auto samples = m_PendingSamples;
+  const auto rollups = m_PendingRollups;
+  const auto events = m_PendingEvents;
+
+  QMetaObject::invokeMethod(m_Worker, [worker, samples, rollups, events]() { worker->write(samples, rollups, events); },
+                            Qt::QueuedConnection);
+
+  m_PendingSamples.clear();
+  m_PendingSamples.reserve(cBatchSize);
+  m_PendingRollups.clear();
+  m_PendingEvents.clear();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void SqliteSink::applyRetention()
+{
+  const WatchdogScope scope("SqliteSink::applyRetention()");
+
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+  const qint64 rawCutoff = (true == m_Retention.rawRetention.isValid())
+                           ? now - static_cast<qint64>(m_Retention.rawRetention.toMilliseconds())
+                           : 0;
+
+  QHash<QString, qint64> tierCutoffs;
+  for(const auto &tier : m_Retention.tiers)
+  {
+    if(false == tier.retention.isValid()) continue;
+
+    tierCutoffs.insert(tier.name, now - static_cast<qint64>(tier.retention.toMilliseconds()));
+  }
+
+  auto worker = m_Worker;
+  QMetaObject::invokeMethod(m_Worker, [worker, rawCutoff, tierCutoffs]() { worker->expire(rawCutoff, tierCutoffs); },
+                            Qt::QueuedConnection);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
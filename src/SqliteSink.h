@@ -0,0 +1,245 @@
+#pragma once
+
+#include <QDir>
+#include <QHash>
+#include <QTimer>
+#include <QThread>
+#include <QVector>
+
+#include "StorageSink.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The SqliteSink class stores the values of a single connection in a shared SQLite database
+ *
+ * All connections share the "ssmr.sqlite" database in the log directory, which is run in WAL mode so external tools can
+ * query it while values are written. Values are collected on the calling thread and written in batched transactions by
+ * a worker on a background thread.
+ *
+ * Samples are keyed by the connection id and the packed obis number (see PackObisNumber) with a covering index on the
+ * time, the "series" table maps the keys back to the obis numbers:
+ *
+ *   connections(id, name)
+ *   series(connection, obis, name, unit)
+ *   samples(connection, obis, timestamp, value)
+ *   rollups(connection, obis, tier, start, average, min, max, count)
+ */
+class SqliteSink : public StorageSink
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief cBatchSize Pending values are written as soon as this many are collected
+	 */
+	static const int cBatchSize;
+
+	/**
+	 * @brief cFlushIntervalMs Pending values are written at most this long after the first of them was queued
+	 */
+	static const int cFlushIntervalMs;
+
+	/**
+	 * @brief SqliteSink Constructor
+	 * @param connectionName The name of the connection, used as key within the database
+	 * @param directory Where to store the database
+	 * @param parent
+	 */
+	explicit SqliteSink(const QString &connectionName, const QDir &directory, QObject *parent = nullptr);
+
+	/**
+	 * @brief ~SqliteSink Destructor, writes all pending values before the worker is stopped
+	 */
+	virtual ~SqliteSink() override;
+
+	/**
+	 * @brief getBackend
+	 * @return Always StorageBackend::eSqlite
+	 */
+	virtual StorageBackend getBackend() const override;
+
+	/**
+	 * @brief getDatabasePath
+	 * @return The path of the database file
+	 */
+	QString getDatabasePath() const;
+
+	/**
+	 * @brief setRetention Set the retention of the raw values and rollup tiers, expired rows are deleted periodically
+	 * @param configuration
+	 */
+	virtual void setRetention(const RollupConfiguration &configuration) override;
+
+	/**
+	 * @brief readRange Read the stored raw samples of the given obis number within [from, to]
+	 * @param obisNumber
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @return The numeric samples in time order, values not yet written by the worker are not included
+	 *
+	 * This can be called from any thread, each thread uses its own database connection.
+	 */
+	virtual ObisSampleList readRange(const QString &obisNumber, const qint64 &from, const qint64 &to) const override;
+
+	/**
+	 * @brief getFirstTimestamp
+	 * @param obisNumber
+	 * @return The time of the oldest written sample, -1 if there is none
+	 */
+	virtual qint64 getFirstTimestamp(const QString &obisNumber) const override;
+
+	/**
+	 * @brief readRollups Read the buckets of the given rollup tier which start within [from, to]
+	 * @param obisNumber
+	 * @param tierName
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @return The buckets in time order, buckets not yet written by the worker are not included
+	 */
+	virtual QVector<RollupBucket> readRollups(const QString &obisNumber,
+																						const QString &tierName,
+																						const qint64 &from,
+																						const qint64 &to) const override;
+
+public slots:
+
+	/**
+	 * @brief addMapping Register the series of the given mapping
+	 * @param mapping
+	 */
+	virtual void addMapping(const ObisValueMapping &mapping) override;
+
+	/**
+	 * @brief removeMapping Nothing to do, the stored values are kept
+	 * @param mapping
+	 */
+	virtual void removeMapping(const ObisValueMapping &mapping) override;
+
+	/**
+	 * @brief write Queue a single raw value for the next batch
+	 * @param obisNumber
+	 * @param timestamp Time in milliseconds since epoch
+	 * @param dataValue
+	 * @param unit
+	 * @return Always true
+	 */
+	virtual bool write(const QString &obisNumber,
+										 const qint64 &timestamp,
+										 const QVariant &dataValue,
+										 const QString &unit) override;
+
+	/**
+	 * @brief writeRollup Queue a closed rollup bucket for the next batch
+	 * @param obisNumber
+	 * @param tier
+	 * @param bucket
+	 * @return False for empty buckets
+	 */
+	virtual bool writeRollup(const QString &obisNumber, const RollupTier &tier, const RollupBucket &bucket) override;
+
+	/**
+	 * @brief writeEvent Queue a detected step for the next batch
+	 * @param obisNumber
+	 * @param event
+	 * @return Always true
+	 */
+	virtual bool writeEvent(const QString &obisNumber, const StepEvent &event) override;
+
+	/**
+	 * @brief flush Hand all pending values to the worker
+	 */
+	void flush();
+
+	/**
+	 * @brief applyRetention Delete expired rows of this connection
+	 */
+	void applyRetention();
+
+private:
+
+	class Worker;
+
+	/**
+	 * @brief The SampleRow struct A single queued raw value
+	 */
+	struct SampleRow
+	{
+		QString obisNumber;
+		qint64 timestamp;
+		QVariant value;
+	};
+
+	/**
+	 * @brief The RollupRow struct A single queued rollup bucket
+	 */
+	struct RollupRow
+	{
+		QString obisNumber;
+		QString tier;
+		RollupBucket bucket;
+	};
+
+	/**
+	 * @brief The EventRow struct A single queued step
+	 */
+	struct EventRow
+	{
+		QString obisNumber;
+		StepEvent event;
+	};
+
+	/**
+	 * @brief m_ConnectionName The name of the connection
+	 */
+	QString m_ConnectionName;
+
+	/**
+	 * @brief m_DatabasePath The database file
+	 */
+	QString m_DatabasePath;
+
+	/**
+	 * @brief m_Retention How long raw values and rollups are kept
+	 */
+	RollupConfiguration m_Retention;
+
+	/**
+	 * @brief m_PendingSamples Raw values not yet handed to the worker
+	 */
+	QVector<SampleRow> m_PendingSamples;
+
+	/**
+	 * @brief m_PendingRollups Rollup buckets not yet handed to the worker
+	 */
+	QVector<RollupRow> m_PendingRollups;
+
+	/**
+	 * @brief m_PendingEvents Steps not yet handed to the worker
+	 */
+	QVector<EventRow> m_PendingEvents;
+
+	/**
+	 * @brief m_FlushTimer Hands pending values to the worker, single shot and only started while values are pending
+	 */
+	QTimer* m_FlushTimer;
+
+	/**
+	 * @brief m_RetentionTimer Periodically deletes expired rows
+	 */
+	QTimer* m_RetentionTimer;
+
+	/**
+	 * @brief m_Thread The thread the worker lives in
+	 */
+	QThread* m_Thread;
+
+	/**
+	 * @brief m_Worker Owns the writing database connection
+	 */
+	Worker* m_Worker;
+};
+
+}
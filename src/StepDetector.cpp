@@ -0,0 +1,168 @@
+#include "StepDetector.h"
+
+#include <QtMath>
+
+namespace Ssmr
+{
+
+namespace
+{
+  //the level follows the series with the mean of at most this many values, so it can follow drift
+  const int cLevelWindow = 16;
+
+  //a step has to hold for at least this many values, a single spike is no step
+  const int cMinStepValues = 2;
+
+  //a decrease matches an increase if their magnitudes differ by at most this fraction
+  const double cMatchTolerance = 0.2;
+}
+
+const int StepDetector::cMaxOpenSteps = 8;
+
+StepDetectorConfiguration StepDetectorConfiguration::Load(QSettings &settings)
+{
+  StepDetectorConfiguration configuration;
+
+  settings.beginGroup("steps");
+
+  configuration.obisNumbers = settings.value("obis", configuration.obisNumbers).toStringList();
+  configuration.minimum = settings.value("minimum", configuration.minimum).toDouble();
+
+  settings.endGroup();
+
+  return configuration;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+StepDetectorConfiguration::StepDetectorConfiguration()
+  : obisNumbers({QString("1-0:16.7.0*255")})
+  , minimum(100.0)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+StepDetector::StepDetector(const double &minimum)
+  : m_Minimum(qMax(0.0, minimum))
+  , m_Level(0.0)
+  , m_LevelCount(0)
+  , m_Increase{0.0, -1, 0.0, 0}
+  , m_Decrease{0.0, -1, 0.0, 0}
+  , m_OpenSteps()
+  , m_StepCallback()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void StepDetector::setStepCallback(const StepCallback &callback)
+{
+  m_StepCallback = callback;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void StepDetector::addSample(const qint64 &timestamp, const double &value)
+{
+  if(true == qIsNaN(value)) return;
+
+  if(0 == m_LevelCount)
+  {
+    m_Level = value;
+    m_LevelCount = 1;
+    return;
+  }
+
+  const double deviation = value - m_Level;
+
+  update(m_Increase, deviation, timestamp, value);
+  update(m_Decrease, -deviation, timestamp, value);
+
+  for(const Cusum* cusum : {&m_Increase, &m_Decrease})
+  {
+    if((cusum->sum <= m_Minimum) || (cMinStepValues > cusum->count)) continue;
+
+    //a spike also exceeds the threshold, the step is accepted once a value agrees with the new level
+    const double mean = cusum->valueSum / static_cast<double>(cusum->count);
+    if(qAbs(value - mean) > m_Minimum / 2.0) continue;
+
+    accept(*cusum);
+    return;
+  }
+
+  //the level is only followed while it holds, a step in progress must not pull it along
+  if((0.0 >= m_Increase.sum) && (0.0 >= m_Decrease.sum))
+  {
+    m_LevelCount = qMin(m_LevelCount + 1, cLevelWindow);
+    m_Level += (value - m_Level) / static_cast<double>(m_LevelCount);
+  }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void StepDetector::reset()
+{
+  m_Level = 0.0;
+  m_LevelCount = 0;
+  m_Increase = Cusum{0.0, -1, 0.0, 0};
+  m_Decrease = Cusum{0.0, -1, 0.0, 0};
+  m_OpenSteps.clear();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void StepDetector::update(Cusum &cusum, const double &deviation, const qint64 &timestamp, const double &value) const
+{
+  const double sum = cusum.sum + deviation - m_Minimum / 2.0;
+
+  if(0.0 >= sum)
+  {
+    cusum = Cusum{0.0, -1, 0.0, 0};
+    return;
+  }
+
+  if(0.0 >= cusum.sum) cusum = Cusum{0.0, timestamp, 0.0, 0};
+
+  cusum.sum = sum;
+  cusum.valueSum += value;
+  ++cusum.count;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void StepDetector::accept(const Cusum &cusum)
+{
+  const double after = cusum.valueSum / static_cast<double>(cusum.count);
+  const double magnitude = after - m_Level;
+
+  StepEvent event{cusum.start, (0.0 < magnitude), m_Level, after, magnitude, -1};
+
+  m_Level = after;
+  m_LevelCount = qMin(cusum.count, cLevelWindow);
+  m_Increase = Cusum{0.0, -1, 0.0, 0};
+  m_Decrease = Cusum{0.0, -1, 0.0, 0};
+
+  //smaller changes which cumulated over time are drift, the level just follows them
+  if(qAbs(magnitude) < m_Minimum) return;
+
+  if(true == event.on)
+  {
+    m_OpenSteps.append(event);
+    if(m_OpenSteps.size() > cMaxOpenSteps) m_OpenSteps.removeFirst();
+  }
+  else
+  {
+    int match = -1;
+    double difference = qMax(m_Minimum / 2.0, cMatchTolerance * -magnitude);
+
+    for(int i = 0; i < m_OpenSteps.size(); ++i)
+    {
+      const double d = qAbs(m_OpenSteps.at(i).magnitude + magnitude);
+      if(d > difference) continue;
+
+      match = i;
+      difference = d;
+    }
+
+    if(0 <= match) event.duration = event.timestamp - m_OpenSteps.takeAt(match).timestamp;
+  }
+
+  if(nullptr != m_StepCallback) m_StepCallback(event);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
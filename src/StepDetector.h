@@ -0,0 +1,164 @@
+#pragma once
+
+#include <functional>
+
+#include <QList>
+#include <QString>
+#include <QSettings>
+#include <QStringList>
+
+namespace Ssmr
+{
+
+/**
+ * @brief The StepDetectorConfiguration struct describes which series are watched for switched appliances
+ */
+struct StepDetectorConfiguration
+{
+	/**
+	 * @brief Load Read the configuration from the "steps" group of the given settings
+	 * @param settings
+	 * @return The loaded configuration, the defaults are used for everything not configured
+	 */
+	static StepDetectorConfiguration Load(QSettings &settings);
+
+	StepDetectorConfiguration();
+
+	//!The momentary power series to watch
+	QStringList obisNumbers;
+
+	//!The smallest step which is reported, in the unit of the series. Smaller changes are followed as drift.
+	double minimum;
+};
+
+/**
+ * @brief The StepEvent struct describes a single detected step
+ */
+struct StepEvent
+{
+	//!When the step started in milliseconds since epoch
+	qint64 timestamp;
+
+	//!True for an increase, e.g. an appliance switched on
+	bool on;
+
+	//!The level before and after the step and their difference
+	double before;
+	double after;
+	double magnitude;
+
+	//!For a decrease the time since the matching increase in milliseconds, -1 if there is none
+	qint64 duration;
+};
+
+/**
+ * @brief The StepDetector class detects step changes of a single series while the values are received
+ *
+ * A two sided CUSUM is run against the level of the series. The allowed slack is half of the minimum step and a change
+ * is signalled once the cumulated deviation exceeds the minimum step. The new level is the mean of the values since
+ * the deviation started, the step is only accepted once a value agrees with it, so single spikes are ignored.
+ * Decreases are matched to the open increase of the most similar magnitude to report how long an appliance was on.
+ * Each value is processed in constant time and the memory is bounded.
+ */
+class StepDetector
+{
+public:
+
+	/**
+	 * @brief StepCallback Called for every detected step
+	 */
+	typedef std::function<void(const StepEvent &event)> StepCallback;
+
+	/**
+	 * @brief cMaxOpenSteps How many increases are kept to be matched with a decrease, the oldest is dropped first
+	 */
+	static const int cMaxOpenSteps;
+
+	/**
+	 * @brief StepDetector Constructor
+	 * @param minimum The smallest step which is reported
+	 */
+	explicit StepDetector(const double &minimum = StepDetectorConfiguration().minimum);
+
+	/**
+	 * @brief setStepCallback
+	 * @param callback
+	 */
+	void setStepCallback(const StepCallback &callback);
+
+	/**
+	 * @brief addSample Add a received value
+	 * @param timestamp Time in milliseconds since epoch
+	 * @param value NaN is ignored
+	 */
+	void addSample(const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief reset Forget the level and the open increases, e.g. when the connection was closed
+	 */
+	void reset();
+
+private:
+
+	/**
+	 * @brief The Cusum struct contains one side of the CUSUM
+	 */
+	struct Cusum
+	{
+		//!The cumulated deviation beyond the slack, 0 while the level holds
+		double sum;
+
+		//!Since when the deviation cumulates and the mean of the values since then
+		qint64 start;
+		double valueSum;
+		int count;
+	};
+
+	/**
+	 * @brief update Update one side of the CUSUM
+	 * @param cusum
+	 * @param deviation The deviation of the value from the level in the direction of this side
+	 * @param timestamp
+	 * @param value
+	 */
+	void update(Cusum &cusum, const double &deviation, const qint64 &timestamp, const double &value) const;
+
+	/**
+	 * @brief accept Report the step signalled by the given side and move the level to it
+	 * @param cusum
+	 */
+	void accept(const Cusum &cusum);
+
+	/**
+	 * @brief m_Minimum The smallest step which is reported
+	 */
+	double m_Minimum;
+
+	/**
+	 * @brief m_Level The current level of the series and how many values it is averaged over
+	 */
+	double m_Level;
+	int m_LevelCount;
+
+	/**
+	 * @brief m_Increase The CUSUM of increases
+	 */
+	Cusum m_Increase;
+
+	/**
+	 * @brief m_Decrease The CUSUM of decreases
+	 */
+	Cusum m_Decrease;
+
+	/**
+	 * @brief m_OpenSteps The increases without a matching decrease yet, the oldest first
+	 */
+	QList<StepEvent> m_OpenSteps;
+
+	/**
+	 * @brief m_StepCallback
+	 */
+	StepCallback m_StepCallback;
+};
+
+}
@@ -0,0 +1,56 @@
+#include "StorageSink.h"
+
+#include "CsvSink.h"
+#include "SqliteSink.h"
+#include "HelpFunctions.h"
+
+namespace Ssmr
+{
+
+StorageSink* CreateStorageSink(const ConnectionData &data, QObject *parent)
+{
+  switch(data.storage)
+  {
+    case StorageBackend::eSqlite: return new SqliteSink(data.name, GetLogDirectory(), parent);
+    case StorageBackend::eCsv: break;
+  }
+
+  return new CsvSink(data.name, GetLogDirectory(), parent);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+StorageSink::StorageSink(QObject *parent)
+  : QObject(parent)
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+StorageSink::~StorageSink()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QList<QPair<qint64, qint64>> StorageSink::getSegments(const QString &,
+                                                     const qint64 &from,
+                                                     const qint64 &to,
+                                                     int count,
+                                                     const ValueRange &) const
+{
+  QList<QPair<qint64, qint64>> segments;
+  if(from > to) return segments;
+
+  const qint64 length = qMax<qint64>(1, (to - from) / qMax(1, count) + 1);
+
+  for(qint64 start = from; start <= to; start += length)
+  {
+    segments.append(qMakePair(start, qMin(to, start + length - 1)));
+
+    //do not overflow at the end of the time range
+    if(to - start < length) break;
+  }
+
+  return segments;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <QObject>
+#include <QVariant>
+
+#include <memory>
+
+#include "Rollup.h"
+#include "StepDetector.h"
+#include "TypeDefinitions.h"
+
+namespace Ssmr
+{
+
+class StorageSink;
+
+typedef std::shared_ptr<StorageSink> StorageSinkPtr;
+
+/**
+ * @brief CreateStorageSink Create the storage sink selected in the given connection data
+ * @param data
+ * @param parent
+ * @return The new sink instance
+ */
+extern StorageSink* CreateStorageSink(const ConnectionData &data, QObject* parent = nullptr);
+
+/**
+ * @brief The StorageSink class is the interface of all places the values of a single connection are stored at
+ */
+class StorageSink : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief StorageSink Constructor
+	 * @param parent
+	 */
+	explicit StorageSink(QObject *parent = nullptr);
+
+	/**
+	 * @brief ~StorageSink Destructor
+	 */
+	virtual ~StorageSink() override;
+
+	/**
+	 * @brief getBackend
+	 * @return Which backend is implemented by this sink
+	 */
+	virtual StorageBackend getBackend() const = 0;
+
+	/**
+	 * @brief setRetention Set the retention of the raw values and rollup tiers, expired values are removed periodically
+	 * @param configuration
+	 */
+	virtual void setRetention(const RollupConfiguration &configuration) = 0;
+
+	/**
+	 * @brief readRange Read the stored raw samples of the given obis number within [from, to]
+	 * @param obisNumber
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @return The samples in time order
+	 */
+	virtual ObisSampleList readRange(const QString &obisNumber, const qint64 &from, const qint64 &to) const = 0;
+
+	/**
+	 * @brief getFirstTimestamp
+	 * @param obisNumber
+	 * @return The time of the oldest stored raw sample of the given obis number, -1 if nothing was stored
+	 */
+	virtual qint64 getFirstTimestamp(const QString &obisNumber) const = 0;
+
+	/**
+	 * @brief readRollups Read the stored buckets of the given rollup tier which start within [from, to]
+	 * @param obisNumber
+	 * @param tierName
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @return The buckets in time order, only start, min, max, count and the average are restored
+	 */
+	virtual QVector<RollupBucket> readRollups(const QString &obisNumber,
+																						const QString &tierName,
+																						const qint64 &from,
+																						const qint64 &to) const = 0;
+
+	/**
+	 * @brief getSegments Split [from, to] into disjoint time ranges which can be read in parallel
+	 * @param obisNumber
+	 * @param from Time in milliseconds since epoch
+	 * @param to Time in milliseconds since epoch
+	 * @param count The maximum number of segments
+	 * @param values Sinks with stored value statistics leave out the time which cannot contain values in this range
+	 * @return The segments in time order, each with inclusive bounds
+	 *
+	 * The default implementation splits the range into equally long segments and ignores the value range. Both
+	 * readRange and readRollups have to be callable from any thread for this.
+	 */
+	virtual QList<QPair<qint64, qint64>> getSegments(const QString &obisNumber,
+																									 const qint64 &from,
+																									 const qint64 &to,
+																									 int count,
+																									 const ValueRange &values = {}) const;
+
+public slots:
+
+	/**
+	 * @brief addMapping Prepare the storage for the given mapping
+	 * @param mapping
+	 */
+	virtual void addMapping(const ObisValueMapping &mapping) = 0;
+
+	/**
+	 * @brief removeMapping Stop storing the given mapping, already stored values are kept
+	 * @param mapping
+	 */
+	virtual void removeMapping(const ObisValueMapping &mapping) = 0;
+
+	/**
+	 * @brief write Store a single raw value
+	 * @param obisNumber
+	 * @param timestamp Time in milliseconds since epoch
+	 * @param dataValue
+	 * @param unit
+	 * @return True if the value was accepted
+	 */
+	virtual bool write(const QString &obisNumber,
+										 const qint64 &timestamp,
+										 const QVariant &dataValue,
+										 const QString &unit) = 0;
+
+	/**
+	 * @brief writeRollup Store a closed rollup bucket
+	 * @param obisNumber
+	 * @param tier
+	 * @param bucket
+	 * @return True if the bucket was accepted
+	 */
+	virtual bool writeRollup(const QString &obisNumber, const RollupTier &tier, const RollupBucket &bucket) = 0;
+
+	/**
+	 * @brief writeEvent Store a detected step of a series
+	 * @param obisNumber
+	 * @param event
+	 * @return True if the event was accepted
+	 */
+	virtual bool writeEvent(const QString &obisNumber, const StepEvent &event) = 0;
+};
+
+}
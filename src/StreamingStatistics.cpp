@@ -0,0 +1,201 @@
+#include "StreamingStatistics.h"
+
+#include <QtMath>
+
+namespace Ssmr
+{
+
+const int StreamingStatistics::cPaneCount = 12;
+
+StreamingStatistics::StreamingStatistics(const Duration &window)
+  : m_Window(window)
+  , m_Values()
+  , m_MinDeque()
+  , m_MaxDeque()
+  , m_Mean(0.0)
+  , m_SquaredDeviations(0.0)
+  , m_Ewma(qQNaN())
+  , m_LastTimestamp(-1)
+  , m_Panes()
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+const Duration &StreamingStatistics::getWindow() const
+{
+  return m_Window;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void StreamingStatistics::addSample(const qint64 &timestamp, const double &value)
+{
+  if((false == m_Window.isValid()) || (true == qIsNaN(value))) return;
+
+  expire(timestamp);
+
+  const double windowMs = static_cast<double>(m_Window.toMilliseconds());
+
+  //the weight of the new value grows with the time since the last one, so irregular readings are handled correctly
+  if((0 > m_LastTimestamp) || (true == qIsNaN(m_Ewma)))
+  {
+    m_Ewma = value;
+  }
+  else
+  {
+    const double elapsed = static_cast<double>(qMax<qint64>(0, timestamp - m_LastTimestamp));
+    m_Ewma += (1.0 - qExp(-elapsed / windowMs)) * (value - m_Ewma);
+  }
+
+  m_LastTimestamp = timestamp;
+
+  const ObisSample sample = qMakePair(timestamp, value);
+  m_Values.append(sample);
+
+  const double delta = value - m_Mean;
+  m_Mean += delta / static_cast<double>(m_Values.size());
+  m_SquaredDeviations += delta * (value - m_Mean);
+
+  //values which can never become the minimum or maximum again are dropped right away
+  while((false == m_MinDeque.isEmpty()) && (m_MinDeque.last().second >= value)) m_MinDeque.removeLast();
+  m_MinDeque.append(sample);
+
+  while((false == m_MaxDeque.isEmpty()) && (m_MaxDeque.last().second <= value)) m_MaxDeque.removeLast();
+  m_MaxDeque.append(sample);
+
+  const qint64 paneWidth = qMax<qint64>(1, static_cast<qint64>(m_Window.toMilliseconds()) / cPaneCount);
+  const qint64 paneStart = timestamp - (timestamp % paneWidth);
+
+  if((true == m_Panes.isEmpty()) || (m_Panes.last().start < paneStart))
+  {
+    m_Panes.append(Pane{paneStart, TDigest()});
+  }
+
+  m_Panes.last().digest.add(value);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void StreamingStatistics::reset()
+{
+  m_Values.clear();
+  m_MinDeque.clear();
+  m_MaxDeque.clear();
+  m_Mean = 0.0;
+  m_SquaredDeviations = 0.0;
+  m_Ewma = qQNaN();
+  m_LastTimestamp = -1;
+  m_Panes.clear();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int StreamingStatistics::getCount() const
+{
+  return m_Values.size();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double StreamingStatistics::getEwma() const
+{
+  return m_Ewma;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double StreamingStatistics::getMin() const
+{
+  return (true == m_MinDeque.isEmpty()) ? qQNaN() : m_MinDeque.first().second;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double StreamingStatistics::getMax() const
+{
+  return (true == m_MaxDeque.isEmpty()) ? qQNaN() : m_MaxDeque.first().second;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double StreamingStatistics::getMean() const
+{
+  return (true == m_Values.isEmpty()) ? qQNaN() : m_Mean;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double StreamingStatistics::getVariance() const
+{
+  if(2 > m_Values.size()) return qQNaN();
+
+  return m_SquaredDeviations / static_cast<double>(m_Values.size() - 1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double StreamingStatistics::getStandardDeviation() const
+{
+  return qSqrt(getVariance());
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double StreamingStatistics::getQuantile(const double &q) const
+{
+  return getDigest().quantile(q);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+QVector<double> StreamingStatistics::getLoadDurationCurve(int points) const
+{
+  QVector<double> curve;
+
+  const auto digest = getDigest();
+  if(0.0 >= digest.getCount()) return curve;
+
+  const int count = qMax(2, points);
+  curve.reserve(count);
+
+  for(int i = 0; i < count; ++i)
+  {
+    curve.append(digest.quantile(1.0 - static_cast<double>(i) / static_cast<double>(count - 1)));
+  }
+
+  return curve;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void StreamingStatistics::expire(const qint64 &now)
+{
+  const qint64 cutoff = now - static_cast<qint64>(m_Window.toMilliseconds());
+
+  while((false == m_Values.isEmpty()) && (m_Values.first().first <= cutoff))
+  {
+    const double value = m_Values.takeFirst().second;
+
+    if(true == m_Values.isEmpty())
+    {
+      m_Mean = 0.0;
+      m_SquaredDeviations = 0.0;
+      continue;
+    }
+
+    const double mean = m_Mean - (value - m_Mean) / static_cast<double>(m_Values.size());
+    m_SquaredDeviations = qMax(0.0, m_SquaredDeviations - (value - m_Mean) * (value - mean));
+    m_Mean = mean;
+  }
+
+  while((false == m_MinDeque.isEmpty()) && (m_MinDeque.first().first <= cutoff)) m_MinDeque.removeFirst();
+  while((false == m_MaxDeque.isEmpty()) && (m_MaxDeque.first().first <= cutoff)) m_MaxDeque.removeFirst();
+
+  //a pane is dropped once all of its time left the window
+  const qint64 paneWidth = qMax<qint64>(1, static_cast<qint64>(m_Window.toMilliseconds()) / cPaneCount);
+  while((false == m_Panes.isEmpty()) && (m_Panes.first().start + paneWidth <= cutoff)) m_Panes.removeFirst();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+TDigest StreamingStatistics::getDigest() const
+{
+  TDigest digest;
+
+  for(const auto &pane : m_Panes)
+  {
+    digest.merge(pane.digest);
+  }
+
+  return digest;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <QList>
+#include <QVector>
+
+#include "TDigest.h"
+#include "TypeDefinitions.h"
+
+namespace Ssmr
+{
+
+/**
+ * @brief The StreamingStatistics class maintains statistics over a sliding time window of a single series
+ *
+ * Every received value is processed in amortized constant time, nothing is read back from the stored history:
+ *
+ * - an exponentially weighted moving average with the window as time constant
+ * - the rolling minimum and maximum, using monotonic deques of the values within the window
+ * - the rolling mean and variance, using Welford's update which also supports removing values
+ * - quantiles and the load duration curve from t-digests. A t-digest cannot remove values, so the window is split
+ *   into panes with one digest each and the oldest pane is dropped as a whole. These statistics therefore cover up to
+ *   one pane more than the window.
+ */
+class StreamingStatistics
+{
+public:
+
+	/**
+	 * @brief cPaneCount Into how many panes the window of the quantiles is split
+	 */
+	static const int cPaneCount;
+
+	/**
+	 * @brief StreamingStatistics Constructor
+	 * @param window The sliding time window, no statistics are kept with an invalid window
+	 */
+	explicit StreamingStatistics(const Duration &window = {});
+
+	/**
+	 * @brief getWindow
+	 * @return The sliding time window
+	 */
+	const Duration &getWindow() const;
+
+	/**
+	 * @brief addSample Add a received value and drop the values which left the window
+	 * @param timestamp Time in milliseconds since epoch, values have to be added in time order
+	 * @param value NaN is ignored
+	 */
+	void addSample(const qint64 &timestamp, const double &value);
+
+	/**
+	 * @brief reset Forget all values
+	 */
+	void reset();
+
+	/**
+	 * @brief getCount
+	 * @return The number of values within the window
+	 */
+	int getCount() const;
+
+	/**
+	 * @brief getEwma
+	 * @return The exponentially weighted moving average, NaN without values
+	 */
+	double getEwma() const;
+
+	/**
+	 * @brief getMin
+	 * @return The smallest value within the window, NaN without values
+	 */
+	double getMin() const;
+
+	/**
+	 * @brief getMax
+	 * @return The largest value within the window, NaN without values
+	 */
+	double getMax() const;
+
+	/**
+	 * @brief getMean
+	 * @return The mean of the values within the window, NaN without values
+	 */
+	double getMean() const;
+
+	/**
+	 * @brief getVariance
+	 * @return The sample variance of the values within the window, NaN with less than two values
+	 */
+	double getVariance() const;
+
+	/**
+	 * @brief getStandardDeviation
+	 * @return The square root of the variance
+	 */
+	double getStandardDeviation() const;
+
+	/**
+	 * @brief getQuantile
+	 * @param q The quantile within [0, 1], e.g. 0.95 for the p95 load
+	 * @return The estimated quantile of the values within the window, NaN without values
+	 */
+	double getQuantile(const double &q) const;
+
+	/**
+	 * @brief getLoadDurationCurve
+	 * @param points The number of points of the curve, at least two
+	 * @return The values sorted from the highest to the lowest. Point i is the value exceeded during the fraction
+	 * i / (points - 1) of the window. Empty without values.
+	 */
+	QVector<double> getLoadDurationCurve(int points) const;
+
+private:
+
+	/**
+	 * @brief The Pane struct contains the digest of a part of the window
+	 */
+	struct Pane
+	{
+		qint64 start;
+		TDigest digest;
+	};
+
+	/**
+	 * @brief expire Drop the values older than the window before the given time
+	 * @param now Time in milliseconds since epoch
+	 */
+	void expire(const qint64 &now);
+
+	/**
+	 * @brief getDigest
+	 * @return The digest of all panes
+	 */
+	TDigest getDigest() const;
+
+	/**
+	 * @brief m_Window The sliding time window in milliseconds
+	 */
+	Duration m_Window;
+
+	/**
+	 * @brief m_Values All values within the window in time order
+	 */
+	QList<ObisSample> m_Values;
+
+	/**
+	 * @brief m_MinDeque Candidates for the minimum, the values increase from front to back
+	 */
+	QList<ObisSample> m_MinDeque;
+
+	/**
+	 * @brief m_MaxDeque Candidates for the maximum, the values decrease from front to back
+	 */
+	QList<ObisSample> m_MaxDeque;
+
+	/**
+	 * @brief m_Mean The running mean of m_Values
+	 */
+	double m_Mean;
+
+	/**
+	 * @brief m_SquaredDeviations The running sum of squared deviations from the mean of m_Values
+	 */
+	double m_SquaredDeviations;
+
+	/**
+	 * @brief m_Ewma The exponentially weighted moving average
+	 */
+	double m_Ewma;
+
+	/**
+	 * @brief m_LastTimestamp The time of the last value, a negative time if none
+	 */
+	qint64 m_LastTimestamp;
+
+	/**
+	 * @brief m_Panes The digests of the window parts, the newest last
+	 */
+	QList<Pane> m_Panes;
+};
+
+}
@@ -0,0 +1,165 @@
+#include "TDigest.h"
+
+#include <QtMath>
+
+#include <limits>
+#include <algorithm>
+
+namespace Ssmr
+{
+
+namespace
+{
+  //the buffer is merged once it holds this many values per unit of compression
+  const int cBufferFactor = 5;
+
+  /*
+   * The k1 scale function of the t-digest, a centroid may span at most one unit of k
+   */
+  double Scale(const double &q, const double &compression)
+  {
+    return compression / (2.0 * M_PI) * qAsin(qBound(-1.0, 2.0 * q - 1.0, 1.0));
+  }
+}
+
+TDigest::TDigest(double compression)
+  : m_Compression(qMax(10.0, compression))
+  , m_Centroids()
+  , m_Buffer()
+  , m_Count(0.0)
+  , m_Min(std::numeric_limits<double>::infinity())
+  , m_Max(-std::numeric_limits<double>::infinity())
+{
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TDigest::add(const double &value, const double &weight)
+{
+  if((true == qIsNaN(value)) || (0.0 >= weight)) return;
+
+  m_Buffer.append(Centroid{value, weight});
+  m_Count += weight;
+  m_Min = qMin(m_Min, value);
+  m_Max = qMax(m_Max, value);
+
+  if(m_Buffer.size() >= cBufferFactor * static_cast<int>(m_Compression)) compress();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TDigest::merge(const TDigest &other)
+{
+  if(0.0 >= other.m_Count) return;
+
+  m_Buffer += other.m_Centroids;
+  m_Buffer += other.m_Buffer;
+  m_Count += other.m_Count;
+  m_Min = qMin(m_Min, other.m_Min);
+  m_Max = qMax(m_Max, other.m_Max);
+
+  compress();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TDigest::clear()
+{
+  m_Centroids.clear();
+  m_Buffer.clear();
+  m_Count = 0.0;
+  m_Min = std::numeric_limits<double>::infinity();
+  m_Max = -std::numeric_limits<double>::infinity();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double TDigest::getCount() const
+{
+  return m_Count;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+double TDigest::quantile(const double &q) const
+{
+  if(0.0 >= m_Count) return qQNaN();
+
+  compress();
+
+  if(1 == m_Centroids.size()) return m_Centroids.first().mean;
+
+  const double index = qBound(0.0, q, 1.0) * m_Count;
+
+  //the extreme values are known exactly, in between the centroid centers are interpolated linearly
+  const auto &first = m_Centroids.first();
+  if(index < first.weight / 2.0)
+  {
+    return m_Min + (first.mean - m_Min) * index / (first.weight / 2.0);
+  }
+
+  const auto &last = m_Centroids.last();
+  if(index > m_Count - last.weight / 2.0)
+  {
+    return m_Max - (m_Max - last.mean) * (m_Count - index) / (last.weight / 2.0);
+  }
+
+  double center = first.weight / 2.0;
+
+  for(int i = 1; i < m_Centroids.size(); ++i)
+  {
+    const auto &previous = m_Centroids.at(i - 1);
+    const auto &current = m_Centroids.at(i);
+    const double nextCenter = center + (previous.weight + current.weight) / 2.0;
+
+    if(index <= nextCenter)
+    {
+      const double fraction = (nextCenter > center) ? (index - center) / (nextCenter - center) : 0.0;
+      return previous.mean + (current.mean - previous.mean) * fraction;
+    }
+
+    center = nextCenter;
+  }
+
+  return m_Max;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TDigest::compress() const
+{
+  if(true == m_Buffer.isEmpty()) return;
+
+  QVector<Centroid> items = m_Centroids + m_Buffer;
+  m_Buffer.clear();
+
+  std::sort(items.begin(), items.end(), [](const Centroid &a, const Centroid &b) { return a.mean < b.mean; });
+
+  double total = 0.0;
+  for(const auto &item : items) total += item.weight;
+
+  QVector<Centroid> centroids;
+  centroids.reserve(static_cast<int>(m_Compression) * 2);
+
+  Centroid current = items.first();
+  double before = 0.0;
+  double limit = Scale(before / total, m_Compression) + 1.0;
+
+  for(int i = 1; i < items.size(); ++i)
+  {
+    const auto &item = items.at(i);
+    const double q = (before + current.weight + item.weight) / total;
+
+    if(Scale(q, m_Compression) <= limit)
+    {
+      current.mean += (item.mean - current.mean) * item.weight / (current.weight + item.weight);
+      current.weight += item.weight;
+      continue;
+    }
+
+    centroids.append(current);
+    before += current.weight;
+    limit = Scale(before / total, m_Compression) + 1.0;
+    current = item;
+  }
+
+  centroids.append(current);
+  m_Centroids = centroids;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <QVector>
+
+namespace Ssmr
+{
+
+/**
+ * @brief The TDigest class estimates quantiles of a stream of values in bounded memory
+ *
+ * This is a merging t-digest: values are collected in a buffer which is merged into a sorted list of centroids once it
+ * is full. Centroids near the median may hold many values, centroids at the tails only a few, so extreme quantiles
+ * like p99 stay accurate. Adding a value is amortized O(1), the memory is bounded by the compression.
+ */
+class TDigest
+{
+public:
+
+	/**
+	 * @brief TDigest Constructor
+	 * @param compression Roughly the number of centroids kept, higher values are more accurate
+	 */
+	explicit TDigest(double compression = 100.0);
+
+	/**
+	 * @brief add Add a single value
+	 * @param value NaN is ignored
+	 * @param weight
+	 */
+	void add(const double &value, const double &weight = 1.0);
+
+	/**
+	 * @brief merge Add all values of another digest
+	 * @param other
+	 */
+	void merge(const TDigest &other);
+
+	/**
+	 * @brief clear Remove all values
+	 */
+	void clear();
+
+	/**
+	 * @brief getCount
+	 * @return The total weight of all added values
+	 */
+	double getCount() const;
+
+	/**
+	 * @brief quantile
+	 * @param q The quantile within [0, 1], e.g. 0.95
+	 * @return The estimated value, NaN if the digest is empty
+	 */
+	double quantile(const double &q) const;
+
+private:
+
+	/**
+	 * @brief The Centroid struct is the mean of a number of neighbouring values
+	 */
+	struct Centroid
+	{
+		double mean;
+		double weight;
+	};
+
+	/**
+	 * @brief compress Merge the buffered values into the centroids
+	 */
+	void compress() const;
+
+	/**
+	 * @brief m_Compression Roughly the number of centroids kept
+	 */
+	double m_Compression;
+
+	/**
+	 * @brief m_Centroids Sorted by mean, merged lazily so queries on a const digest are possible
+	 */
+	mutable QVector<Centroid> m_Centroids;
+
+	/**
+	 * @brief m_Buffer Values not merged into the centroids yet
+	 */
+	mutable QVector<Centroid> m_Buffer;
+
+	/**
+	 * @brief m_Count The total weight of the centroids and the buffer
+	 */
+	double m_Count;
+
+	/**
+	 * @brief m_Min The smallest value added
+	 */
+	double m_Min;
+
+	/**
+	 * @brief m_Max The largest value added
+	 */
+	double m_Max;
+};
+
+}
@@ -0,0 +1,125 @@
+#include "TickScheduler.h"
+
+#include <QDateTime>
+
+#include <limits>
+
+#include "EventLoopWatchdog.h"
+
+namespace Ssmr
+{
+
+namespace
+{
+  //the intervals are rounded up to a multiple of this, so near rates share a wakeup
+  const qint64 cGranularity = 50;
+}
+
+TickScheduler* TickScheduler::Instance()
+{
+  static TickScheduler scheduler;
+  return &scheduler;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+TickScheduler::TickScheduler()
+  : QObject(nullptr)
+  , m_Subscriptions()
+  , m_NextId(0)
+  , m_Clock()
+  , m_Timer()
+{
+  m_Clock.start();
+
+  //a coarse timer may fire a little late, which lets the system batch the wakeup with others
+  m_Timer.setSingleShot(true);
+  m_Timer.setTimerType(Qt::CoarseTimer);
+
+  connect(&m_Timer, &QTimer::timeout, this, &TickScheduler::onTimeout);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int TickScheduler::subscribe(QObject *receiver, int interval, const TickCallback &callback)
+{
+  const qint64 rounded = qMax<qint64>(1, (interval + cGranularity - 1) / cGranularity) * cGranularity;
+  const qint64 now = m_Clock.elapsed();
+
+  const int id = m_NextId++;
+  Subscription subscription{receiver, rounded, (now / rounded + 1) * rounded, callback, QMetaObject::Connection()};
+
+  if(nullptr != receiver)
+  {
+    subscription.destroyed = connect(receiver, &QObject::destroyed, this, [this, id]() { unsubscribe(id); });
+  }
+
+  m_Subscriptions.insert(id, subscription);
+
+  schedule();
+
+  return id;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TickScheduler::unsubscribe(int id)
+{
+  const auto it = m_Subscriptions.find(id);
+  if(m_Subscriptions.end() == it) return;
+
+  disconnect(it->destroyed);
+  m_Subscriptions.erase(it);
+
+  schedule();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TickScheduler::onTimeout()
+{
+  const WatchdogScope scope("TickScheduler::onTimeout()");
+
+  const qint64 elapsed = m_Clock.elapsed();
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+  //the callbacks may subscribe or unsubscribe, so only the ids due now are visited
+  QList<int> due;
+  for(auto it = m_Subscriptions.begin(); it != m_Subscriptions.end(); ++it)
+  {
+    if(it->due > elapsed) continue;
+
+    //missed ticks are dropped, the next one is on the grid again
+    it->due = (elapsed / it->interval + 1) * it->interval;
+    due.append(it.key());
+  }
+
+  for(const int id : due)
+  {
+    const auto it = m_Subscriptions.constFind(id);
+    if((m_Subscriptions.constEnd() == it) || (nullptr == it->receiver)) continue;
+
+    //the callback may remove the subscription, so it must not be called through the iterator
+    const auto callback = it->callback;
+    callback(now);
+  }
+
+  schedule();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TickScheduler::schedule()
+{
+  if(true == m_Subscriptions.isEmpty())
+  {
+    m_Timer.stop();
+    return;
+  }
+
+  qint64 next = std::numeric_limits<qint64>::max();
+  for(const auto &subscription : m_Subscriptions)
+  {
+    next = qMin(next, subscription.due);
+  }
+
+  m_Timer.start(static_cast<int>(qMax<qint64>(0, next - m_Clock.elapsed())));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+}
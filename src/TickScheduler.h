@@ -0,0 +1,107 @@
+#pragma once
+
+#include <functional>
+
+#include <QMap>
+#include <QTimer>
+#include <QObject>
+#include <QPointer>
+#include <QElapsedTimer>
+
+namespace Ssmr
+{
+
+/**
+ * @brief The TickScheduler class calls periodic callbacks of the whole application from a single timer
+ *
+ * The ticks of a callback are aligned to multiples of its interval, so all callbacks with the same interval, or with
+ * intervals which are multiples of each other, are called in the same wakeup. The timer is only started for the next
+ * due tick and stopped while nothing is subscribed, an idle application is not woken up at all.
+ */
+class TickScheduler : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * @brief TickCallback Called with the time of the tick in milliseconds since epoch
+	 */
+	typedef std::function<void(const qint64 &now)> TickCallback;
+
+	/**
+	 * @brief Instance
+	 * @return The scheduler shared by the whole application, it has to be used from the GUI thread only
+	 */
+	static TickScheduler* Instance();
+
+	/**
+	 * @brief subscribe Call the callback periodically until it is unsubscribed or the receiver is destroyed
+	 * @param receiver The callback is not called after the receiver was destroyed
+	 * @param interval In milliseconds, rounded up to the granularity of the scheduler
+	 * @param callback
+	 * @return The id of the subscription
+	 */
+	int subscribe(QObject* receiver, int interval, const TickCallback &callback);
+
+	/**
+	 * @brief unsubscribe Stop calling the callback, unknown ids are ignored
+	 * @param id
+	 */
+	void unsubscribe(int id);
+
+private slots:
+
+	/**
+	 * @brief onTimeout Call all due callbacks and start the timer for the next due tick
+	 */
+	void onTimeout();
+
+private:
+
+	/**
+	 * @brief The Subscription struct contains a periodic callback
+	 */
+	struct Subscription
+	{
+		QPointer<QObject> receiver;
+		qint64 interval;
+		qint64 due;
+		TickCallback callback;
+
+		//!Removes the subscription when the receiver is destroyed
+		QMetaObject::Connection destroyed;
+	};
+
+	/**
+	 * @brief TickScheduler Constructor, use Instance()
+	 */
+	TickScheduler();
+
+	/**
+	 * @brief schedule Start the timer for the earliest due tick or stop it if nothing is subscribed
+	 */
+	void schedule();
+
+	/**
+	 * @brief m_Subscriptions The callbacks by id
+	 */
+	QMap<int, Subscription> m_Subscriptions;
+
+	/**
+	 * @brief m_NextId The id of the next subscription
+	 */
+	int m_NextId;
+
+	/**
+	 * @brief m_Clock The monotonic time the ticks are aligned to
+	 */
+	QElapsedTimer m_Clock;
+
+	/**
+	 * @brief m_Timer The single timer of all subscriptions
+	 */
+	QTimer m_Timer;
+};
+
+}
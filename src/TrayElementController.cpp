@@ -1,6 +1,7 @@
 #include "TrayElementController.h"
 
 #include <QSystemTrayIcon>
+#include <QAction>
 #include <QMenu>
 #include <QUrl>
 
@@ -11,8 +12,13 @@ TrayElementController::TrayElementController(QObject *parent)
   : QObject(parent)
     , m_TrayIcon(new QSystemTrayIcon(QIcon(":/icon.ico"), this))
     , m_TrayMenu(new QMenu())
-  , m_DefaultAction(nullptr)
+  , m_DefaultAction(new QAction(tr("Show"), this))
 {
+  //the window is hidden instead of closed in release builds, so it has to be restored from here
+  connect(m_DefaultAction, &QAction::triggered, this, &TrayElementController::show);
+
+  m_TrayMenu->addAction(m_DefaultAction);
+  m_TrayIcon->setContextMenu(m_TrayMenu);
   m_TrayIcon->show();
 
   connect(m_TrayIcon, &QSystemTrayIcon::activated, [this](QSystemTrayIcon::ActivationReason reason){
@@ -35,7 +41,14 @@ TrayElementController::~TrayElementController()
 
 void TrayElementController::setConnectionMenu(QMenu *menu)
 {
-  m_TrayIcon->setContextMenu(menu);
+  m_TrayMenu->addSeparator();
+  m_TrayMenu->addMenu(menu);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void TrayElementController::showMessage(const QString &title, const QString &message)
+{
+  m_TrayIcon->showMessage(title, message, QSystemTrayIcon::Warning);
 }
 //----------------------------------------------------------------------------------------------------------------------
 
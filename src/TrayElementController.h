@@ -30,7 +30,7 @@ public:
 	virtual ~TrayElementController() override;
 
 	/**
-	 * @brief setMenu The menu to use
+	 * @brief setMenu The menu to use, it is shown below the show item
 	 * @param menu
 	 *
 	 * @note This instance does NOT take ownership for the provided menu
@@ -40,7 +40,7 @@ public:
 signals:
 
 	/**
-	 * @brief exit the user clicked the show Application item.
+	 * @brief show the user clicked the show Application item or double clicked the tray icon.
 	 */
 	void show();
 
@@ -51,6 +51,13 @@ public slots:
 		 */
 	void triggerDefaultAction();
 
+	/**
+	 * @brief showMessage Show a notification at the tray icon
+	 * @param title
+	 * @param message
+	 */
+	void showMessage(const QString &title, const QString &message);
+
 private:
 
 	/**
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <limits>
+
+#include <QPair>
+#include <QVector>
 #include <QObject>
 #include <QSerialPortInfo>
 #include <QRegularExpression>
@@ -17,6 +21,81 @@ enum class CommunicationProtocol
 };
 Q_ENUM_NS(CommunicationProtocol)
 
+enum class StorageBackend
+{
+	eCsv = 0,
+	eSqlite = 1,
+};
+Q_ENUM_NS(StorageBackend)
+
+enum class CompressionMethod
+{
+	eNone = 0,
+	eDeadband = 1,
+	eSwingingDoor = 2,
+};
+Q_ENUM_NS(CompressionMethod)
+
+/**
+ * @brief ObisSample A single numeric value together with its timestamp in milliseconds since epoch
+ */
+typedef QPair<qint64, double> ObisSample;
+typedef QVector<ObisSample> ObisSampleList;
+
+/**
+ * @brief cMaxHoldMilliseconds A value is not held longer than this, e.g. if the connection was closed
+ *
+ * Shared by everything which holds a value until the next one, so rollups, queries, alignment, demand and plots agree
+ * on where a series has a gap.
+ */
+const qint64 cMaxHoldMilliseconds = 15 * 60 * 1000;
+
+/**
+ * @brief The ValueRange struct selects numeric values within [min, max], the default range is unbounded
+ */
+struct ValueRange
+{
+	ValueRange(double mi = -std::numeric_limits<double>::infinity(),
+						 double ma = std::numeric_limits<double>::infinity())
+		: min(mi)
+		, max(ma)
+	{
+	}
+
+	/**
+	 * @brief isBounded
+	 * @return True if at least one bound is set, so some values are excluded
+	 */
+	bool isBounded() const
+	{
+		return (-std::numeric_limits<double>::infinity() < min) || (std::numeric_limits<double>::infinity() > max);
+	}
+
+	/**
+	 * @brief contains
+	 * @param value
+	 * @return True if the given value is within this range, NaN is never contained
+	 */
+	bool contains(const double &value) const
+	{
+		return (min <= value) && (value <= max);
+	}
+
+	/**
+	 * @brief overlaps
+	 * @param lowest
+	 * @param highest
+	 * @return True if any value within [lowest, highest] is within this range
+	 */
+	bool overlaps(const double &lowest, const double &highest) const
+	{
+		return (lowest <= max) && (highest >= min);
+	}
+
+	double min;
+	double max;
+};
+
 struct Duration
 {
 
@@ -100,11 +179,23 @@ struct ObisValueMapping
 	ObisValueMapping(const QString &o = {},
 									 const QString &d = {},
 									 const QString &u = {},
-									 const Duration &i = {})
+									 const Duration &i = {},
+									 const CompressionMethod &c = CompressionMethod::eNone,
+									 const double &dev = 0.0,
+									 const bool &r = false,
+									 const Duration &g = {},
+									 const Duration &w = {},
+									 const QString &e = {})
 		: obisNumber(o)
 		, description(d)
 		, unit(u)
 		, interval(i)
+		, compression(c)
+		, deviation(dev)
+		, relativeDeviation(r)
+		, maxGap(g)
+		, window(w)
+		, expression(e)
 	{}
 
 	/**
@@ -116,12 +207,76 @@ struct ObisValueMapping
 		return !obisNumber.isEmpty();
 	}
 
+	/**
+	 * @brief isVirtual
+	 * @return True if the values are not received but computed from other obis numbers, see ChannelExpression
+	 */
+	bool isVirtual() const
+	{
+		return !expression.trimmed().isEmpty();
+	}
+
+	/**
+	 * @brief getTolerance
+	 * @param reference The value the deviation is relative to
+	 * @return The allowed absolute deviation of the stored series from the received values
+	 */
+	double getTolerance(const double &reference) const
+	{
+		return (true == relativeDeviation) ? qAbs(reference) * deviation / 100.0 : deviation;
+	}
+
+	/**
+	 * @brief getDeviationString
+	 * @return The deviation as string, relative deviations are suffixed with "%"
+	 */
+	QString getDeviationString() const
+	{
+		return QString::number(deviation) + ((true == relativeDeviation) ? QString("%") : QString());
+	}
+
+	/**
+	 * @brief ParseDeviation Parse a deviation like "0.5" or "2%"
+	 * @param text
+	 * @param d Set to the parsed deviation
+	 * @param r Set to true if the deviation is relative
+	 * @return False if the text is no valid, non negative deviation
+	 */
+	static bool ParseDeviation(const QString &text, double &d, bool &r)
+	{
+		QString number = text.trimmed();
+
+		r = number.endsWith(QChar('%'));
+		if(true == r) number.chop(1);
+
+		bool ok{};
+		d = number.trimmed().toDouble(&ok);
+
+		return (true == ok) && (0.0 <= d);
+	}
+
 	QString obisNumber;
 	QString description;
 	QString unit;
 
 	//!How often to refresh. Values with an invalid interval are refreshed for every reading
 	Duration interval;
+
+	//!How the stored series is thinned out after the interval has been applied
+	CompressionMethod compression;
+
+	//!The allowed deviation of the stored series, in the unit of the value or in percent
+	double deviation;
+	bool relativeDeviation;
+
+	//!A value is stored at least this often, even if it did not change. Invalid means no heartbeat
+	Duration maxGap;
+
+	//!The sliding window of the streaming statistics, see StreamingStatistics. Invalid means no statistics
+	Duration window;
+
+	//!The expression of a virtual channel, the obis number is then only the name of the computed series
+	QString expression;
 };
 
 /**
@@ -138,12 +293,14 @@ class ConnectionData
 												QString s = QString(),
 												QSerialPortInfo i = QSerialPortInfo(),
 												const CommunicationProtocol &p = CommunicationProtocol::eUnknown,
-												const QList<ObisValueMapping> &m = {})
+												const QList<ObisValueMapping> &m = {},
+												const StorageBackend &b = StorageBackend::eCsv)
 		: name(n)
 		, serialPortName(s)
 		, info(i)
 		, protocol(p)
 		, mappings(m)
+		, storage(b)
 	{}
 
 	/**
@@ -151,7 +308,7 @@ class ConnectionData
 	 * @param d
 	 */
 	inline ConnectionData(const ConnectionData &d)
-		: ConnectionData(d.name, d.serialPortName, d.info, d.protocol, d.mappings)
+		: ConnectionData(d.name, d.serialPortName, d.info, d.protocol, d.mappings, d.storage)
 	{}
 
 	/**
@@ -168,6 +325,7 @@ class ConnectionData
 			info = other.info;
 			protocol = other.protocol;
 			mappings = other.mappings;
+			storage = other.storage;
 		}
 
 		return *this;
@@ -195,6 +353,22 @@ class ConnectionData
 		return names;
 	}
 
+	/**
+	 * @brief getVirtualMappings
+	 * @return The mappings whose values are computed from other obis numbers, in the configured order
+	 */
+	QList<ObisValueMapping> getVirtualMappings() const
+	{
+		QList<ObisValueMapping> virtualMappings{};
+
+		for(const auto &mapping : mappings)
+		{
+			if(true == mapping.isVirtual()) virtualMappings.append(mapping);
+		}
+
+		return virtualMappings;
+	}
+
 	ObisValueMapping getMappingByObisNumber(const QString &obisNumber) const
 	{
 		for(const auto &mapping : mappings)
@@ -204,6 +378,18 @@ class ConnectionData
 		return {};
 	}
 
+	/**
+	 * @brief hasSamePort
+	 * @param other
+	 * @return True if the other data opens the same serial port with the same protocol, no reopen is needed then
+	 */
+	bool hasSamePort(const ConnectionData &other) const
+	{
+		return (serialPortName == other.serialPortName) &&
+					 (info.portName() == other.info.portName()) &&
+					 (protocol == other.protocol);
+	}
+
 	/**
 	 * @brief isValid
 	 * @return True if the name and serial port name are not empty a valid serial port infor is set and the protocol
@@ -222,6 +408,9 @@ class ConnectionData
 	QSerialPortInfo info;
 	CommunicationProtocol protocol;
 	QList<ObisValueMapping> mappings;
+
+	//!Where the received values are stored
+	StorageBackend storage;
 };
 
 }
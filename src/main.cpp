@@ -1,4 +1,9 @@
 #include "MainWindow.h"
+#include "QueryCommand.h"
+
+#ifdef ENABLE_SYSTRAY_MODULE
+#include "TrayElementController.h"
+#endif
 
 #include <QApplication>
 
@@ -7,6 +12,9 @@
 
 int main(int argc, char *argv[])
 {
+  //queries run without GUI, e.g. from scripts on a headless machine
+  if(true == Ssmr::IsQueryCommand(argc, argv)) return Ssmr::RunQueryCommand(argc, argv);
+
   QApplication::setAttribute(Qt::AA_EnableHighDpiScaling, true);
   QApplication a(argc, argv);
 
@@ -22,5 +30,22 @@ int main(int argc, char *argv[])
   Ssmr::MainWindow mw;
   mw.show();
 
+  #ifdef ENABLE_SYSTRAY_MODULE
+  Ssmr::TrayElementController tray;
+  tray.setConnectionMenu(mw.getConnectionsMenu());
+
+  //closing the window only hides it in release builds
+  QObject::connect(&tray, &Ssmr::TrayElementController::show, &mw, [&mw]()
+  {
+    mw.showNormal();
+    mw.raise();
+    mw.activateWindow();
+  });
+
+  //the notifications of the rules are shown at the tray icon, so they are seen while the window is hidden
+  QObject::connect(mw.getRuleActions(), &Ssmr::RuleActionDispatcher::notificationRequested,
+                   &tray, &Ssmr::TrayElementController::showMessage);
+  #endif
+
   return a.exec();
 }
@@ -3,7 +3,7 @@
 #***********************************************************************************************************************
 CONFIG *= ENABLE_SYSTRAY_MODULE
 
-QT += core gui multimedia svg serialport charts
+QT += core gui multimedia svg serialport charts concurrent sql network
 
 CONFIG += c++11
 
@@ -36,6 +36,10 @@ DEFINES *= \
 
 #DEFINES += SHOW_HTTPS_OPTION
 
+ENABLE_SYSTRAY_MODULE {
+	DEFINES *= ENABLE_SYSTRAY_MODULE
+}
+
 INCLUDEPATH *= \
 	$${PROJECT_ROOT}/src \
 	$${PROJECT_ROOT}/dependencies/include
@@ -51,28 +55,82 @@ LIBS *= \
 
 SOURCES += \
 	main.cpp \
+	src/AggregationKernels.cpp \
+	src/CalendarAggregates.cpp \
+	src/ChannelExpression.cpp \
 	src/Connection.cpp \
 	src/ConnectionDialog.cpp \
+	src/ConnectionListModel.cpp \
 	src/ConnectionSerializer.cpp \
+	src/ConnectionStorage.cpp \
 	src/ConnectionWindow.cpp \
+	src/CsvSeekIndex.cpp \
+	src/CsvSink.cpp \
+	src/Decimation.cpp \
+	src/DemandTracker.cpp \
+	src/EventLoopWatchdog.cpp \
 	src/HelpFunctions.cpp \
+	src/HistoryLoader.cpp \
+	src/IncrementalPlotWidget.cpp \
+	src/LiveSeriesAligner.cpp \
 	src/ObisValueDiagramWidget.cpp \
 	src/ObisValueLogWidget.cpp \
 	src/ObisValueMappingWidget.cpp \
-	src/ObisValueWidget.cpp \
+	src/ObisValueTableModel.cpp \
+	src/PowerDerivation.cpp \
+	src/QueryCommand.cpp \
+	src/QueryEngine.cpp \
+	src/Rollup.cpp \
+	src/RuleActionDispatcher.cpp \
+	src/RuleEngine.cpp \
+	src/SeriesAligner.cpp \
+	src/SeriesCompressor.cpp \
+	src/SqliteSink.cpp \
+	src/StepDetector.cpp \
+	src/StorageSink.cpp \
+	src/StreamingStatistics.cpp \
+	src/TDigest.cpp \
+	src/TickScheduler.cpp \
 	src/TrayElementController.cpp \
 	src/MainWindow.cpp
 
 HEADERS += \
+	src/AggregationKernels.h \
+	src/CalendarAggregates.h \
+	src/ChannelExpression.h \
 	src/Connection.h \
 	src/ConnectionDialog.h \
+	src/ConnectionListModel.h \
 	src/ConnectionSerializer.h \
+	src/ConnectionStorage.h \
 	src/ConnectionWindow.h \
+	src/CsvSeekIndex.h \
+	src/CsvSink.h \
+	src/Decimation.h \
+	src/DemandTracker.h \
+	src/EventLoopWatchdog.h \
 	src/HelpFunctions.h \
+	src/HistoryLoader.h \
+	src/IncrementalPlotWidget.h \
+	src/LiveSeriesAligner.h \
 	src/ObisValueDiagramWidget.h \
 	src/ObisValueLogWidget.h \
 	src/ObisValueMappingWidget.h \
-	src/ObisValueWidget.h \
+	src/ObisValueTableModel.h \
+	src/PowerDerivation.h \
+	src/QueryCommand.h \
+	src/QueryEngine.h \
+	src/Rollup.h \
+	src/RuleActionDispatcher.h \
+	src/RuleEngine.h \
+	src/SeriesAligner.h \
+	src/SeriesCompressor.h \
+	src/SqliteSink.h \
+	src/StepDetector.h \
+	src/StorageSink.h \
+	src/StreamingStatistics.h \
+	src/TDigest.h \
+	src/TickScheduler.h \
 	src/TrayElementController.h \
 	src/MainWindow.h \
 	src/TypeDefinitions.h
@@ -83,8 +141,7 @@ FORMS += \
 	src/MainWindow.ui \
 	src/ObisValueDiagramWidget.ui \
 	src/ObisValueLogWidget.ui \
-	src/ObisValueMappingWidget.ui \
-	src/ObisValueWidget.ui
+	src/ObisValueMappingWidget.ui
 
 DISTFILES +=
 